@@ -6,6 +6,14 @@ newoption {
    trigger = "prerelease-build",
    description = "CI prerelease build define"
 }
+newoption {
+   trigger = "acts-vm-packed-var",
+   description = "Use the packed 8 bytes vars in the ACTS VM"
+}
+newoption {
+   trigger = "acts-vm-profiler",
+   description = "Build the ACTS VM profiler"
+}
 
 function buildinfo()
     local versionfile = assert(io.open("release/version", "r"))
@@ -69,6 +77,12 @@ workspace "AtianCodTools"
 
     filter { "options:prerelease-build" }
         defines { "PRERELEASE_BUILD" }
+
+    filter { "options:acts-vm-packed-var" }
+        defines { "ACTS_VM_PACKED_VAR" }
+
+    filter { "options:acts-vm-profiler" }
+        defines { "ACTS_VM_PROFILER" }
     
     filter "configurations:Debug"
         defines { "DEBUG" }
@@ -318,7 +332,8 @@ project "ACTSVM"
     }
 
     includedirs {
-        "src/shared"
+        "src/shared",
+        "src/lib"
     }
 
     vpaths {
@@ -6,6 +6,12 @@
 #include "tools/gsc_acts_debug.hpp"
 #include "gsc_compiler.hpp"
 #include "compiler/preprocessor.hpp"
+#include "compiler/gsc_compiler_cache.hpp"
+#include "compiler/gsc_compiler_server.hpp"
+#include <unit_test.hpp>
+#include <core/async.hpp>
+#include <acts_vm.hpp>
+#include <BS_thread_pool.hpp>
 
 namespace acts::compiler {
     using namespace antlr4;
@@ -186,8 +192,10 @@ namespace acts::compiler {
         Platform plt;
         std::vector<byte>& data;
         size_t lvars;
+        // location of the data buffer in the file
+        size_t base;
 
-        AscmCompilerContext(const VmInfo* vmInfo, Platform plt, size_t lvars, std::vector<byte>& data) : vmInfo(vmInfo), plt(plt), data(data), lvars(lvars) {}
+        AscmCompilerContext(const VmInfo* vmInfo, Platform plt, size_t lvars, std::vector<byte>& data, size_t base = 0) : vmInfo(vmInfo), plt(plt), data(data), lvars(lvars), base(base) {}
 
         bool HasAlign() const {
             return vmInfo->HasFlag(VmFlags::VMF_ALIGN);
@@ -195,8 +203,8 @@ namespace acts::compiler {
 
         void Align(size_t len) {
             if (HasAlign()) {
-                size_t pre = data.size();
-                size_t post = (data.size() + (len - 1)) & ~(len - 1);
+                size_t pre = base + data.size();
+                size_t post = (pre + (len - 1)) & ~(len - 1);
 
                 for (size_t i = pre; i < post; i++) {
                     data.push_back(0);
@@ -225,16 +233,88 @@ namespace acts::compiler {
     class AscmNodeJump;
     class AscmNodeOpCode;
 
+    /*
+     * Bump allocator for the nodes of a compilation, the nodes are allocated in the arena of the current thread
+     * and the memory is released when the arena is destroyed.
+     */
+    class AscmNodeArena {
+        static constexpr size_t BLOCK_SIZE = 0x40000;
+        static constexpr size_t ALIGN = alignof(std::max_align_t);
+        static inline thread_local AscmNodeArena* current{};
+
+        std::vector<std::unique_ptr<byte[]>> blocks{};
+        size_t blockLoc{ BLOCK_SIZE };
+        AscmNodeArena* previous;
+    public:
+        AscmNodeArena() : previous(current) {
+            current = this;
+        }
+        ~AscmNodeArena() {
+            current = previous;
+        }
+        AscmNodeArena(const AscmNodeArena&) = delete;
+        AscmNodeArena& operator=(const AscmNodeArena&) = delete;
+
+        static AscmNodeArena* Current() {
+            return current;
+        }
+
+        void* Alloc(size_t size) {
+            size = (size + ALIGN - 1) & ~(ALIGN - 1);
+
+            if (size > BLOCK_SIZE) {
+                // big node, allocate it in its own block
+                auto& block{ blocks.emplace_back(std::make_unique<byte[]>(size)) };
+                byte* ptr{ block.get() };
+                if (blocks.size() > 1) {
+                    // keep the current block at the end
+                    std::swap(blocks[blocks.size() - 1], blocks[blocks.size() - 2]);
+                }
+                return ptr;
+            }
+
+            if (blockLoc + size > BLOCK_SIZE) {
+                blocks.emplace_back(std::make_unique<byte[]>(BLOCK_SIZE));
+                blockLoc = 0;
+            }
+
+            void* ptr{ blocks.back().get() + blockLoc };
+            blockLoc += size;
+            return ptr;
+        }
+    };
+
     class AscmNode {
+        // allocation header, nullptr if the node wasn't allocated in an arena
+        struct alignas(std::max_align_t) AllocHeader {
+            AscmNodeArena* arena;
+        };
     public:
         int32_t rloc{};
         int32_t floc{};
         size_t line{};
-        std::vector<AscmNodeJump*> refs{};
+        // number of jumps to this node
+        uint32_t refs{};
         AscmNodeType nodetype{ ASCMNT_UNKNOWN };
 
         virtual ~AscmNode() {};
 
+        static void* operator new(size_t size) {
+            AscmNodeArena* arena{ AscmNodeArena::Current() };
+            AllocHeader* header{ (AllocHeader*)(arena ? arena->Alloc(sizeof(AllocHeader) + size) : ::operator new(sizeof(AllocHeader) + size)) };
+            header->arena = arena;
+            return header + 1;
+        }
+
+        static void operator delete(void* ptr) {
+            if (!ptr) return;
+            AllocHeader* header{ (AllocHeader*)ptr - 1 };
+            if (!header->arena) {
+                ::operator delete(header);
+            }
+            // freed with the arena
+        }
+
         virtual uint32_t ShiftSize(uint32_t start, bool aligned) const {
             return start; // empty by default
         }
@@ -245,7 +325,7 @@ namespace acts::compiler {
         }
 
         bool HasRef() const {
-            return refs.size();
+            return refs;
         }
 
         bool IsOpCode() const {
@@ -897,9 +977,23 @@ namespace acts::compiler {
 
     class AscmNodeJump : public AscmNodeOpCode {
     public:
-        AscmNode* const location;
+        AscmNode* location;
         AscmNodeJump(AscmNode* location, OPCode opcode) : AscmNodeOpCode(opcode), location(location) {
-            location->refs.push_back(this);
+            location->refs++;
+        }
+
+        /*
+         * Change the location of the jump
+         * @param loc new location, nullptr to only remove the reference
+         */
+        void SetLocation(AscmNode* loc) {
+            if (location) {
+                location->refs--;
+            }
+            location = loc;
+            if (loc) {
+                loc->refs++;
+            }
         }
 
         uint32_t ShiftSize(uint32_t start, bool aligned) const override {
@@ -992,6 +1086,13 @@ namespace acts::compiler {
         int32_t crcClient{};
         bool oneFilePerComp{};
         bool hashFile{};
+        // 0 = hardware concurrency
+        size_t m_threads{};
+        const char* m_cacheDir{};
+        bool m_server{};
+        bool m_client{};
+        bool m_stopServer{};
+        const char* m_pipeName{ server::DEFAULT_PIPE_NAME };
         const char* nameServer{ "" };
         const char* nameClient{ "" };
         const char* fileNameSpaceServer{ "" };
@@ -1044,13 +1145,55 @@ namespace acts::compiler {
                 else if (!strcmp("-f", arg) || !_strcmpi("--file", arg)) {
                     oneFilePerComp = true;
                 }
+                else if (!strcmp("-j", arg) || !_strcmpi("--threads", arg)) {
+                    if (i + 1 == endIndex) {
+                        LOG_ERROR("Missing value for param: {}!", arg);
+                        return false;
+                    }
+                    try {
+                        m_threads = (size_t)utils::ParseFormatInt(args[++i]);
+                    }
+                    catch (std::runtime_error& e) {
+                        LOG_ERROR("Bad value for param {}: {}", arg, e.what());
+                        return false;
+                    }
+                }
                 else if (!strcmp("-O", arg) || !_strcmpi("--obfuscate", arg)) {
                     config.obfuscate = true;
                 }
+                else if (!_strcmpi("--optimize", arg)) {
+                    config.optimize = true;
+                }
+                else if (!_strcmpi("--strip-unused", arg)) {
+                    config.stripUnused = true;
+                }
                 else if (!_strcmpi("--dev-block-as-comment", arg)) {
                     config.processorOpt.devBlockAsComment = true;
                     LOG_WARNING("{} used, this message is just here to remind you that you're stupid.", arg);
                 }
+                else if (!_strcmpi("--cache", arg)) {
+                    if (i + 1 == endIndex) {
+                        LOG_ERROR("Missing value for param: {}!", arg);
+                        return false;
+                    }
+                    m_cacheDir = args[++i];
+                }
+                else if (!_strcmpi("--server", arg)) {
+                    m_server = true;
+                }
+                else if (!_strcmpi("--client", arg)) {
+                    m_client = true;
+                }
+                else if (!_strcmpi("--server-stop", arg)) {
+                    m_stopServer = true;
+                }
+                else if (!_strcmpi("--pipe", arg)) {
+                    if (i + 1 == endIndex) {
+                        LOG_ERROR("Missing value for param: {}!", arg);
+                        return false;
+                    }
+                    m_pipeName = args[++i];
+                }
                 else if (!_strcmpi("--preproc", arg)) {
                     if (i + 1 == endIndex) {
                         LOG_ERROR("Missing value for param: {}!", arg);
@@ -1154,7 +1297,11 @@ namespace acts::compiler {
             if (!m_inputFiles.size()) {
                 m_inputFiles.push_back(".");
             }
-            if (!config.vm) {
+            if ((m_server || m_stopServer) && m_client) {
+                LOG_ERROR("--client can't be used with --server or --server-stop");
+                return false;
+            }
+            if (!config.vm && !m_server && !m_stopServer) {
                 LOG_ERROR("No game set, please set a game using --game [game]");
                 return false;
             }
@@ -1192,6 +1339,7 @@ namespace acts::compiler {
             LOG_INFO("-D[name]               : Define variable");
             LOG_INFO("-c --csc               : Build client script with csc files");
             LOG_INFO("-f --file              : Compile each file inside an independant one");
+            LOG_INFO("-j --threads [n]       : Number of threads to compile the files with -f or the functions, default: hardware concurrency");
             LOG_INFO("--detour [t]           : Set the detour compilation type ('none' / 'acts' / 'gsic') default: 'none'");
             LOG_INFO("--crc [c]              : Set the crc for the server script");
             LOG_INFO("--crc-client [c]       : Set the crc for the client script");
@@ -1203,6 +1351,13 @@ namespace acts::compiler {
             LOG_INFO("--define-as-constxpr   : Consider #define as constexpr");
             LOG_INFO("--no-devcall-inline    : Do not automatically inline dev calls in /# #/ blocks");
             LOG_INFO("-O --obfuscate         : Obfuscate some parts of the code");
+            LOG_INFO("--optimize             : Fold the constants, thread the jumps and remove the dead code");
+            LOG_INFO("--strip-unused         : Remove the unused private functions and their strings, imports and globals");
+            LOG_INFO("--cache [d]            : Use d to cache the compiled scripts");
+            LOG_INFO("--server               : Start a compile server keeping the compiler loaded");
+            LOG_INFO("--client               : Send the compilation to a compile server");
+            LOG_INFO("--server-stop          : Stop a compile server");
+            LOG_INFO("--pipe [n]             : Set the compile server pipe name, default: '{}'", server::DEFAULT_PIPE_NAME);
             LOG_DEBUG("--preproc [f]         : Export preproc result into f");
         }
     };  
@@ -1256,6 +1411,7 @@ namespace acts::compiler {
     };
 
     struct FunctionJumpLoc {
+        std::string name{};
         AscmNode* node{};
         ParseTree* def{};
         bool defined{};
@@ -1285,7 +1441,10 @@ namespace acts::compiler {
         std::vector<AscmNode*> m_nodes{};
         std::stack<AscmNode*> m_jumpBreak{};
         std::stack<AscmNode*> m_jumpContinue{};
-        std::unordered_map<std::string, FunctionJumpLoc> m_jumpLocs{};
+        // jump locations, the names are interned to their index in m_jumpLocs
+        std::deque<FunctionJumpLoc> m_jumpLocs{};
+        // the views are using the names of m_jumpLocs, the deque isn't moving them
+        std::unordered_map<std::string_view, size_t> m_jumpLocIds{};
         VmInfo* m_vmInfo;
         DetourData detour{};
         FunctionObject(
@@ -1361,6 +1520,32 @@ namespace acts::compiler {
         void AddNode(ParseTree* tree, AscmNode* node);
         void AddNode(decltype(m_nodes)::iterator it, ParseTree* tree, AscmNode* node);
 
+        /*
+         * Get or create a jump location
+         * @param name location name
+         * @return location
+         */
+        FunctionJumpLoc& GetJumpLoc(const std::string& name) {
+            auto it{ m_jumpLocIds.find(name) };
+            if (it != m_jumpLocIds.end()) {
+                return m_jumpLocs[it->second];
+            }
+            FunctionJumpLoc& loc{ m_jumpLocs.emplace_back() };
+            loc.name = name;
+            m_jumpLocIds.emplace(loc.name, m_jumpLocs.size() - 1);
+            return loc;
+        }
+
+        /*
+         * Find a jump location
+         * @param name location name
+         * @return location or nullptr
+         */
+        FunctionJumpLoc* FindJumpLoc(const std::string& name) {
+            auto it{ m_jumpLocIds.find(name) };
+            return it != m_jumpLocIds.end() ? &m_jumpLocs[it->second] : nullptr;
+        }
+
 
         /*
          * Find a variable with its name
@@ -1426,9 +1611,10 @@ namespace acts::compiler {
             return current;
         }
 
-        void OptimizeNodes() {
-            // todo: find something to do?
-        }
+        /*
+         * Optimize the nodes if the optimizer is enabled: constant folding, jump threading and dead code removal
+         */
+        void OptimizeNodes();
     };
 
     struct ClassCompileContext {
@@ -1460,6 +1646,8 @@ namespace acts::compiler {
 
     class CompileObject {
     public:
+        // minimum number of functions to generate them in parallel
+        static constexpr size_t MIN_PARALLEL_FUNCTIONS = 64;
         size_t devBlockDepth{};
         CompilerConfig& config;
         InputInfo& info;
@@ -2026,6 +2214,10 @@ namespace acts::compiler {
                 f.m_nodes.push_back(new AscmNodeOpCode(OPCODE_End));
             }
 
+            if (config.stripUnused) {
+                RemoveUnusedFunctions();
+            }
+
             // set builtin call types for jup VM
             if (!gscHandler->HasFlag(tool::gsc::GOHF_SUPPORT_GET_API_SCRIPT)) {
                 // we need to compute if an import is from a builtin or a script
@@ -2134,57 +2326,6 @@ namespace acts::compiler {
 
             LOG_TRACE("Compile {} export(s)...", exports.size());
 
-            size_t exportIndex{};
-
-            std::vector<FunctionObject*> detourObjs{};
-
-            CompileObject& that = *this;
-            auto writeExport = [&data, &that, &expTable, &exportIndex, &detourObjs](FunctionObject& exp) -> bool {
-                exp.OptimizeNodes();
-                if (exp.m_nodes.empty()) {
-                    LOG_ERROR("No nodes for {:x}", exp.m_name);
-                    return false;
-                }
-
-                struct PreExp { uint64_t top; uint64_t bottom; };
-
-                utils::Aligned<PreExp>(data);
-                utils::Allocate(data, sizeof(uint64_t));
-
-                int32_t len = exp.ComputeRelativeLocations((int32_t)data.size());
-                if (len < 0) {
-                    LOG_ERROR("Error when allocating relative locations");
-                    return false;
-                }
-
-                exp.location = data.size();
-                tool::gsc::IW23GSCExport e{};
-                e.name = exp.m_name;
-                e.name_space = exp.m_name_space;
-                e.file_name_space = exp.m_data_name;
-                e.flags = that.gscHandler->MapFlagsExportToInt(exp.m_flags);
-                e.address = (int32_t)exp.location;
-                e.param_count = exp.m_params;
-                e.checksum = 0x12345678;
-                that.gscHandler->WriteExport(&data[expTable + that.gscHandler->GetExportSize() * exportIndex++], e);
-
-                AscmCompilerContext cctx{ that.vmInfo, that.config.platform, exp.m_allocatedVar, data };
-
-                for (AscmNode* node : exp.m_nodes) {
-                    if (!node->Write(cctx)) {
-                        return false;
-                    }
-                }
-                // add size for detours
-                exp.size = data.size() - exp.location;
-
-                if (exp.IsDetour()) {
-                    detourObjs.push_back(&exp);
-                }
-
-                return true;
-            };
-
             std::vector<FunctionObject*> autoexecs{};
             std::vector<FunctionObject*> othersfuncs{};
 
@@ -2205,24 +2346,216 @@ namespace acts::compiler {
                 std::shuffle(othersfuncs.begin(), othersfuncs.end(), std::mt19937{ std::random_device{}() });
             }
 
+            std::vector<FunctionObject*> functions{};
+            functions.reserve(autoexecs.size() + othersfuncs.size());
+            functions.insert(functions.end(), autoexecs.begin(), autoexecs.end());
+            functions.insert(functions.end(), othersfuncs.begin(), othersfuncs.end());
+
+            // the functions are independent until the layout, they are optimized and sized in parallel,
+            // placed in the file and then written in parallel at their location
+            std::unique_ptr<BS::thread_pool> pool{};
+            if (config.threads != 1 && functions.size() >= MIN_PARALLEL_FUNCTIONS) {
+                pool = std::make_unique<BS::thread_pool>((BS::concurrency_t)config.threads);
+            }
+
+            // the logs of the workers are printed in the functions order
+            auto forEachFunction = [&functions, &pool](auto&& func) {
+                std::vector<std::vector<core::logs::bufferedlog>> logs(functions.size());
+                std::vector<std::future<void>> futures{};
+                futures.reserve(functions.size());
+                for (size_t i = 0; i < functions.size(); i++) {
+                    futures.emplace_back(pool->submit_task([i, &logs, &func] {
+                        core::logs::setthreadbuffer(&logs[i]);
+                        utils::CloseEnd ce{ [] { core::logs::setthreadbuffer(nullptr); } };
+                        func(i);
+                    }));
+                }
+
+                std::exception_ptr err{};
+                for (size_t i = 0; i < futures.size(); i++) {
+                    try {
+                        futures[i].get();
+                    }
+                    catch (...) {
+                        if (!err) err = std::current_exception();
+                    }
+                    core::logs::flushbuffer(logs[i]);
+                }
+
+                if (err) {
+                    std::rethrow_exception(err);
+                }
+            };
+
+            struct PreExp { uint64_t top; uint64_t bottom; };
+
             bool exportsOk{ true };
-            for (FunctionObject* exp : autoexecs) {
-                if (!writeExport(*exp)) {
-                    exportsOk = false;
+            size_t exportIndex{};
+            std::vector<FunctionObject*> detourObjs{};
+
+            if (!pool) {
+                // serial layout, each function is placed after the previous one is written
+                for (FunctionObject* expptr : functions) {
+                    FunctionObject& exp{ *expptr };
+
+                    exp.OptimizeNodes();
+                    if (exp.m_nodes.empty()) {
+                        LOG_ERROR("No nodes for {:x}", exp.m_name);
+                        exportsOk = false;
+                        continue;
+                    }
+
+                    utils::Aligned<PreExp>(data);
+                    utils::Allocate(data, sizeof(uint64_t));
+
+                    int32_t len = exp.ComputeRelativeLocations((int32_t)data.size());
+                    if (len < 0) {
+                        LOG_ERROR("Error when allocating relative locations");
+                        exportsOk = false;
+                        continue;
+                    }
+
+                    exp.location = data.size();
+                    tool::gsc::IW23GSCExport e{};
+                    e.name = exp.m_name;
+                    e.name_space = exp.m_name_space;
+                    e.file_name_space = exp.m_data_name;
+                    e.flags = gscHandler->MapFlagsExportToInt(exp.m_flags);
+                    e.address = (int32_t)exp.location;
+                    e.param_count = exp.m_params;
+                    e.checksum = 0x12345678;
+                    gscHandler->WriteExport(&data[expTable + gscHandler->GetExportSize() * exportIndex++], e);
+
+                    AscmCompilerContext cctx{ vmInfo, config.platform, exp.m_allocatedVar, data };
+
+                    bool written{ true };
+                    for (AscmNode* node : exp.m_nodes) {
+                        if (!node->Write(cctx)) {
+                            written = false;
+                            break;
+                        }
+                    }
+                    if (!written) {
+                        exportsOk = false;
+                        continue;
+                    }
+                    // add size for detours
+                    exp.size = data.size() - exp.location;
+
+                    if (exp.IsDetour()) {
+                        detourObjs.push_back(&exp);
+                    }
                 }
             }
+            else {
+                // size of each function, -1 if it can't be compiled
+                std::vector<int32_t> sizes(functions.size());
+
+                forEachFunction([&functions, &sizes](size_t idx) {
+                    FunctionObject& exp{ *functions[idx] };
+                    sizes[idx] = -1;
+
+                    exp.OptimizeNodes();
+                    if (exp.m_nodes.empty()) {
+                        LOG_ERROR("No nodes for {:x}", exp.m_name);
+                        return;
+                    }
+
+                    // the function start is aligned, the alignment of the relative locations is the same as in the file
+                    int32_t len = exp.ComputeRelativeLocations(0);
+                    if (len < 0) {
+                        LOG_ERROR("Error when allocating relative locations");
+                        return;
+                    }
+                    sizes[idx] = len;
+                });
+
+                CompileObject& that = *this;
+                // allocate = place the function using its written size, otherwise the function is written in its allocated space
+                auto writeFunction = [&that, &data](FunctionObject& exp, bool allocate) -> bool {
+                    std::vector<byte> code{};
+                    code.reserve(exp.size);
+                    AscmCompilerContext cctx{ that.vmInfo, that.config.platform, exp.m_allocatedVar, code, exp.location };
+
+                    for (AscmNode* node : exp.m_nodes) {
+                        node->floc += (int32_t)exp.location;
+                        if (!node->Write(cctx)) {
+                            return false;
+                        }
+                    }
+
+                    if (allocate) {
+                        data.resize(exp.location + code.size());
+                    }
+                    else if (code.size() != exp.size) {
+                        LOG_ERROR("Invalid size for function {:x}: 0x{:x} != 0x{:x}", exp.m_name, code.size(), exp.size);
+                        return false;
+                    }
+
+                    std::memcpy(&data[exp.location], code.data(), code.size());
+                    exp.size = code.size();
+                    return true;
+                };
 
-            for (auto* expptr : othersfuncs) {
-                auto& exp = *expptr;
+                // the sizes computed with the relative locations are the written sizes only if the opcodes are aligned the same way,
+                // otherwise the functions are placed after they are written
+                bool precomputedLayout{ !vmInfo->HasFlag(VmFlags::VMF_ALIGN) || vmInfo->HasFlag(VmFlags::VMF_OPCODE_U16) };
 
-                if (!writeExport(exp)) {
-                    exportsOk = false;
+                size_t loc{ data.size() };
+
+                for (size_t i = 0; i < functions.size(); i++) {
+                    FunctionObject& exp{ *functions[i] };
+
+                    if (sizes[i] < 0) {
+                        exportsOk = false;
+                        continue;
+                    }
+
+                    exp.location = utils::Aligned<PreExp, size_t>(loc) + sizeof(uint64_t);
+                    exp.size = sizes[i];
+
+                    if (!precomputedLayout && !writeFunction(exp, true)) {
+                        exportsOk = false;
+                        continue;
+                    }
+                    loc = exp.location + exp.size;
+
+                    tool::gsc::IW23GSCExport e{};
+                    e.name = exp.m_name;
+                    e.name_space = exp.m_name_space;
+                    e.file_name_space = exp.m_data_name;
+                    e.flags = gscHandler->MapFlagsExportToInt(exp.m_flags);
+                    e.address = (int32_t)exp.location;
+                    e.param_count = exp.m_params;
+                    e.checksum = 0x12345678;
+                    gscHandler->WriteExport(&data[expTable + gscHandler->GetExportSize() * exportIndex++], e);
+
+                    if (exp.IsDetour()) {
+                        detourObjs.push_back(&exp);
+                    }
+                }
+
+                if (precomputedLayout && exportsOk) {
+                    // allocate the functions, the paddings are set to 0
+                    data.resize(loc);
+
+                    std::vector<byte> written(functions.size());
+                    forEachFunction([&functions, &written, &writeFunction](size_t idx) {
+                        written[idx] = writeFunction(*functions[idx], false);
+                    });
+
+                    for (byte w : written) {
+                        if (!w) {
+                            return false;
+                        }
+                    }
                 }
             }
 
             if (!exportsOk) {
                 return false;
             }
+
             if (!detourObjs.empty() && !config.detourType) {
                 LOG_ERROR("Detour parsed, but no --detour has been specified, they will be ignored.");
             }
@@ -2568,6 +2901,173 @@ namespace acts::compiler {
 
             lazyimports[located].push_back(lazyLink);
         }
+
+        /*
+         * Remove the private functions that can't be reached from the other functions and the strings,
+         * globals and imports only used by them.
+         * @return estimated number of bytes removed from the script
+         */
+        size_t RemoveUnusedFunctions() {
+            std::unordered_map<AscmNode*, FunctionObject*> owners{};
+            for (auto& [name, exp] : exports) {
+                for (AscmNode* node : exp.m_nodes) {
+                    owners[node] = &exp;
+                }
+            }
+
+            auto findLocal = [this](uint64_t nsp, uint64_t name) -> FunctionObject* {
+                auto it{ exports.find(name) };
+                if (it == exports.end() || it->second.m_name_space != nsp) return nullptr;
+                return &it->second;
+            };
+
+            // the functions called by each function, nullptr for the references outside of a function
+            std::unordered_map<FunctionObject*, std::vector<FunctionObject*>> calls{};
+            for (auto& [key, imps] : imports) {
+                FunctionObject* callee{ findLocal(key.name_space, key.name) };
+                if (!callee) continue;
+
+                for (ImportObject& imp : imps) {
+                    for (AscmNodeFunctionCall* node : imp.nodes) {
+                        auto it{ node ? owners.find(node) : owners.end() };
+                        calls[it == owners.end() ? nullptr : it->second].push_back(callee);
+                    }
+                }
+            }
+
+            // the exported functions, the autoexecs, the event handlers, the classes and the detours can be called by the game
+            std::vector<FunctionObject*> toVisit{};
+            std::unordered_set<FunctionObject*> reachable{};
+            auto markReachable = [&toVisit, &reachable](FunctionObject* exp) {
+                if (reachable.insert(exp).second) {
+                    toVisit.push_back(exp);
+                }
+            };
+
+            for (auto& [name, exp] : exports) {
+                if (exp.m_flags != tool::gsc::T8GSCExportFlags::PRIVATE || exp.IsDetour()) {
+                    markReachable(&exp);
+                }
+            }
+            for (auto& [key, lz] : lazyimports) {
+                // linked by the game, the path isn't checked to be conservative
+                if (FunctionObject* exp{ findLocal(key.name_space, key.name) }) {
+                    markReachable(exp);
+                }
+            }
+            toVisit.push_back(nullptr);
+
+            while (!toVisit.empty()) {
+                FunctionObject* exp{ toVisit.back() };
+                toVisit.pop_back();
+
+                auto it{ calls.find(exp) };
+                if (it == calls.end()) continue;
+                for (FunctionObject* callee : it->second) {
+                    markReachable(callee);
+                }
+            }
+
+            if (reachable.size() == exports.size()) {
+                return 0;
+            }
+
+            std::unordered_set<AscmNode*> deadNodes{};
+            std::vector<uint64_t> deadFunctions{};
+            size_t saved{};
+            for (auto& [name, exp] : exports) {
+                if (reachable.contains(&exp)) continue;
+
+                int32_t size{ exp.ComputeRelativeLocations(0) };
+                saved += (size > 0 ? size : 0) + sizeof(uint64_t) + gscHandler->GetExportSize();
+                deadNodes.insert(exp.m_nodes.begin(), exp.m_nodes.end());
+                deadFunctions.push_back(name);
+                LOG_DEBUG("Remove unused function {}", hashutils::ExtractTmp("function", name));
+            }
+
+            auto isDead = [&deadNodes](auto* node) { return deadNodes.contains(node); };
+            size_t removedStrings{};
+            size_t removedImports{};
+            size_t removedGlobals{};
+
+            for (auto it = strings.begin(); it != strings.end();) {
+                StringObject& str{ it->second };
+                size_t refs{ str.nodes.size() };
+                std::erase_if(str.nodes, isDead);
+                saved += (refs - str.nodes.size()) * sizeof(uint32_t);
+
+                if (refs && str.nodes.empty() && str.listeners.empty()) {
+                    saved += gscHandler->GetStringSize() + gscHandler->GetStringHeader(it->first.length()).second + std::max(it->first.length(), str.forceLen) + 1;
+                    removedStrings++;
+                    it = strings.erase(it);
+                }
+                else {
+                    it++;
+                }
+            }
+
+            for (auto it = globals.begin(); it != globals.end();) {
+                GlobalVarObject& gv{ it->second };
+                size_t refs{ gv.nodes.size() };
+                std::erase_if(gv.nodes, isDead);
+                saved += (refs - gv.nodes.size()) * sizeof(uint32_t);
+
+                if (refs && gv.nodes.empty()) {
+                    saved += gscHandler->GetGVarSize();
+                    removedGlobals++;
+                    it = globals.erase(it);
+                }
+                else {
+                    it++;
+                }
+            }
+
+            for (auto it = imports.begin(); it != imports.end();) {
+                std::vector<ImportObject>& imps{ it->second };
+                for (auto impIt = imps.begin(); impIt != imps.end();) {
+                    size_t refs{ impIt->nodes.size() };
+                    std::erase_if(impIt->nodes, isDead);
+                    saved += (refs - impIt->nodes.size()) * sizeof(uint32_t);
+
+                    if (refs && impIt->nodes.empty()) {
+                        saved += gscHandler->GetImportSize();
+                        removedImports++;
+                        impIt = imps.erase(impIt);
+                    }
+                    else {
+                        impIt++;
+                    }
+                }
+
+                if (imps.empty()) {
+                    it = imports.erase(it);
+                }
+                else {
+                    it++;
+                }
+            }
+
+            for (auto it = lazyimports.begin(); it != lazyimports.end();) {
+                std::erase_if(it->second, isDead);
+                if (it->second.empty()) {
+                    it = lazyimports.erase(it);
+                }
+                else {
+                    it++;
+                }
+            }
+
+            std::erase_if(m_devBlocks, isDead);
+
+            for (uint64_t name : deadFunctions) {
+                exports.erase(name);
+            }
+
+            LOG_INFO("Removed {} unused function(s), {} string(s), {} import(s) and {} global(s) from {}, ~{} byte(s) saved",
+                deadFunctions.size(), removedStrings, removedImports, removedGlobals, config.name ? config.name : "script", saved);
+
+            return saved;
+        }
     };
 
 
@@ -2601,15 +3101,409 @@ namespace acts::compiler {
         if (token) {
             node->line = token->getLine();
         }
-        m_nodes.push_back(node);
+        m_nodes.push_back(node);
+    }
+
+    void FunctionObject::AddNode(decltype(m_nodes)::iterator it, ParseTree* tree, AscmNode* node) {
+        Token* token = obj.info.GetToken(tree);
+        if (token) {
+            node->line = token->getLine();
+        }
+        m_nodes.insert(it, node);
+    }
+
+    namespace {
+        // empty node used as a jump location
+        inline bool IsLabelNode(const AscmNode* node) {
+            return typeid(*node) == typeid(AscmNode);
+        }
+
+        inline bool IsJumpOpCode(OPCode op, bool conditional) {
+            switch (op) {
+            case OPCODE_Jump:
+                return true;
+            case OPCODE_JumpOnTrue:
+            case OPCODE_JumpOnFalse:
+            case OPCODE_JumpOnTrueExpr:
+            case OPCODE_JumpOnFalseExpr:
+            case OPCODE_JumpOnDefinedExpr:
+                return conditional;
+            default:
+                // devblock or position refs, the location is used by the vm
+                return false;
+            }
+        }
+
+        template<typename Type>
+        bool ReadNumberNode(const AscmNode* node, int64_t& val) {
+            const AscmNodeData<Type>* data{ dynamic_cast<const AscmNodeData<Type>*>(node) };
+            if (!data) return false;
+            val = (int64_t)data->val;
+            return true;
+        }
+
+        /*
+         * Read the value of an integer node
+         * @param node node
+         * @param val value
+         * @return true if the node is an integer node
+         */
+        bool GetIntegerNodeValue(const AscmNode* node, int64_t& val) {
+            if (!node->IsOpCode()) return false;
+
+            OPCode op{ static_cast<const AscmNodeOpCode*>(node)->opcode };
+            for (const NumberOpCodesS& nop : NumberOpCodes) {
+                if (nop.opcode != op) continue;
+
+                bool ok;
+                switch (nop.sizeOf) {
+                case 0: val = 0; ok = typeid(*node) == typeid(AscmNodeOpCode); break;
+                case 1: ok = nop.unsign ? ReadNumberNode<uint8_t>(node, val) : ReadNumberNode<int8_t>(node, val); break;
+                case 2: ok = nop.unsign ? ReadNumberNode<uint16_t>(node, val) : ReadNumberNode<int16_t>(node, val); break;
+                case 4: ok = nop.unsign ? ReadNumberNode<uint32_t>(node, val) : ReadNumberNode<int32_t>(node, val); break;
+                case 8: ok = nop.unsign ? ReadNumberNode<uint64_t>(node, val) : ReadNumberNode<int64_t>(node, val); break;
+                default: ok = false; break;
+                }
+                if (ok && nop.negat) {
+                    val = -val;
+                }
+                return ok;
+            }
+            return false;
+        }
+
+        /*
+         * Fold an integer operation, only the operations with the same result on all the vms are folded
+         * @param op operator
+         * @param a left operand
+         * @param b right operand
+         * @param out result
+         * @return true if the operation was folded
+         */
+        bool FoldIntegerOperation(OPCode op, int64_t a, int64_t b, int64_t& out) {
+            // some vms are using 32 bits integers
+            constexpr int64_t min32{ std::numeric_limits<int32_t>::min() };
+            constexpr int64_t max32{ std::numeric_limits<int32_t>::max() };
+            if (a < min32 || a > max32 || b < min32 || b > max32) return false;
+
+            switch (op) {
+            case OPCODE_Plus: out = a + b; break;
+            case OPCODE_Minus: out = a - b; break;
+            case OPCODE_Multiply: out = a * b; break;
+            case OPCODE_Divide:
+                // a non exact division is returning a float
+                if (!b || a % b) return false;
+                out = a / b;
+                break;
+            case OPCODE_Modulus:
+                if (a < 0 || b <= 0) return false;
+                out = a % b;
+                break;
+            case OPCODE_Bit_And: out = a & b; break;
+            case OPCODE_Bit_Or: out = a | b; break;
+            case OPCODE_Bit_Xor: out = a ^ b; break;
+            case OPCODE_ShiftLeft:
+                if (a < 0 || b < 0 || b >= 31) return false;
+                out = a << b;
+                break;
+            case OPCODE_ShiftRight:
+                if (a < 0 || b < 0 || b >= 31) return false;
+                out = a >> b;
+                break;
+            default:
+                return false;
+            }
+            return out >= min32 && out <= max32;
+        }
+
+        // nodes without side effect or external reference
+        bool IsRemovableNode(const AscmNode* node) {
+            if (IsLabelNode(node)) return true;
+            if (!node->IsOpCode()) return false;
+
+            const AscmNodeOpCode* op{ static_cast<const AscmNodeOpCode*>(node) };
+            if (op->opcode == OPCODE_End || op->opcode == OPCODE_Return) return false; // keep the function ends
+
+            if (typeid(*node) == typeid(AscmNodeOpCode) || typeid(*node) == typeid(AscmNodeVariable)) return true;
+            if (typeid(*node) == typeid(AscmNodeJump)) return IsJumpOpCode(op->opcode, true);
+
+            int64_t val;
+            return GetIntegerNodeValue(node, val);
+        }
+
+        // reverse index of the jumps, kept up to date by the optimizer passes
+        class JumpSources {
+            std::unordered_map<AscmNode*, std::vector<AscmNodeJump*>> sources{};
+        public:
+            JumpSources(const std::vector<AscmNode*>& nodes) {
+                for (AscmNode* node : nodes) {
+                    if (typeid(*node) == typeid(AscmNodeJump)) {
+                        Add(static_cast<AscmNodeJump*>(node));
+                    }
+                }
+            }
+
+            void Add(AscmNodeJump* jmp) {
+                if (jmp->location) {
+                    sources[jmp->location].push_back(jmp);
+                }
+            }
+
+            /*
+             * Change the location of a jump
+             * @param jmp jump
+             * @param loc new location, nullptr to only remove the reference
+             */
+            void SetLocation(AscmNodeJump* jmp, AscmNode* loc) {
+                if (jmp->location) {
+                    auto it{ sources.find(jmp->location) };
+                    if (it != sources.end()) {
+                        std::vector<AscmNodeJump*>& jumps{ it->second };
+                        auto jit{ std::find(jumps.begin(), jumps.end(), jmp) };
+                        if (jit != jumps.end()) {
+                            *jit = jumps.back();
+                            jumps.pop_back();
+                        }
+                        if (jumps.empty()) {
+                            sources.erase(it);
+                        }
+                    }
+                }
+                jmp->SetLocation(loc);
+                Add(jmp);
+            }
+
+            /*
+             * Move all the jumps to a node to another node
+             * @param from old location
+             * @param to new location
+             */
+            void Move(AscmNode* from, AscmNode* to) {
+                auto it{ sources.find(from) };
+                if (it == sources.end()) return;
+                std::vector<AscmNodeJump*> jumps{ std::move(it->second) };
+                sources.erase(it);
+
+                std::vector<AscmNodeJump*>& dest{ sources[to] };
+                for (AscmNodeJump* jmp : jumps) {
+                    jmp->SetLocation(to);
+                    dest.push_back(jmp);
+                }
+            }
+
+            void DeleteNode(AscmNode* node) {
+                if (typeid(*node) == typeid(AscmNodeJump)) {
+                    SetLocation(static_cast<AscmNodeJump*>(node), nullptr);
+                }
+                delete node;
+            }
+        };
+
+        /*
+         * Replace a node range, the references to the first node are moved to the replacement
+         * @param nodes function nodes
+         * @param jumps function jumps
+         * @param start first node
+         * @param count number of nodes to replace
+         * @param replacement replacement node, nullptr to move the references to the next node
+         */
+        void ReplaceNodes(std::vector<AscmNode*>& nodes, JumpSources& jumps, size_t start, size_t count, AscmNode* replacement) {
+            AscmNode* first{ nodes[start] };
+            AscmNode* refTarget{ replacement ? replacement : (start + count < nodes.size() ? nodes[start + count] : nullptr) };
+
+            if (first->HasRef()) {
+                if (!refTarget) {
+                    throw std::runtime_error("Can't remove a referenced node at the end of a function");
+                }
+                jumps.Move(first, refTarget);
+            }
+
+            if (replacement) {
+                replacement->line = first->line;
+                if (typeid(*replacement) == typeid(AscmNodeJump)) {
+                    jumps.Add(static_cast<AscmNodeJump*>(replacement));
+                }
+            }
+
+            for (size_t i = 0; i < count; i++) {
+                jumps.DeleteNode(nodes[start + i]);
+            }
+
+            nodes.erase(nodes.begin() + start, nodes.begin() + start + count);
+            if (replacement) {
+                nodes.insert(nodes.begin() + start, replacement);
+            }
+        }
+
+        // fold the constant integer operations and the constant conditional jumps
+        bool FoldConstantNodes(FunctionObject& fobj, JumpSources& jumps) {
+            std::vector<AscmNode*>& nodes{ fobj.m_nodes };
+            bool changed{};
+
+            for (size_t i = 0; i + 1 < nodes.size(); i++) {
+                int64_t a;
+                if (!GetIntegerNodeValue(nodes[i], a)) continue;
+
+                // const const op
+                int64_t b, res;
+                if (i + 2 < nodes.size() && !nodes[i + 1]->HasRef() && !nodes[i + 2]->HasRef()
+                    && GetIntegerNodeValue(nodes[i + 1], b) && nodes[i + 2]->IsOpCode()
+                    && typeid(*nodes[i + 2]) == typeid(AscmNodeOpCode)
+                    && FoldIntegerOperation(nodes[i + 2]->AsOpCode()->opcode, a, b, res)) {
+                    ReplaceNodes(nodes, jumps, i, 3, fobj.obj.BuildAscmNodeData(res));
+                    changed = true;
+                    i = i > 2 ? i - 2 : 0; // the result can be used by a previous constant
+                    i--;
+                    continue;
+                }
+
+                // const jumpif
+                AscmNodeJump* jmp{ dynamic_cast<AscmNodeJump*>(nodes[i + 1]) };
+                if (!jmp || jmp->HasRef() || (jmp->opcode != OPCODE_JumpOnTrue && jmp->opcode != OPCODE_JumpOnFalse)) continue;
+
+                bool taken{ (a != 0) == (jmp->opcode == OPCODE_JumpOnTrue) };
+                ReplaceNodes(nodes, jumps, i, 2, taken ? new AscmNodeJump(jmp->location, OPCODE_Jump) : nullptr);
+                changed = true;
+                i--;
+            }
+
+            return changed;
+        }
+
+        // retarget the jumps to jumps and remove the jumps to the next node
+        bool ThreadJumpNodes(FunctionObject& fobj, JumpSources& jumps) {
+            std::vector<AscmNode*>& nodes{ fobj.m_nodes };
+            std::unordered_map<AscmNode*, size_t> locs{};
+            for (size_t i = 0; i < nodes.size(); i++) {
+                locs[nodes[i]] = i;
+            }
+            std::vector<bool> removed(nodes.size());
+
+            // first instruction run from an index, the labels and the removed jumps are skipped
+            auto nextInstruction = [&nodes, &removed](size_t idx) -> size_t {
+                while (idx < nodes.size() && (removed[idx] || IsLabelNode(nodes[idx]))) {
+                    idx++;
+                }
+                return idx;
+            };
+            auto nodeInstruction = [&nodes, &locs, &nextInstruction](AscmNode* node) -> size_t {
+                auto it{ locs.find(node) };
+                if (it == locs.end()) return nodes.size();
+                return nextInstruction(it->second);
+            };
+
+            bool changed{};
+            std::vector<AscmNodeJump*> chain{};
+            // from the end, so a jump to the next node is removed before the previous jumps are checked
+            for (size_t i = nodes.size(); i--; ) {
+                AscmNodeJump* jmp{ dynamic_cast<AscmNodeJump*>(nodes[i]) };
+                if (!jmp || !IsJumpOpCode(jmp->opcode, true)) continue;
+
+                // follow the unconditional jumps, a loop is kept as it is
+                AscmNode* target{ jmp->location };
+                bool loop{};
+                chain.clear();
+                while (true) {
+                    size_t idx{ nodeInstruction(target) };
+                    if (idx >= nodes.size()) break;
+                    AscmNodeJump* next{ dynamic_cast<AscmNodeJump*>(nodes[idx]) };
+                    if (!next || next->opcode != OPCODE_Jump) break;
+                    if (next == jmp || next->location == target || chain.size() > nodes.size()) {
+                        loop = true;
+                        break;
+                    }
+                    chain.push_back(next);
+                    target = next->location;
+                }
+
+                if (!loop) {
+                    // the jumps of the chain are also going to the end, so the next chains are short
+                    for (AscmNodeJump* cjmp : chain) {
+                        if (cjmp->location != target) {
+                            jumps.SetLocation(cjmp, target);
+                        }
+                    }
+                    if (target != jmp->location) {
+                        jumps.SetLocation(jmp, target);
+                        changed = true;
+                    }
+                }
+
+                if (jmp->opcode == OPCODE_Jump) {
+                    size_t next{ nextInstruction(i + 1) };
+                    if (next < nodes.size() && nodeInstruction(jmp->location) == next) {
+                        removed[i] = true;
+                        changed = true;
+                    }
+                }
+            }
+
+            if (!changed) {
+                return false;
+            }
+
+            // remove the jumps in one pass, their references are moved to the next kept node, it exists because a
+            // removed jump is followed by an instruction
+            AscmNode* nextKept{};
+            for (size_t i = nodes.size(); i--; ) {
+                if (!removed[i]) {
+                    nextKept = nodes[i];
+                    continue;
+                }
+                jumps.Move(nodes[i], nextKept);
+                jumps.DeleteNode(nodes[i]);
+            }
+
+            size_t count{};
+            for (size_t i = 0; i < nodes.size(); i++) {
+                if (!removed[i]) {
+                    nodes[count++] = nodes[i];
+                }
+            }
+            nodes.resize(count);
+
+            return true;
+        }
+
+        // remove the nodes after an unconditional jump, a return or an end that can't be reached
+        bool RemoveDeadNodes(FunctionObject& fobj, JumpSources& jumps) {
+            std::vector<AscmNode*>& nodes{ fobj.m_nodes };
+            bool changed{};
+
+            for (size_t i = 0; i < nodes.size(); i++) {
+                AscmNodeOpCode* op{ nodes[i]->AsOpCode() };
+                if (!op || (op->opcode != OPCODE_End && op->opcode != OPCODE_Return && !(op->opcode == OPCODE_Jump && typeid(*op) == typeid(AscmNodeJump)))) continue;
+
+                size_t end{ i + 1 };
+                // keep the last node
+                while (end + 1 < nodes.size() && !nodes[end]->HasRef() && IsRemovableNode(nodes[end])) {
+                    end++;
+                }
+
+                if (end > i + 1) {
+                    ReplaceNodes(nodes, jumps, i + 1, end - i - 1, nullptr);
+                    changed = true;
+                }
+            }
+
+            return changed;
+        }
     }
 
-    void FunctionObject::AddNode(decltype(m_nodes)::iterator it, ParseTree* tree, AscmNode* node) {
-        Token* token = obj.info.GetToken(tree);
-        if (token) {
-            node->line = token->getLine();
+    void FunctionObject::OptimizeNodes() {
+        if (!obj.config.optimize) {
+            return;
         }
-        m_nodes.insert(it, node);
+
+        // each pass is removing nodes or moving jumps closer to their end, so it stops
+        JumpSources jumps{ m_nodes };
+        bool changed;
+        do {
+            changed = false;
+            if (FoldConstantNodes(*this, jumps)) changed = true;
+            if (ThreadJumpNodes(*this, jumps)) changed = true;
+            if (RemoveDeadNodes(*this, jumps)) changed = true;
+        } while (changed);
     }
 
     AscmNode* FunctionObject::CreateFieldHash(const char* v, OPCode op) const {
@@ -2948,7 +3842,7 @@ namespace acts::compiler {
 
                     std::string locName = rule->children[0]->getText();
 
-                    FunctionJumpLoc& loc = fobj.m_jumpLocs[locName];
+                    FunctionJumpLoc& loc = fobj.GetJumpLoc(locName);
 
                     if (loc.defined) {
                         obj.info.PrintLineMessage(core::logs::LVL_ERROR, rule, std::format("The location {} was defined twice!", locName));
@@ -3674,7 +4568,7 @@ namespace acts::compiler {
                         return false;
                     }
 
-                    FunctionJumpLoc& loc = fobj.m_jumpLocs[rule->children[1]->getText()];
+                    FunctionJumpLoc& loc = fobj.GetJumpLoc(rule->children[1]->getText());
                     if (!loc.node) {
                         loc.node = new AscmNode();
                     }
@@ -3692,7 +4586,7 @@ namespace acts::compiler {
                         return false;
                     }
 
-                    FunctionJumpLoc& loc = fobj.m_jumpLocs[rule->children[1]->getText()];
+                    FunctionJumpLoc& loc = fobj.GetJumpLoc(rule->children[1]->getText());
                     if (!loc.node) {
                         loc.node = new AscmNode();
                     }
@@ -5067,15 +5961,15 @@ namespace acts::compiler {
             }
 
             if (obj.HasOpCode(OPCODE_IW_GetPositionRef)) {
-                auto itl = fobj.m_jumpLocs.find(varName);
+                FunctionJumpLoc* itl = fobj.FindJumpLoc(varName);
 
-                if (itl != fobj.m_jumpLocs.end()) {
-                    if (!itl->second.node) {
+                if (itl) {
+                    if (!itl->node) {
                         obj.info.PrintLineMessage(core::logs::LVL_ERROR, exp, std::format("The jump location {} can't be referenced", varName));
                         return false;
                     }
 
-                    fobj.AddNode(term, new AscmNodeJump(itl->second.node, OPCODE_IW_GetPositionRef));
+                    fobj.AddNode(term, new AscmNodeJump(itl->node, OPCODE_IW_GetPositionRef));
                     return true;
                 }
             }
@@ -5691,12 +6585,12 @@ namespace acts::compiler {
 
         exp.AddNode(func, endNode);
 
-        for (auto& [name, loc] : exp.m_jumpLocs) {
+        for (FunctionJumpLoc& loc : exp.m_jumpLocs) {
             if (loc.defined) {
                 continue;
             }
 
-            obj.info.PrintLineMessage(core::logs::LVL_ERROR, loc.def ? loc.def : blockRule, std::format("The location {} was used, but isn't declared", name));
+            obj.info.PrintLineMessage(core::logs::LVL_ERROR, loc.def ? loc.def : blockRule, std::format("The location {} was used, but isn't declared", loc.name));
 
             badRef = true;
 
@@ -5919,6 +6813,29 @@ namespace acts::compiler {
             return 0;
         }
 
+        if (opt.m_server) {
+            return server::RunServer(proc, opt.m_pipeName, compiler);
+        }
+
+        if (opt.m_stopServer || opt.m_client) {
+            // forward the options to the server, the paths are resolved by the server using our working directory
+            std::vector<const char*> args{};
+            for (size_t i = 2; i < argc; i++) {
+                if (!_strcmpi("--client", argv[i])) continue;
+                if (!_strcmpi("--pipe", argv[i])) {
+                    i++;
+                    continue;
+                }
+                args.push_back(argv[i]);
+            }
+
+            int ret{};
+            if (!server::SendRequest(opt.m_pipeName, opt.m_stopServer ? server::SRT_STOP : server::SRT_COMPILE, args, ret)) {
+                return tool::BASIC_ERROR;
+            }
+            return ret;
+        }
+
         VmInfo* vmInfo{ opt.config.GetVm() };
         auto* readerBuilder = tool::gsc::GetGscReader(vmInfo->vmMagic);
 
@@ -5929,108 +6846,132 @@ namespace acts::compiler {
 
         std::shared_ptr<tool::gsc::GSCOBJHandler> handler {(*readerBuilder)(nullptr, 0)};
 
-        auto produceFile = [&opt, &handler](bool client, std::vector<std::filesystem::path>& inputs) -> int {
-            opt.config.clientScript = client;
-            VmInfo* vmInfo{ opt.config.GetVm() };
+        std::unique_ptr<cache::CompilerCache> compileCache{};
+        if (opt.m_cacheDir) {
+            uint64_t baseKey{ hash::Hash64("gscc") };
+            if (utils::cache::HashBuild(baseKey)) {
+                compileCache = std::make_unique<cache::CompilerCache>(opt.m_cacheDir, baseKey);
+                opt.config.cache = compileCache.get();
+                LOG_INFO("Using compiler cache '{}'", opt.m_cacheDir);
+            }
+            else {
+                LOG_WARNING("The compiler cache is disabled");
+            }
+        }
+        opt.config.threads = opt.m_threads;
 
-            opt.config.checksum = client ? opt.crcClient : opt.crcServer;
+        // the config is copied for each target, CompileGsc is updating the preprocessor options
+        // the server and the client scripts are compiled together to share the parse of the sources, nullptr name = no target
+        auto produceFiles = [&opt, &handler](const CompilerConfig& baseConfig, const char* outFileName, const char* serverName, const char* clientName, std::vector<std::filesystem::path>& inputs, std::string* preprocOut) -> int {
+            std::vector<CompilerTarget> targets{};
+            std::array<std::unordered_set<std::string>, 2> hashes{};
+            targets.reserve(2);
 
-            if (!opt.config.checksum) {
-                opt.config.checksum = (int32_t)handler->GetDefaultChecksum(client);
-            }
+            for (bool client : { false, true }) {
+                const char* name{ client ? clientName : serverName };
+                if (!name) continue;
 
-            const char* fn = opt.config.name;
-            // client ? opt.nameClient : opt.nameServer;
-            const char* fileNameStr = fn && *fn ? fn : nullptr;
+                bool hasFile{};
+                for (const std::filesystem::path& file : inputs) {
+                    auto ext = file.extension();
+                    if (client ? (ext == ".csc" || ext == ".gcsc") : (ext == ".gsc" || ext == ".gcsc")) {
+                        hasFile = true;
+                        break;
+                    }
+                }
 
-            if (!fileNameStr) {
-                fileNameStr = handler->GetDefaultName(client);
-            }
+                if (!hasFile) continue; // nothing to compile
 
-            if (client) {
-                if (opt.fileNameSpaceClient && *opt.fileNameSpaceClient) opt.config.fileName = opt.fileNameSpaceClient;
-            }
-            else {
-                if (opt.fileNameSpaceServer && *opt.fileNameSpaceServer) opt.config.fileName = opt.fileNameSpaceServer;
-            }
+                CompilerConfig& config{ targets.emplace_back(baseConfig).config };
+                config.name = name;
+                config.clientScript = client;
+                config.checksum = client ? opt.crcClient : opt.crcServer;
 
+                if (!config.checksum) {
+                    config.checksum = (int32_t)handler->GetDefaultChecksum(client);
+                }
 
-            std::vector<std::filesystem::path> files{};
-            for (const std::filesystem::path& file : inputs) {
-                auto ext = file.extension();
                 if (client) {
-                    if (ext != ".csc" && ext != ".gcsc") {
-                        continue;
-                    }
+                    if (opt.fileNameSpaceClient && *opt.fileNameSpaceClient) config.fileName = opt.fileNameSpaceClient;
                 }
                 else {
-                    if (ext != ".gsc" && ext != ".gcsc") {
-                        continue;
-                    }
+                    if (opt.fileNameSpaceServer && *opt.fileNameSpaceServer) config.fileName = opt.fileNameSpaceServer;
                 }
-                files.emplace_back(file);
-            }
 
-            if (files.empty()) return tool::OK; // nothing to compile
-            std::vector<byte> data{};
-
-            LOG_TRACE("Compile tree");
-
-            std::string preprocout{};
-            if (opt.m_preproc) {
-                opt.config.preprocOutput = &preprocout;
-            }
-
-            std::unordered_set<std::string> hashes{};
+                if (preprocOut) {
+                    config.preprocOutput = preprocOut;
+                }
 
-            if (opt.hashFile) {
-                opt.config.hashes = &hashes;
+                if (opt.hashFile) {
+                    config.hashes = &hashes[client];
+                }
             }
 
-            CompileGsc(inputs, data, opt.config);
-
-            if (opt.m_preproc) {
-                utils::WriteFile(opt.m_preproc, *opt.config.preprocOutput);
-            }
+            if (targets.empty()) return tool::OK;
 
-            const char* outFile{ utils::va("%s.%s", opt.m_outFileName, client ? "cscc" : "gscc")};
-            std::filesystem::path outPath{ outFile };
+            LOG_TRACE("Compile tree");
 
-            if (outPath.has_parent_path()) {
-                std::filesystem::create_directories(outPath.parent_path());
-            }
+            // write each target once it is compiled, an error in the client doesn't lose the server output
+            int ret{ tool::OK };
+            CompileGsc(inputs, targets, [&opt, &hashes, outFileName, &ret](CompilerTarget& target) -> bool {
+                bool client{ target.config.clientScript };
+                VmInfo* vmInfo{ target.config.GetVm() };
+                const char* outFile{ utils::va("%s.%s", outFileName, client ? "cscc" : "gscc")};
+                std::filesystem::path outPath{ outFile };
 
-            if (!utils::WriteFile(outFile, (const void*)data.data(), data.size())) {
-                LOG_ERROR("Error when writing out file");
-                return tool::BASIC_ERROR;
-            }
-            LOG_INFO("Done into {} ({}/{})", outFile, vmInfo->codeName, PlatformName(opt.config.platform));
+                if (outPath.has_parent_path()) {
+                    std::error_code ec{};
+                    std::filesystem::create_directories(outPath.parent_path(), ec);
+                }
 
-            if (opt.hashFile) {
-                const char* outFileHash{ utils::va("%s.hash", outFile) };
-                utils::OutFileCE hos{ outFileHash };
-                if (!hos) {
-                    LOG_ERROR("Can't open hash file {}", outFileHash);
-                    return tool::BASIC_ERROR;
+                if (!utils::WriteFile(outFile, (const void*)target.data.data(), target.data.size())) {
+                    LOG_ERROR("Error when writing out file");
+                    ret = tool::BASIC_ERROR;
+                    return false;
                 }
-                else {
-                    for (const std::string& str : hashes) {
-                        hos << str << "\n";
+                LOG_INFO("Done into {} ({}/{})", outFile, vmInfo->codeName, PlatformName(target.config.platform));
+
+                if (opt.hashFile) {
+                    const char* outFileHash{ utils::va("%s.hash", outFile) };
+                    utils::OutFileCE hos{ outFileHash };
+                    if (!hos) {
+                        LOG_ERROR("Can't open hash file {}", outFileHash);
+                        ret = tool::BASIC_ERROR;
+                        return false;
+                    }
+                    else {
+                        // sorted to have the same dump with any number of threads
+                        std::set<std::string> hashesSorted{ hashes[client].begin(), hashes[client].end() };
+                        for (const std::string& str : hashesSorted) {
+                            hos << str << "\n";
+                        }
+                        LOG_INFO("Hashes dumped into {}", outFileHash);
                     }
-                    LOG_INFO("Hashes dumped into {}", outFileHash);
                 }
-            }
+                return true;
+            });
 
-            return tool::OK;
+            return ret;
         };
 
         if (opt.oneFilePerComp) {
             // create one per file
-            char outnameDir[0x200]{};
+            struct FileToCompile {
+                std::filesystem::path path;
+                std::string trueFileName;
+                std::string outFileName;
+                std::string outFileNameNE;
+                std::string fileNamespace;
+            };
+            struct FileCompiled {
+                int ret{ tool::OK };
+                std::string preproc{};
+                std::vector<core::logs::bufferedlog> logs{};
+            };
+
             std::filesystem::path outDir{ opt.m_outFileName };
-            int ret{ tool::OK };
+            std::vector<FileToCompile> toCompile{};
             std::vector<std::filesystem::path> inputs{};
-            std::vector<std::filesystem::path> singleInputs{};
             for (const char* file : opt.m_inputFiles) {
                 std::filesystem::path base{ file };
                 inputs.clear();
@@ -6040,49 +6981,116 @@ namespace acts::compiler {
                     auto ext{ path.extension() };
                     if (ext != ".gsc" && ext != ".csc" && ext != ".gcsc" && ext != ".gcsc") continue;
 
+                    FileToCompile& ftc{ toCompile.emplace_back() };
+                    ftc.path = path;
+
                     std::filesystem::path trueFileName{ std::filesystem::relative(path, base) };
                     std::filesystem::path outFile{ outDir / trueFileName };
 
-
-                    std::string outFileName{ outFile.string() };
-                    LOG_INFO("Compiling {} into {}", trueFileName.string(), outFileName);
+                    ftc.trueFileName = trueFileName.string();
+                    ftc.outFileName = outFile.string();
                     outFile.replace_extension();
-                    std::string outFileNameNE{ outFile.string() };
+                    ftc.outFileNameNE = outFile.string();
 
-                    opt.config.name = outFileName.data();
-                    std::string fileNamespace;
                     if (vmInfo->HasFlag(VmFlags::VMF_FULL_FILE_NAMESPACE)) {
-                        fileNamespace = outFileName;
+                        ftc.fileNamespace = ftc.outFileName;
                     }
                     else {
-                        fileNamespace = outFile.filename().string();
+                        ftc.fileNamespace = outFile.filename().string();
                     }
-                    opt.config.fileName = fileNamespace.data();
-                    opt.m_outFileName = outFileNameNE.data();
+                }
+            }
 
-                    singleInputs.clear();
-                    singleInputs.push_back(path);
+            auto compileFile = [&opt, &produceFiles](const FileToCompile& ftc, FileCompiled& res) {
+                LOG_INFO("Compiling {} into {}", ftc.trueFileName, ftc.outFileName);
 
-                    try {
-                        int sret;
-                        
-                        if (ext == ".gsc" || ext == ".gcsc") {
-                            sret = produceFile(false, singleInputs);
-                            if (sret != tool::OK) ret = sret;
-                        }
+                CompilerConfig config{ opt.config };
+                config.fileName = ftc.fileNamespace.data();
 
-                        if (ext == ".csc" || ext == ".gcsc") {
-                            sret = produceFile(true, singleInputs);
-                            if (sret != tool::OK) ret = sret;
-                        }
-                    }
-                    catch (std::runtime_error& err) {
-                        LOG_ERROR("Error when compiling: {}", err.what());
-                        ret = tool::BASIC_ERROR;
-                    }
+                std::vector<std::filesystem::path> singleInputs{ ftc.path };
+                std::string* preproc{ opt.m_preproc ? &res.preproc : nullptr };
+
+                try {
+                    // the targets are selected with the file extension
+                    int sret{ produceFiles(config, ftc.outFileNameNE.data(), ftc.outFileName.data(), ftc.outFileName.data(), singleInputs, preproc) };
+                    if (sret != tool::OK) res.ret = sret;
+                }
+                catch (std::exception& err) {
+                    LOG_ERROR("Error when compiling: {}", err.what());
+                    res.ret = tool::BASIC_ERROR;
+                }
+                catch (...) {
+                    LOG_ERROR("Unknown error when compiling {}", ftc.trueFileName);
+                    res.ret = tool::BASIC_ERROR;
+                }
+            };
+
+            int ret{ tool::OK };
+            auto mergeFile = [&opt, &ret](FileCompiled& res) {
+                core::logs::flushbuffer(res.logs);
+                res.logs.clear();
+                if (opt.m_preproc && !res.preproc.empty()) {
+                    utils::WriteFile(opt.m_preproc, res.preproc);
+                }
+                if (res.ret != tool::OK) {
+                    ret = res.ret;
+                }
+            };
+
+            if (opt.m_threads == 1 || toCompile.size() <= 1) {
+                for (const FileToCompile& ftc : toCompile) {
+                    FileCompiled res{};
+                    compileFile(ftc, res);
+                    mergeFile(res);
+                }
+                if (compileCache) compileCache->PrintStats();
+                return ret;
+            }
+
+            uint64_t prevAsyncTypes = core::async::GetAsyncTypes();
+            core::async::SetAsync(core::async::AT_ALL);
+
+            // load the hashes and the opcodes before starting the workers
+            hashutils::ReadDefaultFile();
+            RegisterOpCodesMap();
+            // the files are already compiled in parallel
+            opt.config.threads = 1;
+
+            // the diagnostics are buffered by each worker and printed in the input order, the results are declared
+            // before the pool to be destroyed after its workers
+            std::vector<FileCompiled> results(toCompile.size());
+            std::vector<std::future<void>> futures{};
+            futures.reserve(toCompile.size());
+
+            // 0 = hardware concurrency
+            BS::thread_pool pool{ (BS::concurrency_t)opt.m_threads };
+            LOG_INFO("Compiling {} file(s) using {} thread(s)", toCompile.size(), pool.get_thread_count());
+
+            for (size_t i = 0; i < toCompile.size(); i++) {
+                futures.emplace_back(pool.submit_task([i, &toCompile, &results, &compileFile] {
+                    core::logs::setthreadbuffer(&results[i].logs);
+                    utils::CloseEnd ce{ [] { core::logs::setthreadbuffer(nullptr); } };
+                    compileFile(toCompile[i], results[i]);
+                }));
+            }
+
+            // wait for all the files before rethrowing an error, the workers are still using the results
+            std::exception_ptr err{};
+            for (size_t i = 0; i < futures.size(); i++) {
+                try {
+                    futures[i].get();
+                }
+                catch (...) {
+                    if (!err) err = std::current_exception();
                 }
+                mergeFile(results[i]);
+            }
 
+            core::async::SetAsync(prevAsyncTypes);
+            if (err) {
+                std::rethrow_exception(err);
             }
+            if (compileCache) compileCache->PrintStats();
             return ret;
         }
         else {
@@ -6092,15 +7100,17 @@ namespace acts::compiler {
                 utils::GetFileRecurse(file, inputs);
             }
 
+            std::string preproc{};
+            std::string* preprocOut{ opt.m_preproc ? &preproc : nullptr };
+
             // build csc/gsc
-            opt.config.name = opt.nameServer;
-            int ret = produceFile(false, inputs);
+            int ret = produceFiles(opt.config, opt.m_outFileName, opt.nameServer, opt.nameClient, inputs, preprocOut);
 
-            if (ret) {
-                return ret;
+            if (opt.m_preproc) {
+                utils::WriteFile(opt.m_preproc, preproc);
             }
-            opt.config.name = opt.nameClient;
-            return produceFile(true, inputs);
+            if (compileCache) compileCache->PrintStats();
+            return ret;
         }
     }
     int gscc_pack(Process& proc, int argc, const char* argv[]) {
@@ -6159,89 +7169,671 @@ namespace acts::compiler {
     }
 
 
-    void CompileGsc(const std::vector<std::filesystem::path>& files, std::vector<byte>& data, CompilerConfig& config) {
-        VmInfo* vmInfo{ config.GetVm() };
+    namespace {
+        // lexed and parsed sources, shared by the targets with the same preprocessed sources
+        struct ParsedSource {
+            std::string data;
+            ANTLRInputStream is;
+            gscLexer lexer;
+            CommonTokenStream tokens;
+            gscParser parser;
+            gscParser::ProgContext* prog{};
+            size_t errors{};
+            // the fast SLL parse failed and the sources were parsed again with LL
+            bool llFallback{};
+            std::chrono::steady_clock::duration parseTime{};
+
+            ParsedSource(std::string&& src, ACTSErrorListener& errList) : data(std::move(src)), is(data), lexer(&is), tokens(&lexer), parser(&tokens) {
+                auto start{ std::chrono::steady_clock::now() };
+                lexer.addErrorListener(&errList);
+                tokens.fill();
+
+                // two stage parsing, SLL is faster and enough for most of the files, but it can't report
+                // the syntax errors, on failure the file is parsed again with LL to get the same diagnostics.
+                // The ATN/DFA caches are static in the generated parser, so they are shared by all the files.
+                parser.removeErrorListeners();
+                parser.setErrorHandler(std::make_shared<BailErrorStrategy>());
+                parser.getInterpreter<atn::ParserATNSimulator>()->setPredictionMode(atn::PredictionMode::SLL);
+
+                try {
+                    prog = parser.prog();
+                }
+                catch (ParseCancellationException&) {
+                    llFallback = true;
+                    parser.reset(); // also reset the token stream
+                    parser.addErrorListener(&errList);
+                    parser.setErrorHandler(std::make_shared<DefaultErrorStrategy>());
+                    parser.getInterpreter<atn::ParserATNSimulator>()->setPredictionMode(atn::PredictionMode::LL);
+
+                    prog = parser.prog();
+                }
+                errors = parser.getNumberOfSyntaxErrors();
+                parseTime = std::chrono::steady_clock::now() - start;
+            }
+        };
+
+        void SetupPreProcessorDefines(CompilerConfig& config) {
+            VmInfo* vmInfo{ config.GetVm() };
+            preprocessor::PreProcessorOption& popt = config.processorOpt;
+            popt.defines.insert("_SUPPORTS_GCSC");
+            if (config.detourType) {
+                popt.defines.insert("_SUPPORTS_DETOURS");
+            }
+            popt.defines.insert(utils::UpperCase(utils::va("_%s", vmInfo->codeName)));
+            popt.defines.insert(utils::MapString(utils::va("_%s", PlatformName(config.platform)), [](char c) -> char { return isspace(c) ? '_' : std::toupper(c); }));
+
+            if (tool::gsc::opcode::HasOpCode(config.vm, config.platform, OPCODE_T8C_GetLazyFunction)) {
+                popt.defines.insert("_SUPPORTS_LAZYLINK");
+            }
+
+            if (config.clientScript) {
+                popt.defines.insert("_CSC");
+            }
+            else {
+                popt.defines.insert("_GSC");
+            }
+        }
+
+        void CompileParsedSource(CompilerConfig& config, InputInfo& info, ParsedSource& src, std::vector<byte>& data) {
+            VmInfo* vmInfo{ config.GetVm() };
+            auto* readerBuilder = tool::gsc::GetGscReader(vmInfo->vmMagic);
+
+            if (!readerBuilder) {
+                throw std::runtime_error(std::format("No GSC handler available for {}", vmInfo->name));
+            }
+
+            std::shared_ptr<tool::gsc::GSCOBJHandler> handler{ (*readerBuilder)(nullptr, 0) };
+
+            // all the nodes of the object are allocated in the arena, it must be destroyed after the object
+            AscmNodeArena arena{};
+            CompileObject obj{ config, config.clientScript ? FILE_CSC : FILE_GSC, info, handler };
+
+            if (src.errors) {
+                throw std::runtime_error(std::format("{} error(s) detected, abort", src.errors));
+            }
+
+            LOG_TRACE("Parse tree");
+
+            if (!ParseProg(src.prog, src.parser, obj)) {
+                throw std::runtime_error("Error when parsing the object");
+            }
+
+
+            RegisterOpCodesMap();
+
+            if (!obj.Compile(data)) {
+                throw std::runtime_error("Error when compiling the object");
+            }
+        }
+    }
+
+    void CompileGsc(const std::vector<std::filesystem::path>& files, std::vector<CompilerTarget>& targets, const std::function<bool(CompilerTarget& target)>& compiled) {
         InputInfo info{};
         for (const std::filesystem::path& file : files) {
-            auto ext = file.extension();
-
             if (!info.container.AppendFile(file)) {
                 throw std::runtime_error(std::format("Can't read file {}", file.string()));
             }
         }
 
-        preprocessor::PreProcessorOption& popt = config.processorOpt;
-        popt.defines.insert("_SUPPORTS_GCSC");
-        if (config.detourType) {
-            popt.defines.insert("_SUPPORTS_DETOURS");
-        }
-        popt.defines.insert(utils::UpperCase(utils::va("_%s", vmInfo->codeName)));
-        popt.defines.insert(utils::MapString(utils::va("_%s", PlatformName(config.platform)), [](char c) -> char { return isspace(c) ? '_' : std::toupper(c); }));
+        // the preprocessor is only blanking the sources, the line mapping of the container is the same for all the targets
+        std::string rawData{ info.container.data };
+        ACTSErrorListener errList{ info };
+        std::vector<std::unique_ptr<ParsedSource>> sources{};
 
-        if (tool::gsc::opcode::HasOpCode(config.vm, config.platform, OPCODE_T8C_GetLazyFunction)) {
-            popt.defines.insert("_SUPPORTS_LAZYLINK");
-        }
+        auto compileTarget = [&](CompilerTarget& target) {
+            CompilerConfig& config{ target.config };
+            SetupPreProcessorDefines(config);
+
+            std::string data{ rawData };
+            if (!config.processorOpt.ApplyPreProcessor(data,
+                [&info](core::logs::loglevel lvl, size_t line, const std::string& message) { info.container.PrintLineMessage(lvl, line, 0, message); })) {
+                throw std::runtime_error("Error when applying preprocessor on data");
+            }
+
+            if (config.preprocOutput) {
+                *config.preprocOutput = data;
+            }
+
+            uint64_t cacheKey{};
+            if (config.cache) {
+                cacheKey = config.cache->ComputeKey(config, info.container, data);
+
+                cache::CompilerCacheEntry entry{};
+                if (config.cache->Load(cacheKey, entry)) {
+                    LOG_DEBUG("Cache hit for {} ({:x})", config.clientScript ? "csc" : "gsc", cacheKey);
+                    // replay the hashes added and the warnings printed by the compiler
+                    for (const std::string& str : entry.hashes) {
+                        hashutils::Add(str.data());
+                        if (config.hashes) config.hashes->insert(str);
+                    }
+                    core::logs::flushbuffer(entry.diagnostics);
+                    target.data = std::move(entry.data);
+                    return;
+                }
+            }
+
+            // only lex/parse the sources if another target didn't already do it
+            auto it = std::find_if(sources.begin(), sources.end(), [&data](const std::unique_ptr<ParsedSource>& src) { return src->data == data; });
+
+            ParsedSource* src;
+            if (it != sources.end()) {
+                src = it->get();
+                LOG_TRACE("Reusing parse tree for {}", config.clientScript ? "csc" : "gsc");
+            }
+            else {
+                src = sources.emplace_back(std::make_unique<ParsedSource>(std::move(data), errList)).get();
+                LOG_DEBUG("Parsed {} in {}ms ({})",
+                    info.container.blocks.empty() ? "" : info.container.blocks[0].filename.string(),
+                    std::chrono::duration_cast<std::chrono::milliseconds>(src->parseTime).count(),
+                    src->llFallback ? "LL" : "SLL"
+                );
+            }
 
-        if (config.clientScript) {
-            popt.defines.insert("_CSC");
+            if (!config.cache) {
+                CompileParsedSource(config, info, *src, target.data);
+                return;
+            }
+
+            // capture the hashes added and the logs printed by the compiler to replay them on a hit
+            std::unordered_set<std::string> hashes{};
+            std::unordered_set<std::string>* outHashes{ config.hashes };
+            std::vector<core::logs::bufferedlog> logs{};
+            std::vector<core::logs::bufferedlog>* outLogs{ core::logs::getthreadbuffer() };
+            config.hashes = &hashes;
+            core::logs::setthreadbuffer(&logs);
+            {
+                utils::CloseEnd ce{ [&config, outHashes, outLogs, &logs] {
+                    config.hashes = outHashes;
+                    core::logs::setthreadbuffer(outLogs);
+                    core::logs::flushbuffer(logs);
+                } };
+                CompileParsedSource(config, info, *src, target.data);
+            }
+
+            cache::CompilerCacheEntry entry{};
+            entry.data = target.data;
+            entry.hashes.insert(entry.hashes.end(), hashes.begin(), hashes.end());
+            if (outHashes) outHashes->insert(hashes.begin(), hashes.end());
+            for (core::logs::bufferedlog& log : logs) {
+                if (log.level >= core::logs::LVL_WARNING) {
+                    entry.diagnostics.emplace_back(std::move(log));
+                }
+            }
+
+            config.cache->Store(cacheKey, entry);
+        };
+
+        for (CompilerTarget& target : targets) {
+            compileTarget(target);
+            if (compiled && !compiled(target)) {
+                return;
+            }
         }
-        else {
-            popt.defines.insert("_GSC");
+    }
+
+    void CompileGsc(const std::vector<std::filesystem::path>& files, std::vector<byte>& data, CompilerConfig& config) {
+        std::vector<CompilerTarget> targets{};
+        targets.emplace_back(config);
+
+        CompileGsc(files, targets);
+
+        config = targets[0].config;
+        data = std::move(targets[0].data);
+    }
+
+    namespace {
+        void gsccompilebench(acts::unit_test::BenchmarkContext& ctx) {
+            CompilerConfig cfg{};
+            cfg.vm = VMOf(ctx.vm);
+            cfg.platform = PlatformOf(ctx.platform);
+
+            if (!cfg.vm || !cfg.platform) {
+                throw std::runtime_error(std::format("Invalid vm/platform {}/{}", ctx.vm, ctx.platform));
+            }
+
+            for (const std::filesystem::path& path : ctx.GetCorpusFiles("gsc-compiler", ".gsc\0.csc\0")) {
+                std::string name{ path.filename().string() };
+                std::vector<std::filesystem::path> files{ path };
+                std::vector<byte> data{};
+                std::error_code ec{};
+                size_t size{ (size_t)std::filesystem::file_size(path, ec) };
+
+                ctx.Measure(size, [&]() -> bool {
+                    // the preprocessor is adding the defines in the config
+                    CompilerConfig fileCfg{ cfg };
+                    fileCfg.clientScript = path.extension() == ".csc";
+                    fileCfg.name = name.data();
+                    data.clear();
+                    try {
+                        CompileGsc(files, data, fileCfg);
+                        return true;
+                    }
+                    catch (std::runtime_error& e) {
+                        LOG_DEBUG("Can't compile {}: {}", path.string(), e.what());
+                        return false;
+                    }
+                });
+            }
         }
 
-        if (!popt.ApplyPreProcessor(info.container.data,
-            [&info](core::logs::loglevel lvl, size_t line, const std::string& message) { info.container.PrintLineMessage(lvl, line, 0, message); })) {
-            throw std::runtime_error("Error when applying preprocessor on data");
+        void gscpreprocessortest() {
+            std::string base{};
+            ASSERT_VAL("read preproc.gsc", utils::ReadFile("test/gsc-parser/preproc.gsc", base));
+            size_t baseLines{ (size_t)std::count(base.begin(), base.end(), '\n') + 1 };
+
+            std::string extra{ "\n#warning warn msg\n#ifndef AAA\nnot aaa\n#endif\n#error error msg\n" };
+            std::string data{ base + extra };
+            std::vector<std::tuple<core::logs::loglevel, size_t, std::string>> messages{};
+
+            preprocessor::PreProcessorOption opt{};
+            bool ok{ opt.ApplyPreProcessor(data, [&messages](core::logs::loglevel lvl, size_t line, const std::string& message) {
+                messages.emplace_back(lvl, line, message);
+            }) };
+            ASSERT_VAL("error directive", !ok);
+
+            // the lines are blanked in place
+            ASSERT_EQ("size", base.size() + extra.size(), data.size());
+            ASSERT_EQ("lines", baseLines + 5, (size_t)std::count(data.begin(), data.end(), '\n'));
+
+            // only the aaa lines of the nested #ifdef/#else are kept
+            std::vector<std::string> kept{};
+            std::istringstream is{ data };
+            for (std::string line; std::getline(is, line);) {
+                size_t start{ line.find_first_not_of(" \t\r") };
+                if (start != std::string::npos) {
+                    kept.push_back(line.substr(start, line.find_last_not_of(" \t\r") - start + 1));
+                }
+            }
+            ASSERT_EQ("kept lines", (size_t)2, kept.size());
+            ASSERT_VAL("kept aaa", std::all_of(kept.begin(), kept.end(), [](const std::string& l) { return l == "aaa"; }));
+
+            ASSERT_EQ("messages", (size_t)2, messages.size());
+            if (messages.size() == 2) {
+                ASSERT_VAL("warning level", std::get<0>(messages[0]) == core::logs::LVL_WARNING);
+                ASSERT_EQ("warning line", baseLines + 1, std::get<1>(messages[0]));
+                ASSERT_EQ("warning message", std::string{ "warn msg" }, std::get<2>(messages[0]));
+                ASSERT_VAL("error level", std::get<0>(messages[1]) == core::logs::LVL_ERROR);
+                ASSERT_EQ("error line", baseLines + 5, std::get<1>(messages[1]));
+                ASSERT_EQ("error message", std::string{ "error msg" }, std::get<2>(messages[1]));
+            }
         }
 
-        if (config.preprocOutput) {
-            *config.preprocOutput = info.container.data;
+        // script written in the temp directory for a test, the file is removed with the object
+        class TestScript {
+            std::filesystem::path path;
+            std::string name;
+        public:
+            TestScript(const char* fileName, const std::string& data)
+                : path(std::filesystem::temp_directory_path() / fileName), name(utils::va("scripts/%s", fileName)) {
+                utils::WriteFile(path, data);
+            }
+
+            ~TestScript() {
+                std::error_code ec{};
+                std::filesystem::remove(path, ec);
+            }
+
+            /*
+             * Create a config to compile the script
+             * @param vm vm
+             * @return config
+             */
+            CompilerConfig Config(const char* vm = "t9") const {
+                CompilerConfig cfg{};
+                cfg.vm = VMOf(vm);
+                cfg.platform = PLATFORM_PC;
+                cfg.name = name.data();
+                return cfg;
+            }
+
+            /*
+             * Compile the script
+             * @param cfg config
+             * @return compiled script
+             */
+            std::vector<byte> Compile(CompilerConfig& cfg) const {
+                std::vector<byte> data{};
+                CompileGsc(std::vector<std::filesystem::path>{ path }, data, cfg);
+                return data;
+            }
+        };
+
+        struct OptimizerTestRun {
+            // seconds waited by the script
+            int64_t time{};
+            // executed instructions, only counted with the profiler
+            uint64_t instructions{};
+        };
+
+        /*
+         * Run the autoexec of a script compiled for the acts vm until its end
+         * @param data compiled script
+         * @param predecode use the predecoded code
+         * @return run
+         */
+        OptimizerTestRun RunActsVmScript(const std::vector<byte>& data, bool predecode) {
+            // the vm is reading the script in place, it is aligned like a loaded script
+            std::vector<uint64_t> script((data.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+            std::memcpy(script.data(), data.data(), data.size());
+            acts::vm::ActScript* header{ (acts::vm::ActScript*)script.data() };
+
+            acts::vm::ActsVmConfig cfg{};
+            cfg.getterFunction = [header](uint64_t name) -> acts::vm::ActScript* {
+                return header->name == name ? header : nullptr;
+            };
+            cfg.hashToString = [](uint64_t hash) -> const char* { return utils::va("%llx", hash); };
+            cfg.predecode = predecode;
+#ifdef ACTS_VM_PROFILER
+            cfg.profile = true;
+#endif
+            auto vm{ std::make_unique<acts::vm::ActsVm>(cfg) };
+            vm->LoadScript(header->name);
+
+            // one frame per second, the script is only waiting integer times
+            OptimizerTestRun run{};
+            while (vm->GetThreadsCount()) {
+                ASSERT_VAL("script end", run.time < 1000);
+                run.time++;
+                vm->RunFrame(run.time * 1000);
+            }
+#ifdef ACTS_VM_PROFILER
+            run.instructions = vm->GetProfiler()->GetInstructions();
+#endif
+            return run;
+        }
+
+        void gscoptimizertest() {
+            // the taken branches are waiting different powers of 2, so the waited time is giving the executed path
+            TestScript script{ "acts_optimizer_test.gsc", std::string{
+                "function autoexec test() {\n"
+                "    wait (2 * 3 + 4 - 9);\n"
+                "    if (0) {\n"
+                "        wait 64;\n"
+                "    }\n"
+                "    if (3 - 3) {\n"
+                "        wait 64;\n"
+                "    } else {\n"
+                "        wait 2;\n"
+                "    }\n"
+                "    while (1) {\n"
+                "        if (2 * 2 - 4 + 1) {\n"
+                "            break;\n"
+                "        }\n"
+                "        wait 64;\n"
+                "    }\n"
+                "    do {\n"
+                "        wait 4;\n"
+                "    } while (0);\n"
+                "    if (1) {\n"
+                "        if (1) {\n"
+                "            wait 8;\n"
+                "        }\n"
+                "    }\n"
+                "    wait 16;\n"
+                "    return;\n"
+                "    wait 32;\n"
+                "}\n"
+            });
+            constexpr int64_t expectedTime = 1 + 2 + 4 + 8 + 16;
+
+            auto compile = [&script](bool optimize) -> std::vector<byte> {
+                CompilerConfig cfg{ script.Config("acts") };
+                cfg.optimize = optimize;
+                return script.Compile(cfg);
+            };
+
+            std::vector<byte> base{ compile(false) };
+            std::vector<byte> optimized{ compile(true) };
+
+            ASSERT_VAL("optimized script size", optimized.size() < base.size());
+
+            for (bool predecode : { false, true }) {
+                OptimizerTestRun baseRun{ RunActsVmScript(base, predecode) };
+                OptimizerTestRun optimizedRun{ RunActsVmScript(optimized, predecode) };
+
+                ASSERT_EQ("base script result", expectedTime, baseRun.time);
+                ASSERT_EQ("optimized script result", expectedTime, optimizedRun.time);
+#ifdef ACTS_VM_PROFILER
+                ASSERT_VAL("optimized instructions", optimizedRun.instructions < baseRun.instructions);
+#endif
+            }
         }
 
-        ANTLRInputStream is{ info.container.data };
+        void gsccompilecachetest() {
+            std::filesystem::path dir{ std::filesystem::temp_directory_path() / "acts_compile_cache_test" };
+            std::error_code ec{};
+            std::filesystem::remove_all(dir, ec);
+            TestScript script{ "acts_cache_test.gsc", std::string{
+                "function test() {\n"
+                "    12;\n"
+                "}\n"
+            });
 
-        auto errList = std::make_unique<ACTSErrorListener>(info);
+            core::logs::loglevel level{ core::logs::getlevel() };
+            core::logs::setlevel(core::logs::LVL_WARNING);
+            utils::CloseEnd ce{ [level, &dir] {
+                core::logs::setlevel(level);
+                std::error_code ec{};
+                std::filesystem::remove_all(dir, ec);
+            } };
 
-        gscLexer lexer{ &is };
-        lexer.addErrorListener(&*errList);
-        CommonTokenStream tokens{ &lexer };
+            cache::CompilerCache cache{ dir, hash::Hash64("gsccompilecachetest") };
+            // compile and return the printed warnings
+            auto compile = [&script, &cache](std::vector<byte>& data) -> std::vector<std::string> {
+                CompilerConfig cfg{ script.Config() };
+                cfg.cache = &cache;
 
-        tokens.fill();
-        gscParser parser{ &tokens };
+                std::vector<core::logs::bufferedlog> logs{};
+                core::logs::setthreadbuffer(&logs);
+                {
+                    utils::CloseEnd lce{ [] { core::logs::setthreadbuffer(nullptr); } };
+                    data = script.Compile(cfg);
+                }
 
-        parser.removeErrorListeners();
+                std::vector<std::string> warnings{};
+                for (const core::logs::bufferedlog& log : logs) {
+                    if (log.level == core::logs::LVL_WARNING) {
+                        warnings.push_back(log.str);
+                    }
+                }
+                return warnings;
+            };
 
-        parser.addErrorListener(&*errList);
+            std::vector<byte> cold{};
+            std::vector<byte> hot{};
+            std::vector<std::string> coldWarnings{ compile(cold) };
+            std::vector<std::string> hotWarnings{ compile(hot) };
+
+            ASSERT_EQ("cache hits", (size_t)1, cache.GetHits());
+            ASSERT_VAL("cached data", cold == hot);
+            ASSERT_VAL("cold warnings", !coldWarnings.empty());
+            ASSERT_VAL("replayed warnings", coldWarnings == hotWarnings);
+        }
+
+        void gscstripunusedtest() {
+            TestScript script{ "acts_strip_test.gsc", std::string{
+                "function private used_helper(a) {\n"
+                "    return a + 1;\n"
+                "}\n"
+                "function private unused_helper(a) {\n"
+                "    iprintlnbold(\"unused string\");\n"
+                "    return unused_helper2(a);\n"
+                "}\n"
+                "function private unused_helper2(a) {\n"
+                "    return level.acts_unused_global + a;\n"
+                "}\n"
+                "function test(a) {\n"
+                "    return used_helper(a);\n"
+                "}\n"
+            });
 
-        gscParser::ProgContext* prog = parser.prog();
+            auto compile = [&script](bool strip) -> size_t {
+                CompilerConfig cfg{ script.Config() };
+                cfg.stripUnused = strip;
+                return script.Compile(cfg).size();
+            };
 
-        auto* readerBuilder = tool::gsc::GetGscReader(vmInfo->vmMagic);
+            size_t base{ compile(false) };
+            size_t stripped{ compile(true) };
 
-        if (!readerBuilder) {
-            throw std::runtime_error(std::format("No GSC handler available for {}", vmInfo->name));
+            ASSERT_VAL("stripped script size", stripped < base);
         }
 
-        std::shared_ptr<tool::gsc::GSCOBJHandler> handler{ (*readerBuilder)(nullptr, 0) };
+        void gscparallelcodegentest() {
+            std::ostringstream os{};
+            for (size_t i = 0; i < CompileObject::MIN_PARALLEL_FUNCTIONS * 2; i++) {
+                os << "function test" << i << "(a, b) {\n"
+                    << "    c = \"str" << (i % 7) << "\";\n"
+                    << "    for (i = 0; i < a; i++) {\n"
+                    << "        if (i % " << (i + 2) << ") {\n"
+                    << "            b = b + i * " << i << ";\n"
+                    << "        }\n"
+                    << "    }\n"
+                    << "    return test" << ((i + 1) % (CompileObject::MIN_PARALLEL_FUNCTIONS * 2)) << "(b, c);\n"
+                    << "}\n";
+            }
+            TestScript script{ "acts_codegen_test.gsc", os.str() };
+
+            for (const char* vm : { "t9", "acts" }) {
+                auto compile = [&script, vm](size_t threads) -> std::vector<byte> {
+                    CompilerConfig cfg{ script.Config(vm) };
+                    cfg.threads = threads;
+                    return script.Compile(cfg);
+                };
 
-        CompileObject obj{ config, config.clientScript ? FILE_CSC : FILE_GSC, info, handler };
+                // with 1 thread the functions are placed and written one by one, the layout before the parallel generation
+                std::vector<byte> serial{ compile(1) };
+                std::vector<byte> parallel{ compile(4) };
 
-        auto error = parser.getNumberOfSyntaxErrors();
-        if (error) {
-            throw std::runtime_error(std::format("{} error(s) detected, abort", error));
+                ASSERT_VAL(utils::va("parallel code generation %s", vm), serial == parallel);
+            }
         }
 
-        LOG_TRACE("Parse tree");
+        // compile server running in a thread of the current process
+        class TestCompileServer {
+            std::string pipeName{ utils::va("acts-gscc-test-%lx", GetCurrentProcessId()) };
+            std::thread thread;
+        public:
+            TestCompileServer() : thread([this] {
+                    Process proc{ (const wchar_t*)nullptr };
+                    server::RunServer(proc, pipeName.data(), compiler);
+                }) {
+                // wait for the pipe creation
+                std::string pipePath{ std::format("\\\\.\\pipe\\{}", pipeName) };
+                for (size_t i = 0; i < 500 && !WaitNamedPipeA(pipePath.data(), NMPWAIT_USE_DEFAULT_WAIT); i++) {
+                    std::this_thread::sleep_for(std::chrono::milliseconds(10));
+                }
+            }
+
+            ~TestCompileServer() {
+                int ret;
+                server::SendRequest(pipeName.data(), server::SRT_STOP, {}, ret);
+                thread.join();
+            }
+
+            int Compile(const std::vector<const char*>& args) {
+                int ret{};
+                if (!server::SendRequest(pipeName.data(), server::SRT_COMPILE, args, ret)) {
+                    return tool::BASIC_ERROR;
+                }
+                return ret;
+            }
+        };
+
+        void gsccompileservertest() {
+            std::filesystem::path dir{ std::filesystem::temp_directory_path() / "acts_server_test" };
+            std::filesystem::create_directories(dir);
+            std::filesystem::path path{ dir / "acts_server_test.gsc" };
+            utils::WriteFile(path, std::string{
+                "function test(a) {\n"
+                "    for (i = 0; i < a; i++) {\n"
+                "        b = a * i + 3;\n"
+                "    }\n"
+                "    return b;\n"
+                "}\n"
+            });
+            std::string pathStr{ path.string() };
+            std::string coldOut{ (dir / "cold").string() };
+            std::string serverOut{ (dir / "server").string() };
+
+            {
+                Process proc{ (const wchar_t*)nullptr };
+                const char* argv[]{ "acts", "gscc", "-g", "t9", "-p", "pc", "--name", "scripts/acts_server_test.gsc", "-o", coldOut.data(), pathStr.data() };
+                ASSERT_EQ("cold compile", tool::OK, compiler(proc, (int)ARRAYSIZE(argv), argv));
+            }
+            {
+                TestCompileServer server{};
+                ASSERT_EQ("server compile", tool::OK, server.Compile({ "-g", "t9", "-p", "pc", "--name", "scripts/acts_server_test.gsc", "-o", serverOut.data(), pathStr.data() }));
+            }
+
+            std::string coldData{};
+            std::string serverData{};
+            ASSERT_VAL("read cold output", utils::ReadFile(coldOut + ".gscc", coldData));
+            ASSERT_VAL("read server output", utils::ReadFile(serverOut + ".gscc", serverData));
+            std::error_code ec{};
+            std::filesystem::remove_all(dir, ec);
 
-        if (!ParseProg(prog, parser, obj)) {
-            throw std::runtime_error("Error when parsing the object");
+            ASSERT_VAL("server output", coldData == serverData);
         }
 
+        void gsccompileserverbench(acts::unit_test::BenchmarkContext& ctx) {
+            // latency of a request sent to a warm server, to compare with the cold run of gsccompilecold
+            static std::unique_ptr<TestCompileServer> server{};
+            if (!server) server = std::make_unique<TestCompileServer>();
 
-        RegisterOpCodesMap();
+            std::string out{ (std::filesystem::temp_directory_path() / "acts_server_bench").string() };
+            for (const std::filesystem::path& path : ctx.GetCorpusFiles("gsc-compiler", ".gsc\0.csc\0")) {
+                std::string pathStr{ path.string() };
+                std::error_code ec{};
+                size_t size{ (size_t)std::filesystem::file_size(path, ec) };
 
-        if (!obj.Compile(data)) {
-            throw std::runtime_error("Error when compiling the object");
+                ctx.Measure(size, [&]() -> bool {
+                    return server->Compile({ "-g", ctx.vm, "-p", ctx.platform, "-o", out.data(), pathStr.data() }) == tool::OK;
+                });
+            }
         }
+
+        void gsccompilecoldbench(acts::unit_test::BenchmarkContext& ctx) {
+            // latency of a new acts process per file, what a script or an editor is paying without a server
+            wchar_t exe[MAX_PATH];
+            GetModuleFileNameW(nullptr, exe, MAX_PATH);
+            std::wstring out{ (std::filesystem::temp_directory_path() / "acts_cold_bench").wstring() };
+            std::wstring vm{ utils::StrToWStr(ctx.vm) };
+            std::wstring plt{ utils::StrToWStr(ctx.platform) };
+
+            for (const std::filesystem::path& path : ctx.GetCorpusFiles("gsc-compiler", ".gsc\0.csc\0")) {
+                std::wstring cmd{ std::format(L"\"{}\" gscc -g {} -p {} -o \"{}\" \"{}\"", exe, vm, plt, out, path.wstring()) };
+                std::error_code ec{};
+                size_t size{ (size_t)std::filesystem::file_size(path, ec) };
+
+                ctx.Measure(size, [&]() -> bool {
+                    STARTUPINFOW si{};
+                    PROCESS_INFORMATION pi{};
+                    si.cb = sizeof(si);
+                    si.dwFlags = STARTF_USESTDHANDLES;
+
+                    if (!CreateProcessW(nullptr, cmd.data(), nullptr, nullptr, FALSE, CREATE_NO_WINDOW, nullptr, nullptr, &si, &pi)) {
+                        return false;
+                    }
+                    WaitForSingleObject(pi.hProcess, INFINITE);
+                    DWORD code{};
+                    GetExitCodeProcess(pi.hProcess, &code);
+                    CloseHandle(pi.hThread);
+                    CloseHandle(pi.hProcess);
+                    return code == 0;
+                });
+            }
+        }
+
+        ADD_BENCHMARK(gsccompile, gsccompilebench);
+        ADD_TEST(gscpreprocessor, gscpreprocessortest);
+        ADD_TEST(gscoptimizer, gscoptimizertest);
+        ADD_TEST(gsccompileserver, gsccompileservertest);
+        ADD_TEST(gscparallelcodegen, gscparallelcodegentest);
+        ADD_TEST(gscstripunused, gscstripunusedtest);
+        ADD_TEST(gsccompilecache, gsccompilecachetest);
+        ADD_BENCHMARK(gsccompileserver, gsccompileserverbench);
+        ADD_BENCHMARK(gsccompilecold, gsccompilecoldbench);
     }
 
     ADD_TOOL(gscc, "gsc", "", "GSC compiler", nullptr, compiler);
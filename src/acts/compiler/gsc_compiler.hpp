@@ -3,6 +3,10 @@
 #include "preprocessor.hpp"
 
 namespace acts::compiler {
+	namespace cache {
+		class CompilerCache;
+	}
+
 	enum DetourType {
 		DETOUR_UNKNOWN = 0,
 		DETOUR_GSIC,
@@ -19,11 +23,17 @@ namespace acts::compiler {
 		int32_t checksum{};
 		bool computeDevOption{};
 		bool obfuscate{};
+		bool optimize{};
+		bool stripUnused{};
 		bool defineAsConstExpr{};
 		bool noDevCallInline{};
+		// threads used to generate the functions, 0 = hardware concurrency, with 1 the functions are placed and written one by one
+		size_t threads{ 1 };
 		preprocessor::PreProcessorOption processorOpt{};
 		std::string* preprocOutput{};
 		std::unordered_set<std::string>* hashes{};
+		// optional build cache
+		cache::CompilerCache* cache{};
 
 		tool::gsc::opcode::VmInfo* GetVm() {
 			if (!nfo || nfo->vmMagic != vm) {
@@ -35,6 +45,19 @@ namespace acts::compiler {
 		tool::gsc::opcode::VmInfo* nfo{};
 	};
 
+	struct CompilerTarget {
+		CompilerConfig config{};
+		std::vector<byte> data{};
+	};
+
+	/*
+	 * Compile the same files for multiple targets (gsc/csc, vm, platform), the files are read once and
+	 * the targets with the same preprocessed sources are sharing the same parse tree
+	 * @param files files to compile
+	 * @param targets targets, the compiled data is set in each target
+	 * @param compiled called after each target is compiled, in the targets order, the next targets aren't compiled if it returns false
+	 */
+	void CompileGsc(const std::vector<std::filesystem::path>& files, std::vector<CompilerTarget>& targets, const std::function<bool(CompilerTarget& target)>& compiled = {});
 	void CompileGsc(const std::vector<std::filesystem::path>& files, std::vector<byte>& data, CompilerConfig& cfg);
 	inline void CompileGsc(const std::filesystem::path& file, std::vector<byte>& data, CompilerConfig& cfg) {
 		std::vector<std::filesystem::path> files{ 1 };
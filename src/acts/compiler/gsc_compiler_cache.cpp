@@ -0,0 +1,125 @@
+#include <includes.hpp>
+#include <utils/utils.hpp>
+#include "gsc_compiler.hpp"
+#include "gsc_compiler_cache.hpp"
+
+namespace acts::compiler::cache {
+	using utils::cache::CacheReader;
+	using utils::cache::WriteString;
+
+	namespace {
+		uint64_t HashString(uint64_t key, const std::string_view& str) {
+			key = hash::Hash64Value(key, (uint64_t)str.length());
+			return hash::Hash64Buffer(str.data(), str.length(), key);
+		}
+	}
+
+	std::filesystem::path CompilerCache::GetEntryPath(uint64_t key) const {
+		return dir / utils::va("%02llx", key >> 56) / utils::va("%016llx.gcc", key);
+	}
+
+	uint64_t CompilerCache::ComputeKey(const CompilerConfig& config, const preprocessor::StringContainer& container, const std::string& data) const {
+		uint64_t key{ hash::Hash64Value(baseKey, VERSION) };
+		key = hash::Hash64Value(key, (uint64_t)config.vm);
+		key = hash::Hash64Value(key, (uint64_t)config.platform);
+		key = hash::Hash64Value(key, (uint64_t)config.detourType);
+		key = hash::Hash64Value(key, config.checksum);
+		key = hash::Hash64Value(key, config.clientScript);
+		key = hash::Hash64Value(key, config.computeDevOption);
+		key = hash::Hash64Value(key, config.obfuscate);
+		key = hash::Hash64Value(key, config.optimize);
+		key = hash::Hash64Value(key, config.stripUnused);
+		key = hash::Hash64Value(key, config.defineAsConstExpr);
+		key = hash::Hash64Value(key, config.noDevCallInline);
+		key = hash::Hash64Value(key, config.processorOpt.devBlockAsComment);
+		key = hash::Hash64Value(key, config.processorOpt.noDefineExpr);
+		key = HashString(key, config.name ? config.name : "");
+		key = HashString(key, config.fileName ? config.fileName : "");
+		// the warnings are only stored if they are printed
+		key = hash::Hash64Value(key, core::logs::getlevel() <= core::logs::LVL_WARNING);
+
+		// the preprocessed sources already depend on the defines, but they can be used by the compiler
+		std::vector<std::string_view> defines{ config.processorOpt.defines.begin(), config.processorOpt.defines.end() };
+		std::sort(defines.begin(), defines.end());
+		key = hash::Hash64Value(key, (uint64_t)defines.size());
+		for (const std::string_view& def : defines) {
+			key = HashString(key, def);
+		}
+
+		// the file names and lines are used by the diagnostics and the debug objects
+		key = hash::Hash64Value(key, (uint64_t)container.blocks.size());
+		for (const preprocessor::StringData& block : container.blocks) {
+			key = HashString(key, block.filename.string());
+			key = hash::Hash64Value(key, (uint64_t)block.sizeLine);
+		}
+
+		return HashString(key, data);
+	}
+
+	bool CompilerCache::Load(uint64_t key, CompilerCacheEntry& entry) {
+		std::filesystem::path path{ GetEntryPath(key) };
+		std::string buffer{};
+
+		if (!std::filesystem::exists(path) || !utils::ReadFile(path, buffer)) {
+			stats.misses++;
+			return false;
+		}
+
+		try {
+			CacheReader reader{ buffer };
+
+			if (reader.Read<uint64_t>() != MAGIC || reader.Read<uint32_t>() != VERSION) {
+				throw std::runtime_error("bad magic");
+			}
+
+			uint64_t size{ reader.Read<uint64_t>() };
+			const byte* data{ reader.ReadBuffer((size_t)size) };
+			entry.data.assign(data, data + size);
+
+			uint64_t hashes{ reader.Read<uint64_t>() };
+			entry.hashes.clear();
+			for (size_t i = 0; i < hashes; i++) {
+				entry.hashes.emplace_back(reader.ReadString());
+			}
+
+			uint64_t diagnostics{ reader.Read<uint64_t>() };
+			entry.diagnostics.clear();
+			for (size_t i = 0; i < diagnostics; i++) {
+				entry.diagnostics.emplace_back(reader.ReadLog());
+			}
+		}
+		catch (std::runtime_error& e) {
+			LOG_WARNING("Invalid cache entry {}: {}", path.string(), e.what());
+			stats.errors++;
+			stats.misses++;
+			return false;
+		}
+
+		stats.hits++;
+		stats.bytesRead += buffer.size();
+		return true;
+	}
+
+	bool CompilerCache::Store(uint64_t key, const CompilerCacheEntry& entry) {
+		std::vector<byte> buffer{};
+
+		utils::WriteValue<uint64_t>(buffer, MAGIC);
+		utils::WriteValue<uint32_t>(buffer, VERSION);
+		utils::WriteValue<uint64_t>(buffer, (uint64_t)entry.data.size());
+		utils::WriteValue(buffer, (void*)entry.data.data(), entry.data.size());
+		utils::WriteValue<uint64_t>(buffer, (uint64_t)entry.hashes.size());
+		for (const std::string& str : entry.hashes) {
+			WriteString(buffer, str);
+		}
+		utils::WriteValue<uint64_t>(buffer, (uint64_t)entry.diagnostics.size());
+		for (const core::logs::bufferedlog& log : entry.diagnostics) {
+			utils::cache::WriteLog(buffer, log);
+		}
+
+		return utils::cache::WriteEntry(GetEntryPath(key), buffer, stats);
+	}
+
+	void CompilerCache::PrintStats() const {
+		stats.Print();
+	}
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <utils/cache_utils.hpp>
+#include "preprocessor.hpp"
+
+namespace acts::compiler {
+	struct CompilerConfig;
+}
+
+namespace acts::compiler::cache {
+	constexpr uint64_t MAGIC = 0x3130434343534341; // ACSCCC01
+	constexpr uint32_t VERSION = 2;
+
+	// Cached result of a compiled target
+	struct CompilerCacheEntry {
+		std::vector<byte> data{};
+		// hashes added by the compiler
+		std::vector<std::string> hashes{};
+		// warnings printed by the compiler
+		std::vector<core::logs::bufferedlog> diagnostics{};
+	};
+
+	// Incremental build cache of the compiled scripts, the key is computed from the preprocessed sources,
+	// the compiler config, the compiler build and the warnings level, an entry is stored in <dir>/<key[0:2]>/<key>.gcc
+	class CompilerCache {
+		std::filesystem::path dir;
+		uint64_t baseKey;
+		utils::cache::CacheStats stats{};
+
+		std::filesystem::path GetEntryPath(uint64_t key) const;
+	public:
+		/*
+		 * Create a cache
+		 * @param dir cache directory
+		 * @param baseKey key of the compiler build
+		 */
+		CompilerCache(const std::filesystem::path& dir, uint64_t baseKey) : dir(dir), baseKey(baseKey) {}
+
+		/*
+		 * Compute the key of a target
+		 * @param config target config, the preprocessor defines must be set
+		 * @param container input files, used for the file names and the line mapping
+		 * @param data preprocessed sources
+		 * @return key
+		 */
+		uint64_t ComputeKey(const CompilerConfig& config, const preprocessor::StringContainer& container, const std::string& data) const;
+
+		/*
+		 * Load a cache entry
+		 * @param key entry key
+		 * @param entry entry to fill
+		 * @return true if the entry was loaded
+		 */
+		bool Load(uint64_t key, CompilerCacheEntry& entry);
+
+		/*
+		 * Store a cache entry
+		 * @param key entry key
+		 * @param entry entry to store
+		 * @return true if the entry was stored
+		 */
+		bool Store(uint64_t key, const CompilerCacheEntry& entry);
+
+		/*
+		 * Print the cache stats
+		 */
+		void PrintStats() const;
+
+		size_t GetHits() const {
+			return stats.hits;
+		}
+	};
+}
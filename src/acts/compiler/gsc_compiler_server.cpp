@@ -0,0 +1,267 @@
+#include <includes.hpp>
+#include <utils/utils.hpp>
+#include <core/bytebuffer.hpp>
+#include <tools/gsc_opcodes.hpp>
+#include "gscLexer.h"
+#include "gscParser.h"
+#include "gsc_compiler_server.hpp"
+
+namespace acts::compiler::server {
+	namespace {
+		std::string GetPipePath(const char* pipeName) {
+			return std::format("\\\\.\\pipe\\{}", pipeName);
+		}
+
+		bool WritePipe(HANDLE pipe, const void* data, size_t size) {
+			const byte* ptr{ (const byte*)data };
+			while (size) {
+				DWORD written{};
+				if (!WriteFile(pipe, ptr, (DWORD)std::min<size_t>(size, 0x10000), &written, nullptr) || !written) {
+					return false;
+				}
+				ptr += written;
+				size -= written;
+			}
+			return true;
+		}
+
+		bool ReadPipe(HANDLE pipe, void* data, size_t size) {
+			byte* ptr{ (byte*)data };
+			while (size) {
+				DWORD read{};
+				if (!ReadFile(pipe, ptr, (DWORD)std::min<size_t>(size, 0x10000), &read, nullptr) || !read) {
+					return false;
+				}
+				ptr += read;
+				size -= read;
+			}
+			return true;
+		}
+
+		// a message is sent as [uint32 size][data]
+		bool WriteMessage(HANDLE pipe, const std::vector<byte>& data) {
+			uint32_t size{ (uint32_t)data.size() };
+			return WritePipe(pipe, &size, sizeof(size)) && WritePipe(pipe, data.data(), data.size());
+		}
+
+		bool ReadMessage(HANDLE pipe, std::vector<byte>& data) {
+			uint32_t size{};
+			if (!ReadPipe(pipe, &size, sizeof(size)) || size > MAX_MESSAGE_SIZE) {
+				return false;
+			}
+			data.resize(size);
+			return ReadPipe(pipe, data.data(), size);
+		}
+
+		void WriteString(std::vector<byte>& data, const std::string& str) {
+			utils::WriteString(data, str.data());
+		}
+
+		void WarmupServer() {
+			// everything a cold run is loading before compiling a file
+			hashutils::ReadDefaultFile();
+			tool::gsc::opcode::RegisterOpCodes();
+			tool::gsc::opcode::RegisterOpCodesMap();
+			gscLexer::initialize();
+			gscParser::initialize();
+		}
+
+		int HandleCompileRequest(Process& proc, ServerCompileFunc compileFunc, core::bytebuffer::ByteBuffer& reader, std::vector<core::logs::bufferedlog>& logs) {
+			core::logs::loglevel level{ (core::logs::loglevel)reader.Read<int32_t>() };
+			std::filesystem::path cwd{ reader.ReadString() };
+			uint32_t argc{ reader.Read<uint32_t>() };
+
+			std::vector<const char*> argv{};
+			argv.reserve(argc + 2);
+			argv.push_back("acts");
+			argv.push_back("gscc");
+			for (size_t i = 0; i < argc; i++) {
+				argv.push_back(reader.ReadString());
+			}
+
+			// the paths of the request are relative to the client
+			std::error_code ec{};
+			std::filesystem::path serverCwd{ std::filesystem::current_path() };
+			std::filesystem::current_path(cwd, ec);
+			if (ec) {
+				throw std::runtime_error(std::format("Can't use working directory {}: {}", cwd.string(), ec.message()));
+			}
+
+			core::logs::loglevel serverLevel{ core::logs::getlevel() };
+			core::logs::setlevel(level);
+			core::logs::setthreadbuffer(&logs);
+
+			int ret;
+			try {
+				ret = compileFunc(proc, (int)argv.size(), argv.data());
+			}
+			catch (std::exception& e) {
+				LOG_ERROR("Error when compiling: {}", e.what());
+				ret = tool::BASIC_ERROR;
+			}
+
+			core::logs::setthreadbuffer(nullptr);
+			core::logs::setlevel(serverLevel);
+			std::filesystem::current_path(serverCwd, ec);
+
+			return ret;
+		}
+	}
+
+	int RunServer(Process& proc, const char* pipeName, ServerCompileFunc compileFunc) {
+		std::string pipePath{ GetPipePath(pipeName) };
+
+		// one instance, the requests are handled one at a time because they're using the process working directory
+		HANDLE pipe{ CreateNamedPipeA(
+			pipePath.data(),
+			PIPE_ACCESS_DUPLEX | FILE_FLAG_FIRST_PIPE_INSTANCE,
+			PIPE_TYPE_BYTE | PIPE_READMODE_BYTE | PIPE_WAIT | PIPE_REJECT_REMOTE_CLIENTS,
+			1, 0x10000, 0x10000, 0, nullptr
+		) };
+
+		if (pipe == INVALID_HANDLE_VALUE) {
+			LOG_ERROR("Can't create pipe {}, is a server already running? (error 0x{:x})", pipePath, GetLastError());
+			return tool::BASIC_ERROR;
+		}
+
+		utils::CloseEnd pipeCE{ [pipe] { CloseHandle(pipe); } };
+
+		auto start{ std::chrono::steady_clock::now() };
+		WarmupServer();
+		LOG_INFO("Compile server started on {} in {}ms", pipePath, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count());
+
+		std::vector<byte> request{};
+		std::vector<byte> response{};
+		std::vector<core::logs::bufferedlog> logs{};
+		size_t requests{};
+		bool stop{};
+
+		while (!stop) {
+			if (!ConnectNamedPipe(pipe, nullptr) && GetLastError() != ERROR_PIPE_CONNECTED) {
+				LOG_ERROR("Can't accept client on {} (error 0x{:x})", pipePath, GetLastError());
+				return tool::BASIC_ERROR;
+			}
+
+			if (!ReadMessage(pipe, request)) {
+				LOG_WARNING("Can't read client request");
+				DisconnectNamedPipe(pipe);
+				continue;
+			}
+
+			logs.clear();
+			int ret{ tool::OK };
+			try {
+				core::bytebuffer::ByteBuffer reader{ request };
+
+				if (reader.Read<uint32_t>() != MAGIC || reader.Read<uint32_t>() != VERSION) {
+					throw std::runtime_error("Invalid request version, the client and the server should use the same acts version");
+				}
+
+				switch (reader.Read<uint32_t>()) {
+				case SRT_COMPILE: {
+					auto reqStart{ std::chrono::steady_clock::now() };
+					ret = HandleCompileRequest(proc, compileFunc, reader, logs);
+					requests++;
+					LOG_DEBUG("Request #{} handled in {}ms -> {}", requests, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - reqStart).count(), ret);
+					break;
+				}
+				case SRT_STOP:
+					stop = true;
+					break;
+				default:
+					throw std::runtime_error("Invalid request type");
+				}
+			}
+			catch (std::runtime_error& e) {
+				logs.push_back(core::logs::bufferedlog{ core::logs::LVL_ERROR, "", "", 0, std::format("Invalid request: {}", e.what()) });
+				ret = tool::BASIC_ERROR;
+			}
+
+			response.clear();
+			utils::WriteValue<uint32_t>(response, MAGIC);
+			utils::WriteValue<int32_t>(response, ret);
+			utils::WriteValue<uint32_t>(response, (uint32_t)logs.size());
+			for (const core::logs::bufferedlog& log : logs) {
+				utils::WriteValue<int32_t>(response, (int32_t)log.level);
+				WriteString(response, log.header);
+				WriteString(response, log.file);
+				utils::WriteValue<uint64_t>(response, (uint64_t)log.line);
+				WriteString(response, log.str);
+			}
+
+			if (!WriteMessage(pipe, response)) {
+				LOG_WARNING("Can't send response to client");
+			}
+			FlushFileBuffers(pipe);
+			DisconnectNamedPipe(pipe);
+		}
+
+		LOG_INFO("Compile server stopped after {} request(s)", requests);
+		return tool::OK;
+	}
+
+	bool SendRequest(const char* pipeName, ServerRequestType type, const std::vector<const char*>& args, int& ret) {
+		std::string pipePath{ GetPipePath(pipeName) };
+
+		HANDLE pipe;
+		while (true) {
+			pipe = CreateFileA(pipePath.data(), GENERIC_READ | GENERIC_WRITE, 0, nullptr, OPEN_EXISTING, 0, nullptr);
+
+			if (pipe != INVALID_HANDLE_VALUE) {
+				break;
+			}
+
+			// the server is handling another request
+			if (GetLastError() != ERROR_PIPE_BUSY || !WaitNamedPipeA(pipePath.data(), NMPWAIT_WAIT_FOREVER)) {
+				LOG_ERROR("Can't connect to compile server {} (error 0x{:x})", pipePath, GetLastError());
+				return false;
+			}
+		}
+
+		utils::CloseEnd pipeCE{ [pipe] { CloseHandle(pipe); } };
+
+		std::vector<byte> data{};
+		utils::WriteValue<uint32_t>(data, MAGIC);
+		utils::WriteValue<uint32_t>(data, VERSION);
+		utils::WriteValue<uint32_t>(data, type);
+		if (type == SRT_COMPILE) {
+			utils::WriteValue<int32_t>(data, (int32_t)core::logs::getlevel());
+			WriteString(data, std::filesystem::current_path().string());
+			utils::WriteValue<uint32_t>(data, (uint32_t)args.size());
+			for (const char* arg : args) {
+				utils::WriteString(data, arg);
+			}
+		}
+
+		if (!WriteMessage(pipe, data) || !ReadMessage(pipe, data)) {
+			LOG_ERROR("Can't send request to compile server {}", pipePath);
+			return false;
+		}
+
+		try {
+			core::bytebuffer::ByteBuffer reader{ data };
+
+			if (reader.Read<uint32_t>() != MAGIC) {
+				throw std::runtime_error("bad magic");
+			}
+
+			ret = reader.Read<int32_t>();
+			uint32_t count{ reader.Read<uint32_t>() };
+			for (size_t i = 0; i < count; i++) {
+				core::logs::loglevel level{ (core::logs::loglevel)reader.Read<int32_t>() };
+				const char* header{ reader.ReadString() };
+				const char* file{ reader.ReadString() };
+				size_t line{ (size_t)reader.Read<uint64_t>() };
+				const char* str{ reader.ReadString() };
+
+				core::logs::log(level, *header ? header : nullptr, *file ? file : nullptr, line, str);
+			}
+		}
+		catch (std::runtime_error& e) {
+			LOG_ERROR("Invalid response from compile server {}: {}", pipePath, e.what());
+			return false;
+		}
+
+		return true;
+	}
+}
@@ -0,0 +1,38 @@
+#pragma once
+
+namespace acts::compiler::server {
+	constexpr uint32_t MAGIC = 0x53435347; // GSCS
+	constexpr uint32_t VERSION = 1;
+	constexpr const char* DEFAULT_PIPE_NAME = "acts-gscc";
+	// max size of a message, a request is only containing the options and a response the logs
+	constexpr size_t MAX_MESSAGE_SIZE = 0x4000000;
+
+	enum ServerRequestType : uint32_t {
+		SRT_COMPILE = 0,
+		SRT_STOP,
+	};
+
+	// compiler entry point used by the server, same signature as the gscc tool
+	typedef int(*ServerCompileFunc)(Process& proc, int argc, const char* argv[]);
+
+	/*
+	 * Run a compile server, the server is loading the hash map, the opcodes and the parser tables once
+	 * and handles the requests until a stop request is received. The requests are handled one at a time
+	 * in the working directory of the client and the logs are sent back to the client.
+	 * @param proc process
+	 * @param pipeName local pipe name
+	 * @param compileFunc compiler entry point
+	 * @return tool error code
+	 */
+	int RunServer(Process& proc, const char* pipeName, ServerCompileFunc compileFunc);
+
+	/*
+	 * Send a request to a compile server and print its logs
+	 * @param pipeName local pipe name
+	 * @param type request type
+	 * @param args compiler options (without the tool name), ignored for a stop request
+	 * @param ret compiler return code
+	 * @return false if the server can't be reached
+	 */
+	bool SendRequest(const char* pipeName, ServerRequestType type, const std::vector<const char*>& args, int& ret);
+}
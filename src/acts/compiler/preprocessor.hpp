@@ -32,9 +32,12 @@ namespace acts::compiler::preprocessor {
         }
 
         const StringData& FindFile(size_t line) const {
-            for (const StringData& f : blocks) {
-                if (line >= f.startLine && line < f.startLine + f.sizeLine) {
-                    return f;
+            // the blocks are appended in order, search the last block starting before the line
+            auto it{ std::upper_bound(blocks.begin(), blocks.end(), line, [](size_t line, const StringData& f) { return line < f.startLine; }) };
+            if (it != blocks.begin()) {
+                --it;
+                if (line < it->startLine + it->sizeLine) {
+                    return *it;
                 }
             }
             return blocks[blocks.size() - 1];
@@ -82,7 +85,9 @@ namespace acts::compiler::preprocessor {
 
             dt.sizeLine = lineCount;
             currentLines = startLine + lineCount;
-            data = data + buff + "\n";
+            data.reserve(data.size() + buff.size() + 1);
+            data.append(buff);
+            data.push_back('\n');
             return true;
         }
     };
@@ -100,7 +105,7 @@ namespace acts::compiler::preprocessor {
             return d - s;
         }
 
-        static bool TrimDefineVal(std::string& val) {
+        static bool TrimDefineVal(std::string_view& val) {
             if (val.empty()) {
                 return false;
             }
@@ -128,6 +133,10 @@ namespace acts::compiler::preprocessor {
             return false;
         }
 
+        static inline uint64_t HashDefine(const std::string_view& define) {
+            return hash::Hash64Buffer(define.data(), define.length());
+        }
+
         static bool HasOnlySpaceAfter(const std::string_view& val, size_t idx) {
             for (size_t i = idx; i < val.length(); i++) {
                 if (!isspace(val[i])) {
@@ -218,62 +227,76 @@ namespace acts::compiler::preprocessor {
             if (!ApplyPreProcessorComments(str, errorHandler)) {
                 return false;
             }
+            char* data{ str.data() };
+            size_t len{ str.length() };
             size_t lineStart{};
             size_t lineIdx{};
             bool err{};
 
-            std::stack<bool> eraseCtx{};
+            // sorted hashes of the defines
+            std::vector<uint64_t> defineHashes{};
+            defineHashes.reserve(defines.size() + 16);
+            for (const std::string& def : defines) {
+                defineHashes.push_back(HashDefine(def));
+            }
+            std::sort(defineHashes.begin(), defineHashes.end());
+
+            auto isDefined = [&defineHashes](const std::string_view& define) -> bool {
+                return std::binary_search(defineHashes.begin(), defineHashes.end(), HashDefine(define));
+            };
 
-            while (lineStart < str.length()) {
-                lineIdx++;
-                size_t next = str.find("\n", lineStart);
+            // erase state of each #if block, true = erase
+            std::vector<bool> eraseCtx{};
 
-                if (next == std::string::npos) {
-                    next = str.length(); // last line
+            // read the parameter of a directive, it should be separated by a space and be a single word
+            auto readParam = [&errorHandler, &err, &lineIdx](const std::string_view& line, size_t directiveLen, const char* directive, std::string_view& param) -> bool {
+                param = line.substr(directiveLen);
+                if (param.empty() || !isspace(param[0])) {
+                    errorHandler(core::logs::LVL_ERROR, lineIdx, std::format("{} should be used with a parameter", directive));
+                    err = true;
+                    return false;
                 }
+                if (!TrimDefineVal(param)) {
+                    errorHandler(core::logs::LVL_ERROR, lineIdx, std::format("{} should be used with one valid parameter", directive));
+                    err = true;
+                    return false;
+                }
+                return true;
+            };
+
+            while (lineStart < len) {
+                lineIdx++;
+                const char* nl{ (const char*)std::memchr(data + lineStart, '\n', len - lineStart) };
+                size_t next{ nl ? (size_t)(nl - data) : len }; // or last line
 
                 // skip until the start
-                while (lineStart < next && isspace(str[lineStart])) {
+                while (lineStart < next && isspace(data[lineStart])) {
                     lineStart++;
                 }
 
-                std::string_view line{ str.data() + lineStart, str.data() + next };
-                if (line.starts_with("#ifdef")) {
-                    std::string define{ line.substr(6) };
-                    if (define.length() < 1 || !isspace(define[0])) {
-                        errorHandler(core::logs::LVL_ERROR, lineIdx, "#ifdef should be used with a parameter");
-                        err = true;
-                    }
-                    else if (!TrimDefineVal(define)) {
-                        errorHandler(core::logs::LVL_ERROR, lineIdx, "#ifdef should be used with one valid parameter");
-                        err = true;
-                    }
-                    else {
-                        bool forceDel = eraseCtx.size() && eraseCtx.top();
+                bool erased{ !eraseCtx.empty() && eraseCtx.back() };
 
-                        if (!forceDel) {
-                            forceDel = !defines.contains(define);
+                if (lineStart == next || data[lineStart] != '#') {
+                    // not a directive
+                    if (erased) {
+                        for (size_t i = lineStart; i < next; i++) {
+                            SetBlankChar(data[i]);
                         }
-                        eraseCtx.push(forceDel);
                     }
+                    lineStart = next + 1;
+                    continue;
                 }
-                else if (line.starts_with("#ifndef")) {
-                    std::string define{ line.substr(7) };
-                    if (define.length() < 1 || !isspace(define[0])) {
-                        errorHandler(core::logs::LVL_ERROR, lineIdx, "#ifndef should be used with a parameter");
-                        err = true;
-                    }
-                    else if (!TrimDefineVal(define)) {
-                        errorHandler(core::logs::LVL_ERROR, lineIdx, "#ifndef should be used with one valid parameter");
-                        err = true;
-                    }
-                    else {
-                        bool del = eraseCtx.size() && eraseCtx.top();
 
-                        if (!del) {
-                            del = defines.contains(define);
-                        }
-                        eraseCtx.push(del);
+                std::string_view line{ data + lineStart, data + next };
+                std::string_view param{};
+                if (line.starts_with("#ifdef")) {
+                    if (readParam(line, 6, "#ifdef", param)) {
+                        eraseCtx.push_back(erased || !isDefined(param));
+                    }
+                }
+                else if (line.starts_with("#ifndef")) {
+                    if (readParam(line, 7, "#ifndef", param)) {
+                        eraseCtx.push_back(erased || isDefined(param));
                     }
                 }
                 else if (line.starts_with("#else")) {
@@ -286,21 +309,11 @@ namespace acts::compiler::preprocessor {
                         err = true;
                     }
                     else {
-                        bool curr = eraseCtx.top();
-                        eraseCtx.pop();
+                        bool curr{ eraseCtx.back() };
+                        eraseCtx.pop_back();
 
-                        if (!eraseCtx.empty()) {
-                            // at least 2, we need to check the parent ctx
-                            if (!eraseCtx.top()) {
-                                eraseCtx.push(false);
-                            }
-                            else {
-                                eraseCtx.push(!curr);
-                            }
-                        }
-                        else {
-                            eraseCtx.push(!curr);
-                        }
+                        // we need to check the parent ctx
+                        eraseCtx.push_back((!eraseCtx.empty() && eraseCtx.back()) || !curr);
                     }
                 }
                 else if (line.starts_with("#endif")) {
@@ -313,21 +326,16 @@ namespace acts::compiler::preprocessor {
                         err = true;
                     }
                     else {
-                        eraseCtx.pop();
+                        eraseCtx.pop_back();
                     }
                 }
                 else if (!noDefineExpr && line.starts_with("#define")) {
-                    std::string define{ line.substr(7) };
-                    if (define.length() < 1 || !isspace(define[0])) {
-                        errorHandler(core::logs::LVL_ERROR, lineIdx, "#define should be used with a parameter");
-                        err = true;
-                    }
-                    else if (!TrimDefineVal(define)) {
-                        errorHandler(core::logs::LVL_ERROR, lineIdx, "#define should be used with one valid parameter");
-                        err = true;
-                    }
-                    else {
-                        defines.insert(define);
+                    if (readParam(line, 7, "#define", param)) {
+                        uint64_t hash{ HashDefine(param) };
+                        auto it{ std::lower_bound(defineHashes.begin(), defineHashes.end(), hash) };
+                        if (it == defineHashes.end() || *it != hash) {
+                            defineHashes.insert(it, hash);
+                        }
                     }
                 }
                 else if (line.starts_with("#error")) {
@@ -338,15 +346,15 @@ namespace acts::compiler::preprocessor {
                     errorHandler(core::logs::LVL_WARNING, lineIdx, std::string{ line.substr(line.length() > 8 ? 9 : 8) });
                 }
                 else if (!line.starts_with("#region") && !line.starts_with("#endregion")) {
-                    if (eraseCtx.empty() || !eraseCtx.top()) {
+                    // not a preprocessor directive
+                    if (!erased) {
                         lineStart = next + 1;
                         continue;
                     }
                 }
 
-
                 for (size_t i = lineStart; i < next; i++) {
-                    SetBlankChar(str[i]);
+                    SetBlankChar(data[i]);
                 }
 
                 lineStart = next + 1;
@@ -1,8 +1,11 @@
 #include <includes.hpp>
 #include <utils/utils.hpp>
 #include <core/async.hpp>
+#include <atomic>
+#include <shared_mutex>
 #include <rapidcsv.h>
 #include "actscli.hpp"
+#include <unit_test.hpp>
 #include "compatibility/scobalula_wni.hpp"
 
 namespace {
@@ -14,11 +17,21 @@ namespace {
 	bool show0 = false;
 	bool markHash = false;
 	bool heavyHashes = false;
-	std::mutex asyncMutex{};
+	std::shared_mutex asyncMutex{};
+	std::mutex extractedMutex{};
+	std::atomic<bool> defaultFileLoaded{};
+	// order independent fingerprint of the map, only maintained after the first GetFingerprint call
+	bool fingerprintComputed{};
+	uint64_t fingerprint{};
+	thread_local hashutils::HashRecord* hashRecord{};
+
+	inline uint64_t FingerprintEntry(uint64_t hash, const std::string& str) {
+		return hash::Hash64Buffer(str.data(), str.length(), hash::Hash64Value(hash::FNV1A_PRIME, hash));
+	}
 }
 
 namespace hashutils {
-	std::mutex* GetMutex(bool forceAsync) {
+	std::shared_mutex* GetMutex(bool forceAsync) {
 		if (forceAsync || !core::async::IsSync(core::async::AT_HASHES)) {
 			return nullptr;
 		}
@@ -114,16 +127,20 @@ namespace hashutils {
 	}
 
 	void ReadDefaultFile(bool cleanup) {
-		static bool loaded{};
+		// fast path, this function is called before each extraction
+		if (!cleanup && defaultFileLoaded.load(std::memory_order_acquire)) {
+			return;
+		}
 		std::lock_guard lg{ asyncMutex };
 
 		if (cleanup) {
 			g_hashMap.clear();
-			loaded = false;
+			fingerprintComputed = false;
+			defaultFileLoaded.store(false, std::memory_order_release);
 		}
-		if (!loaded) {
+		if (!defaultFileLoaded.load(std::memory_order_relaxed)) {
 			ReadDefaultFile0();
-			loaded = true;
+			defaultFileLoaded.store(true, std::memory_order_release);
 		}
 	}
 
@@ -330,13 +347,68 @@ namespace hashutils {
 		return true;
 	}
 	void AddPrecomputed(uint64_t value, const char* str, bool async) {
+		if (hashRecord) {
+			// keep the hash in the thread record, the map isn't updated
+			core::async::opt_shared_lock_guard lg{ GetMutex(async) };
+			uint64_t key{ value & hashutils::MASK63 };
+			if (!g_hashMap.contains(key)) {
+				hashRecord->learned.emplace(key, str);
+			}
+			return;
+		}
 		core::async::opt_lock_guard lg{ GetMutex(async) };
-		g_hashMap.emplace(value & hashutils::MASK63, str);
+		auto [it, inserted] = g_hashMap.emplace(value & hashutils::MASK63, str);
+		if (!inserted) {
+			return;
+		}
+		if (fingerprintComputed) {
+			fingerprint ^= FingerprintEntry(it->first, it->second);
+		}
 	}
 
-	bool Extract(const char* type, uint64_t hash, char* out, size_t outSize) {
+	uint64_t GetFingerprint() {
 		ReadDefaultFile();
 		core::async::opt_lock_guard lg{ GetMutex(false) };
+		if (!fingerprintComputed) {
+			fingerprint = 0;
+			for (const auto& [hash, str] : g_hashMap) {
+				fingerprint ^= FingerprintEntry(hash, str);
+			}
+			fingerprintComputed = true;
+		}
+		return fingerprint;
+	}
+
+	void RecordHashes(HashRecord* record) {
+		if (record) {
+			// the default hashes should be in the map, not in the record
+			ReadDefaultFile();
+		}
+		hashRecord = record;
+	}
+
+	// find a hash in the map or in the hashes learned by the current thread, the map should be locked
+	static const std::string* FindHash(uint64_t hash) {
+		const auto res = g_hashMap.find(hash & hashutils::MASK63);
+		if (res != g_hashMap.end()) {
+			if (hashRecord && hashRecord->recordResolved) {
+				hashRecord->resolved.emplace(res->first, res->second);
+			}
+			return &res->second;
+		}
+		if (hashRecord) {
+			const auto lres = hashRecord->learned.find(hash & hashutils::MASK63);
+			if (lres != hashRecord->learned.end()) {
+				return &lres->second;
+			}
+		}
+		return nullptr;
+	}
+
+	bool Extract(const char* type, uint64_t hash, char* out, size_t outSize) {
+		ReadDefaultFile();
+		// extractions are only reading the map, they can run at the same time
+		core::async::opt_shared_lock_guard lg{ GetMutex(false) };
 		if (hashPrefix) type = hashPrefix;
 		if (!hash) {
 			if (show0 || markHash) {
@@ -347,21 +419,22 @@ namespace hashutils {
 			}
 			return true;
 		}
-		const auto res = g_hashMap.find(hash & hashutils::MASK63);
+		const std::string* res{ FindHash(hash) };
 		if (g_saveExtracted) {
-			if (g_saveExtractedUnk || res != g_hashMap.end()) {
+			if (g_saveExtractedUnk || res) {
+				core::async::opt_lock_guard elg{ GetMutex(false) ? &extractedMutex : nullptr };
 				g_extracted.emplace(hash);
 			}
 		}
-		if (res == g_hashMap.end()) {
+		if (!res) {
 			snprintf(out, outSize, heavyHashes ? "%s_%016llX" : "%s_%llx", type, hash);
 			return false;
 		}
 		if (markHash) {
-			snprintf(out, outSize, heavyHashes ? "<%016llX>%s" : "<%llx>%s", hash, res->second.c_str());
+			snprintf(out, outSize, heavyHashes ? "<%016llX>%s" : "<%llx>%s", hash, res->c_str());
 		}
 		else {
-			snprintf(out, outSize, "%s", res->second.c_str());
+			snprintf(out, outSize, "%s", res->c_str());
 		}
 		return true;
 	}
@@ -382,11 +455,12 @@ namespace hashutils {
 
 	const char* ExtractPtr(uint64_t hash) {
 		ReadDefaultFile();
-		const auto res = g_hashMap.find(hash & hashutils::MASK63);
-		if (res == g_hashMap.end()) {
+		core::async::opt_shared_lock_guard lg{ GetMutex(false) };
+		const std::string* res{ FindHash(hash) };
+		if (!res) {
 			return NULL;
 		}
-		return res->second.data();
+		return res->data();
 	}
 
 	size_t Size() {
@@ -394,4 +468,82 @@ namespace hashutils {
 		return g_hashMap.size() >> 1; // 2 hashes/string
 	}
 
+	namespace {
+		void hashloadbench(acts::unit_test::BenchmarkContext& ctx) {
+			const char* file{ actscli::options().defaultHashFile ? actscli::options().defaultHashFile : DEFAULT_HASH_FILE };
+			std::error_code ec{};
+			size_t size{ (size_t)std::filesystem::file_size(file, ec) };
+
+			ctx.Measure(size, [] {
+				ReadDefaultFile(true);
+				return !g_hashMap.empty();
+			});
+		}
+
+		void hashlookupbench(acts::unit_test::BenchmarkContext& ctx) {
+			constexpr size_t batchSize = 10000;
+			ReadDefaultFile();
+
+			// same strings in every round, the map iteration order is stable while the map isn't updated
+			std::vector<std::string> strings{};
+			for (const auto& [hash, str] : g_hashMap) {
+				if (strings.size() == batchSize * 10) {
+					break;
+				}
+				strings.emplace_back(str);
+			}
+
+			for (size_t i = 0; i < strings.size(); i += batchSize) {
+				size_t end{ std::min(i + batchSize, strings.size()) };
+				size_t bytes{};
+				for (size_t j = i; j < end; j++) {
+					bytes += strings[j].length();
+				}
+
+				ctx.Measure(bytes, [&strings, i, end] {
+					size_t found{};
+					for (size_t j = i; j < end; j++) {
+						const std::string& str{ strings[j] };
+						found += ExtractPtr(hash::Hash64(str.data())) != nullptr;
+						found += ExtractPtr(hash::HashT89Scr(str.data())) != nullptr;
+					}
+					return found != 0;
+				});
+			}
+		}
+
+		void hashrecordtest() {
+			constexpr uint64_t mapHash{ 0x41435453ABCDEF01ull };
+			constexpr uint64_t learnedHash{ 0x41435453ABCDEF02ull };
+			constexpr const char* str{ "acts_hash_record_test" };
+
+			ReadDefaultFile();
+			AddPrecomputed(mapHash, str);
+			ASSERT_VAL("hash in the map", !ExtractPtr(learnedHash));
+
+			HashRecord record{};
+			record.recordResolved = true;
+			RecordHashes(&record);
+			AddPrecomputed(learnedHash, str);
+			const char* recorded{ ExtractPtr(learnedHash) };
+			ExtractPtr(mapHash);
+			RecordHashes(nullptr);
+
+			ASSERT_VAL("recorded hash", recorded && !std::strcmp(recorded, str));
+			ASSERT_VAL("map updated", !ExtractPtr(learnedHash));
+			ASSERT_EQ("learned", 1, record.learned.size());
+			ASSERT_VAL("resolved", record.resolved.contains(mapHash) && !record.resolved.contains(learnedHash));
+
+			// the learned hashes are added by the caller
+			for (auto& [h, v] : record.learned) {
+				AddPrecomputed(h, v.data());
+			}
+			const char* added{ ExtractPtr(learnedHash) };
+			ASSERT_VAL("added hash", added && !std::strcmp(added, str));
+		}
+
+		ADD_BENCHMARK(hashload, hashloadbench);
+		ADD_BENCHMARK(hashlookup, hashlookupbench);
+		ADD_TEST(hashrecord, hashrecordtest);
+	}
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include <Windows.h>
+#include <shared_mutex>
 #include <utils/hash.hpp>
 
 namespace hashutils {
@@ -8,11 +9,11 @@ namespace hashutils {
 	constexpr auto DEFAULT_HASH_FILE = "strings.txt";
 
 	/*
-	 * Get hash mutex
+	 * Get hash mutex, the extractions are only using a shared lock
 	 * @param async run async
 	 * @return mutex or nullptr
 	 */
-	std::mutex* GetMutex(bool async);
+	std::shared_mutex* GetMutex(bool async);
 
 	/*
 	 * Get hash map
@@ -58,6 +59,26 @@ namespace hashutils {
 	 * @param async run async
 	 */
 	void AddPrecomputed(uint64_t value, const char* str, bool async = false);
+	/*
+	 * Get a fingerprint of the hash map, two maps with the same entries have the same fingerprint
+	 * @return fingerprint
+	 */
+	uint64_t GetFingerprint();
+	// Hashes used by a thread
+	struct HashRecord {
+		// hashes added by the thread, they aren't added to the map and are only extracted by this thread
+		std::unordered_map<uint64_t, std::string> learned{};
+		// record the names extracted from the map
+		bool recordResolved{};
+		// names extracted from the map
+		std::unordered_map<uint64_t, std::string> resolved{};
+	};
+	/*
+	 * Record the hashes added or extracted by the current thread, the learned hashes should be added to the map
+	 * by the caller after the recording
+	 * @param record record or nullptr to stop the recording
+	 */
+	void RecordHashes(HashRecord* record);
 	/*
 	 * Extract a hash into a buffer
 	 * @param type Hash type
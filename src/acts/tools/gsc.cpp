@@ -8,8 +8,12 @@
 #include "tools/cw/cw.hpp"
 #include "tools/gsc_acts_debug.hpp"
 #include "tools/gsc_gdb.hpp"
+#include "tools/gsc_decompiler_cache.hpp"
 #include "tools/gsc_iw.hpp"
 #include "actscli.hpp"
+#include "compiler/gsc_compiler.hpp"
+#include <unit_test.hpp>
+#include <acts_vm.hpp>
 
 using namespace tool::gsc;
 using namespace tool::gsc::opcode;
@@ -26,14 +30,124 @@ GscInfoOption::GscInfoOption() {
 }
 
 bool tool::gsc::GscDecompilerGlobalContext::WarningType(GscDecompilerGlobalContextWarn warn) {
-    core::async::opt_lock_guard lg{ asyncMtx };
-    if ((warningOpt & warn)) return false;
-    warningOpt |= warn;
-    return true;
+    return !(warningOpt.fetch_or(warn) & warn);
+}
+
+const char* tool::gsc::GetDecompilerPhaseName(GscDecompilerPhase phase) {
+    static const char* names[]{
+        "read",
+        "PreLoadCode",
+        "PatchCode",
+        "disasm",
+        "ComputeDefaultParamValue",
+        "ComputePreSpecialPattern",
+        "ComputeDevBlocks",
+        "ComputeSwitchBlocks",
+        "ComputeForEachBlocks",
+        "ComputeWhileBlocks",
+        "ComputeForBlocks",
+        "ComputeIfBlocks",
+        "ComputeReturnJump",
+        "ComputeBoolReturn",
+        "ComputeSpecialPattern",
+        "dump",
+    };
+    static_assert(ARRAYSIZE(names) == GDP_COUNT, "missing phase name");
+
+    if (phase >= GDP_COUNT) {
+        return "unknown";
+    }
+    return names[phase];
+}
+
+void tool::gsc::GscDecompilerGlobalContext::MergeResult(GscDecompilerFileResult& res) {
+    hardErrors += res.hardErrors;
+
+    if (profile) {
+        for (size_t i = 0; i < GDP_COUNT; i++) {
+            uint64_t time{ res.phaseTimes[i] };
+            if (!time) {
+                continue;
+            }
+            GscDecompilerPhaseStats& stats{ phaseStats[i] };
+            stats.totalTime += time;
+            stats.files++;
+
+            if (!opt.m_profileTop) {
+                continue;
+            }
+            if (stats.slowest.size() == opt.m_profileTop) {
+                if (stats.slowest.front().first >= time) {
+                    continue; // faster than the slowest files
+                }
+                std::pop_heap(stats.slowest.begin(), stats.slowest.end(), std::greater<>{});
+                stats.slowest.pop_back();
+            }
+            stats.slowest.emplace_back(time, res.path);
+            std::push_heap(stats.slowest.begin(), stats.slowest.end(), std::greater<>{});
+        }
+    }
+
+    for (std::string& str : res.dumpStrings) {
+        dumpStrings.insert(std::move(str));
+    }
+
+    learnedHashes.insert(learnedHashes.end(), std::make_move_iterator(res.learnedHashes.begin()), std::make_move_iterator(res.learnedHashes.end()));
+
+    if (res.rosetta) {
+        auto& block = rosettaBlocks[res.scriptName];
+        block.header = std::move(res.rosettaData.header);
+        block.blocks.insert(block.blocks.end(), res.rosettaData.blocks.begin(), res.rosettaData.blocks.end());
+    }
+
+    if (!res.decompiled) {
+        return;
+    }
+
+    decompiledFiles++;
+
+    if (opt.vtable_dump && res.vtables.size()) {
+        auto& scriptVTables = vtables[res.scriptName];
+        for (auto& [cls, methods] : res.vtables) {
+            scriptVTables[cls].insert(methods.begin(), methods.end());
+        }
+    }
+}
+
+void tool::gsc::GscDecompilerGlobalContext::WriteProfile() {
+    long long end{ actslib::profiler::GetTimestamp() };
+    actslib::profiler::Profiler& profiler{ actscli::GetProfiler() };
+
+    // the phase times are cumulated over the threads, they are written as sections starting with the run
+    actslib::profiler::ProfilerSection& phasesSection{ profiler.AddSection("decompiler phases", profileStart, end) };
+
+    LOG_INFO("Decompiler phases ({} file(s), {}ms):", decompiledFiles, end - profileStart);
+    for (size_t i = 0; i < GDP_COUNT; i++) {
+        GscDecompilerPhaseStats& stats{ phaseStats[i] };
+        const char* name{ GetDecompilerPhaseName((GscDecompilerPhase)i) };
+
+        actslib::profiler::ProfilerSection& phaseSection{
+            phasesSection.AddSection(name, profileStart, profileStart + (long long)(stats.totalTime / 1000000))
+        };
+
+        if (!stats.files) {
+            continue;
+        }
+
+        LOG_INFO("{:<25} total={:.3f}ms files={} avg={:.3f}ms", name, stats.totalTime / 1000000.0, stats.files, stats.totalTime / 1000000.0 / stats.files);
+
+        std::sort_heap(stats.slowest.begin(), stats.slowest.end(), std::greater<>{});
+        for (auto& [time, path] : stats.slowest) {
+            std::string pathStr{ path.string() };
+            phaseSection.AddSection(pathStr, profileStart, profileStart + (long long)(time / 1000000));
+            LOG_INFO("  {:.3f}ms {}", time / 1000000.0, pathStr);
+        }
+    }
 }
 
 bool GscInfoOption::Compute(const char** args, INT startIndex, INT endIndex) {
     // default values
+    bool syncSet{};
     for (size_t i = startIndex; i < endIndex; i++) {
         const char* arg = args[i];
 
@@ -112,6 +226,7 @@ bool GscInfoOption::Compute(const char** args, INT startIndex, INT endIndex) {
                 return false;
             }
             const char* mode{ args[++i] };
+            syncSet = true;
             if (!_strcmpi("sync", mode)) {
                 m_sync = true;
             } else if (!_strcmpi("async", mode)) {
@@ -122,6 +237,23 @@ bool GscInfoOption::Compute(const char** args, INT startIndex, INT endIndex) {
                 return false;
             }
         }
+        else if (!strcmp("-j", arg) || !_strcmpi("--threads", arg)) {
+            if (i + 1 == endIndex) {
+                LOG_ERROR("Missing value for param: {}!", arg);
+                return false;
+            }
+            try {
+                m_threads = (size_t)utils::ParseFormatInt(args[++i]);
+            }
+            catch (std::runtime_error& e) {
+                LOG_ERROR("Bad value for param {}: {}", arg, e.what());
+                return false;
+            }
+            if (!syncSet) {
+                // an explicit sync mode is kept
+                m_sync = m_threads == 1;
+            }
+        }
         else if (!_strcmpi("--vm-split", arg)) {
             m_splitByVm = true;
         }
@@ -303,6 +435,26 @@ bool GscInfoOption::Compute(const char** args, INT startIndex, INT endIndex) {
             }
             m_rosetta = args[++i];
         }
+        else if (!_strcmpi("--profile", arg)) {
+            if (i + 1 == endIndex) {
+                LOG_ERROR("Missing value for param: {}!", arg);
+                return false;
+            }
+            try {
+                m_profileTop = (size_t)utils::ParseFormatInt(args[++i]);
+            }
+            catch (std::runtime_error& e) {
+                LOG_ERROR("Bad value for param {}: {}", arg, e.what());
+                return false;
+            }
+        }
+        else if (!_strcmpi("--cache", arg)) {
+            if (i + 1 == endIndex) {
+                LOG_ERROR("Missing value for param: {}!", arg);
+                return false;
+            }
+            m_cacheDir = args[++i];
+        }
 
         else if (*arg == '-') {
             LOG_ERROR("Unknown option: {}!", arg);
@@ -354,6 +506,7 @@ void GscInfoOption::PrintHelp() {
     LOG_INFO("--vtable-dump [f]  : Dump vtable information into f");
     LOG_INFO("--path-output      : Use the path for the output name");
     LOG_INFO("-s --skip-data     : Dump skip data (gscbin VMs only), requires --path-output");
+    LOG_INFO("--cache [d]        : Use d to cache the decompiled files");
     // it's not that I don't want them to be known, it's just to avoid having too many of them in the help
     // it's mostly dev tools
     LOG_DEBUG("-G --gvars         : Write gvars");
@@ -380,7 +533,12 @@ void GscInfoOption::PrintHelp() {
     LOG_DEBUG("--no-usings-sort   : No usings sort");
     LOG_DEBUG("--no-str-decrypt   : No string decrypt");
     LOG_DEBUG("--ignore-dbg-plt   : ignore debug platform info");
-    LOG_DEBUG("-A --sync [mode]   : Sync mode: async or sync");
+    LOG_DEBUG("-A --sync [mode]   : Sync mode: async or sync, default to sync or to async with -j n > 1");
+    LOG_DEBUG("                     sync: a file can use the names learned by the previous files");
+    LOG_DEBUG("                     async: the names learned by a file are only used after all the files,");
+    LOG_DEBUG("                     the output doesn't depend on the order or the number of threads");
+    LOG_DEBUG("-j --threads [n]   : Number of threads for the async mode, default to the cpu count");
+    LOG_DEBUG("--profile [n]      : Profile the decompiler phases and log the n slowest files of each phase");
     LOG_DEBUG("--vtable           : Do not hide and decompile vtable functions");
     LOG_DEBUG("--debug-hashes     : Debug hash alogrithm");
     LOG_DEBUG("-i --ignore[t + ]  : ignore step : ");
@@ -388,30 +546,66 @@ void GscInfoOption::PrintHelp() {
     LOG_DEBUG("                     R : bool return, c: class members, D: devblocks inline, S : special patterns");
 }
 
+uint64_t GscInfoOption::ComputeOutputKey() const {
+    auto hashStr = [](uint64_t key, const char* str) -> uint64_t {
+        if (!str) {
+            return hash::Hash64Value(key, (byte)0);
+        }
+        return hash::Hash64Buffer(str, strlen(str) + 1, key);
+    };
+
+    // the inputs, the cache and the threads options aren't changing the output
+    uint64_t key{ hashStr(hash::FNV1A_PRIME, core::actsinfo::VERSION) };
+    key = hash::Hash64Value(key, core::actsinfo::VERSION_ID);
+    for (bool flag : {
+        m_dcomp, m_dasm, m_header, m_imports, m_strings, m_gvars, m_includes, m_exptests, m_patch, m_func,
+        m_func_rloc, m_func_floc, m_func_header, m_func_header_post, m_show_jump_delta, m_show_pre_dump,
+        m_show_ref_count, m_test_header, m_show_internal_blocks, m_show_func_vars, m_mark_jump_type,
+        m_display_stack, m_use_internal_names, m_generateGdbData, m_generateGdbBaseData, m_splitByVm,
+        m_rawhash, m_noPath, m_ignoreDebugPlatform, m_vtable, m_debugHashes, m_usePathOutput, m_dumpSkipData,
+        m_noUsingsSort, m_noStrDecrypt
+        }) {
+        key = hash::Hash64Value(key, flag);
+    }
+    key = hashStr(key, m_outputDir);
+    key = hashStr(key, m_dbgOutputDir);
+    key = hashStr(key, m_copyright);
+    key = hash::Hash64Value(key, m_stepskip);
+    key = hash::Hash64Value(key, m_platform);
+    key = hash::Hash64Value(key, m_vm);
+    key = hashStr(key, m_formatter ? m_formatter->name : nullptr);
+
+    // global options used by the hash extraction
+    const actscli::ActsOptions& copt{ actscli::options() };
+    key = hash::Hash64Value(key, copt.heavyHashes);
+    key = hash::Hash64Value(key, copt.markHash);
+    key = hash::Hash64Value(key, copt.show0Hash);
+    key = hashStr(key, copt.hashPrefixByPass);
+    key = hashStr(key, copt.decryptStringExec);
+    return key;
+}
+
 static const char* gDumpStrings{};
-static std::unordered_set<std::string> gDumpStringsStore{};
 static const char* gRosettaOutput{};
-static uint64_t gRosettaCurrent{};
-static std::map<uint64_t, RosettaFileData> gRosettaBlocks{};
 
-void tool::gsc::RosettaStartFile(GSCOBJHandler& reader) {
-    if (!gRosettaOutput) {
+void tool::gsc::RosettaStartFile(T8GSCOBJContext& ctx, GSCOBJHandler& reader) {
+    if (!gRosettaOutput || !ctx.m_result) {
         return;
     }
 
-    
-    auto& block = gRosettaBlocks[gRosettaCurrent = reader.GetName()];
+    ctx.m_result->rosetta = true;
+    auto& block = ctx.m_result->rosettaData;
     // clone the header for the finder
     block.header.resize(reader.GetHeaderSize());
     memcpy(block.header.data(), reader.Ptr(), reader.GetHeaderSize());
 }
 
-void tool::gsc::RosettaAddOpCode(uint32_t loc, uint16_t opcode) {
-    if (!gRosettaOutput) {
+void tool::gsc::RosettaAddOpCode(T8GSCOBJContext& ctx, uint32_t loc, uint16_t opcode) {
+    if (!gRosettaOutput || !ctx.m_result) {
         return;
     }
 
-    auto& block = gRosettaBlocks[gRosettaCurrent].blocks;
+    auto& block = ctx.m_result->rosettaData.blocks;
 
     block.push_back(tool::gsc::RosettaOpCodeBlock{ .location = loc, .opcode = opcode });
 }
@@ -603,8 +797,8 @@ int GSCOBJHandler::PatchCode(T8GSCOBJContext& ctx) {
             else {
                 rcstr = "<invalid>";
             }
-            if (gDumpStrings) {
-                gDumpStringsStore.insert(rcstr);
+            if (gDumpStrings && ctx.m_result) {
+                ctx.m_result->dumpStrings.emplace_back(rcstr);
             }
             uint32_t ref = ctx.AddStringValue(rcstr);
 
@@ -849,8 +1043,8 @@ int GSCOBJHandler::PatchCode(T8GSCOBJContext& ctx) {
         else {
             rcstr = "<invalid>";
         }
-        if (gDumpStrings) {
-            gDumpStringsStore.insert(rcstr);
+        if (gDumpStrings && ctx.m_result) {
+            ctx.m_result->dumpStrings.emplace_back(rcstr);
         }
         uint32_t ref = ctx.AddStringValue(rcstr);
 
@@ -1000,6 +1194,20 @@ struct H64CER2GSCExportReader : GSCExportReader {
     size_t SizeOf() override { return sizeof(*exp); };
 };
 
+struct ACTSGSCExportReader : GSCExportReader {
+    acts::vm::ScriptExport* exp{};
+
+    void SetHandle(void* handle) override { exp = (acts::vm::ScriptExport*)handle; };
+    uint64_t GetName() override { return exp->name; };
+    uint64_t GetNamespace() override { return exp->name_space; };
+    uint64_t GetFileNamespace() override { return exp->export_data; };
+    uint64_t GetChecksum() override { return 0; };
+    uint32_t GetAddress() override { return exp->address; };
+    uint8_t GetParamCount() override { return exp->param_count; };
+    uint8_t GetFlags() override { return exp->flags; };
+    size_t SizeOf() override { return sizeof(*exp); };
+};
+
 
 
 const char* GetFLocName(GSCExportReader& reader, GSCOBJHandler& handler, uint32_t floc) {
@@ -1038,21 +1246,20 @@ const char* GetFLocName(GSCExportReader& reader, GSCOBJHandler& handler, uint32_
     return utils::va("unk:%lx", floc);
 }
 
-int GscInfoHandleData(byte* data, size_t size, std::filesystem::path fsPath, GscDecompilerGlobalContext& gdctx) {
+int GscInfoHandleData(byte* data, size_t size, std::filesystem::path fsPath, GscDecompilerGlobalContext& gdctx, GscDecompilerFileResult& res) {
     std::string pathStr{ fsPath.string() };
     const char* path{ pathStr.data() };
-    actslib::profiler::Profiler profiler{ "f" };
-    actslib::profiler::ProfiledSection ps{ profiler, path };
 
     const GscInfoOption& opt = gdctx.opt;
     
     T8GSCOBJContext ctx{ opt };
     ctx.m_formatter = opt.m_formatter;
+    ctx.m_result = &res;
     auto& gsicInfo = ctx.m_gsicInfo;
 
     gsicInfo.isGsic = size > 4 && !memcmp(data, "GSIC", 4);
     if (gsicInfo.isGsic) {
-        actslib::profiler::ProfiledSection ps{ profiler, "gsic reading"};
+        GscPhaseTimer pt{ res, GDP_READ };
         LOG_DEBUG("Reading GSIC Compiled Script data");
 
         size_t gsicSize = 4; // preamble
@@ -1146,6 +1353,7 @@ int GscInfoHandleData(byte* data, size_t size, std::filesystem::path fsPath, Gsc
         return tool::BASIC_ERROR;
     }
     scriptfile->originalFile = &fsPath;
+    res.scriptName = scriptfile->GetName();
 
     std::ofstream asmout{ };
     utils::CloseEnd asmoutclose{ asmout };
@@ -1164,8 +1372,9 @@ int GscInfoHandleData(byte* data, size_t size, std::filesystem::path fsPath, Gsc
         std::filesystem::path file{ utils::va("%s/%s", opt.m_outputDir, name) };
 
         {
-            core::async::opt_lock_guard lg{ gdctx.asyncMtx };
-            std::filesystem::create_directories(file.parent_path());
+            // another worker can create the same directory, the open will report the real issue
+            std::error_code ec{};
+            std::filesystem::create_directories(file.parent_path(), ec);
         }
         asmout.open(file);
 
@@ -1173,11 +1382,16 @@ int GscInfoHandleData(byte* data, size_t size, std::filesystem::path fsPath, Gsc
             LOG_ERROR("Can't open path output file {}", file.string());
             return tool::BASIC_ERROR;
         }
+        res.outputs.push_back(file);
         LOG_INFO("Decompiling into '{}'...", file.string());
     }
 
     // required for gscbin
-    int preloadRet{ scriptfile->PreLoadCode(ctx, opt.m_dumpSkipData ? asmout : utils::NullStream()) };
+    int preloadRet;
+    {
+        GscPhaseTimer pt{ res, GDP_PRELOAD };
+        preloadRet = scriptfile->PreLoadCode(ctx, opt.m_dumpSkipData ? asmout : utils::NullStream());
+    }
     if (preloadRet) {
         return preloadRet > 0 ? 0 : preloadRet;
     }
@@ -1186,7 +1400,7 @@ int GscInfoHandleData(byte* data, size_t size, std::filesystem::path fsPath, Gsc
         return GetFLocName(*exp, *scriptfile, floc);
     };
 
-    tool::gsc::RosettaStartFile(*scriptfile);
+    tool::gsc::RosettaStartFile(ctx, *scriptfile);
 
     std::stringstream actsHeader{};
     Platform currentPlatform{ opt.m_platform };
@@ -1552,14 +1766,13 @@ ignoreCscGsc:
     else {
         sprintf_s(asmfnamebuff, "%sasm", path);
     }
-    profiler.GetCurrent().name = asmfnamebuff;
 
     if (!ctx.opt.m_usePathOutput) {
         std::filesystem::path file{ std::filesystem::absolute(asmfnamebuff) };
 
         {
-            core::async::opt_lock_guard lg{ gdctx.asyncMtx };
-            std::filesystem::create_directories(file.parent_path());
+            std::error_code ec{};
+            std::filesystem::create_directories(file.parent_path(), ec);
         }
         asmout.open(file);
 
@@ -1567,6 +1780,7 @@ ignoreCscGsc:
             LOG_ERROR("Can't open output file {} ({})", asmfnamebuff, hashutils::ExtractTmpScript(scriptfile->GetName()));
             return tool::BASIC_ERROR;
         }
+        res.outputs.push_back(file);
         LOG_INFO("Decompiling into '{}'{}...", asmfnamebuff, (gsicInfo.isGsic ? " (GSIC)" : ""));
     }
 
@@ -1759,30 +1973,37 @@ ignoreCscGsc:
     int patchCodeResult{};
 
     if (opt.m_patch) {
-        actslib::profiler::ProfiledSection ps{ profiler, "patch linking"};
+        GscPhaseTimer pt{ res, GDP_PATCH };
         // unlink the script and write custom gvar/string ids
         patchCodeResult = scriptfile->PatchCode(ctx);
 
-        {
-            core::async::opt_lock_guard hlg{ hashutils::GetMutex(false) };
-            for (const auto& [id, str] : ctx.m_stringRefs) {
-                hashutils::AddPrecomputed(ctx.m_vmInfo->HashField(str), str, true);
-                hashutils::AddPrecomputed(ctx.m_vmInfo->HashFilePath(str), str, true);
-                hashutils::AddPrecomputed(ctx.m_vmInfo->HashPath(str), str, true);
-
-                // use all the known hashes for this VM
-                for (auto& [k, func] : ctx.m_vmInfo->hashesFunc) {
-                    try {
-                        int64_t hash = func.hashFunc(str);
-
-                        if (hash) {
-                            hashutils::AddPrecomputed(hash, str, true);
-                        }
-                    }
-                    catch (std::exception&) {
-                        // ignore
+        // compute the hashes before locking the map, the other workers are still reading it
+        std::vector<std::pair<uint64_t, const char*>> stringHashes{};
+        stringHashes.reserve(ctx.m_stringRefs.size() * (3 + ctx.m_vmInfo->hashesFunc.size()));
+        for (const auto& [id, str] : ctx.m_stringRefs) {
+            stringHashes.emplace_back(ctx.m_vmInfo->HashField(str), str);
+            stringHashes.emplace_back(ctx.m_vmInfo->HashFilePath(str), str);
+            stringHashes.emplace_back(ctx.m_vmInfo->HashPath(str), str);
+
+            // use all the known hashes for this VM
+            for (auto& [k, func] : ctx.m_vmInfo->hashesFunc) {
+                try {
+                    int64_t hash = func.hashFunc(str);
+
+                    if (hash) {
+                        stringHashes.emplace_back(hash, str);
                     }
                 }
+                catch (std::exception&) {
+                    // ignore
+                }
+            }
+        }
+
+        {
+            core::async::opt_lock_guard hlg{ hashutils::GetMutex(false) };
+            for (const auto& [hash, str] : stringHashes) {
+                hashutils::AddPrecomputed(hash, str, true);
             }
         }
     }
@@ -2070,7 +2291,6 @@ ignoreCscGsc:
     int exportErrors{};
 
     if (opt.m_func) {
-        actslib::profiler::ProfiledSection ps{ profiler, "decompiling" };
         // current namespace
         uint64_t currentNSP = 0;
 
@@ -2173,18 +2393,16 @@ ignoreCscGsc:
             output << "gscasm {\n";
 
             try {
+                GscPhaseTimer pt{ res, GDP_DISASM };
                 tool::gsc::DumpAsm(*exp, output, *scriptfile, ctx, asmctx);
             }
             catch (std::runtime_error& err) {
                 output << "FAILURE, " << err.what() << std::endl;
                 asmctx.DisableDecompiler(err.what());
 
-                {
-                    core::async::opt_lock_guard lg{ gdctx.asyncMtx };
-                    gdctx.hardErrors++;
-                    if (!(exportErrors++) || dumpAllErrors) {
-                        LOG_ERROR("Can't decompile export: {}", err.what());
-                    }
+                res.hardErrors++;
+                if (!(exportErrors++) || dumpAllErrors) {
+                    LOG_ERROR("Can't decompile export: {}", err.what());
                 }
             }
 
@@ -2207,7 +2425,10 @@ ignoreCscGsc:
 
 
             if ((!opt.m_dasm || opt.m_dcomp || opt.m_func_header_post) && !asmctx.m_disableDecompiler) {
-                asmctx.ComputeDefaultParamValue();
+                {
+                    GscPhaseTimer pt{ res, GDP_DEFAULT_PARAM_VALUE };
+                    asmctx.ComputeDefaultParamValue();
+                }
                 if (opt.m_dasm || opt.m_func_header_post) {
                     DumpFunctionHeader(*exp, output, *scriptfile, ctx, asmctx);
                 }
@@ -2224,8 +2445,12 @@ ignoreCscGsc:
                     }
 
                     if (!asmctx.m_vtable) {
-                        asmctx.ComputePreSpecialPattern();
+                        {
+                            GscPhaseTimer pt{ res, GDP_PRE_SPECIAL_PATTERN };
+                            asmctx.ComputePreSpecialPattern();
+                        }
                         if (!(asmctx.m_opt.m_stepskip & STEPSKIP_DEV)) {
+                            GscPhaseTimer pt{ res, GDP_DEV_BLOCKS };
                             asmctx.ComputeDevBlocks();
 
                             if (//(scriptfile->RemapFlagsExport(exp->GetFlags()) & T8GSCExportFlags::PRIVATE) != 0 &&
@@ -2240,28 +2465,39 @@ ignoreCscGsc:
                             }
                         }
                         if (!(asmctx.m_opt.m_stepskip & STEPSKIP_SWITCH)) {
+                            GscPhaseTimer pt{ res, GDP_SWITCH_BLOCKS };
                             asmctx.ComputeSwitchBlocks();
                         }
                         if (!(asmctx.m_opt.m_stepskip & STEPSKIP_FOREACH)) {
+                            GscPhaseTimer pt{ res, GDP_FOREACH_BLOCKS };
                             asmctx.ComputeForEachBlocks();
                         }
                         if (!(asmctx.m_opt.m_stepskip & STEPSKIP_WHILE)) {
+                            GscPhaseTimer pt{ res, GDP_WHILE_BLOCKS };
                             asmctx.ComputeWhileBlocks();
                         }
                         if (!(asmctx.m_opt.m_stepskip & STEPSKIP_FOR)) {
+                            GscPhaseTimer pt{ res, GDP_FOR_BLOCKS };
                             asmctx.ComputeForBlocks();
                         }
                         if (!(asmctx.m_opt.m_stepskip & STEPSKIP_IF)) {
+                            GscPhaseTimer pt{ res, GDP_IF_BLOCKS };
                             asmctx.ComputeIfBlocks();
                         }
                         if (!(asmctx.m_opt.m_stepskip & STEPSKIP_RETURN)) {
+                            GscPhaseTimer pt{ res, GDP_RETURN_JUMP };
                             asmctx.ComputeReturnJump();
                         }
                         if (!(asmctx.m_opt.m_stepskip & STEPSKIP_BOOL_RETURN)) {
+                            GscPhaseTimer pt{ res, GDP_BOOL_RETURN };
                             asmctx.ComputeBoolReturn();
                         }
-                        asmctx.ComputeSpecialPattern();
+                        {
+                            GscPhaseTimer pt{ res, GDP_SPECIAL_PATTERN };
+                            asmctx.ComputeSpecialPattern();
+                        }
                         if (opt.m_dasm) {
+                            GscPhaseTimer pt{ res, GDP_DUMP };
                             output << " ";
                             asmctx.Dump(output, dctx);
                         }
@@ -2275,6 +2511,7 @@ ignoreCscGsc:
         }
 
         if (!opt.m_dasm && opt.m_dcomp) {
+            GscPhaseTimer pt{ res, GDP_DUMP };
             // current namespace
             currentNSP = 0;
             int currentPadding{};
@@ -2537,6 +2774,7 @@ ignoreCscGsc:
     }
 
     if (opt.m_generateGdbData && (opt.m_generateGdbBaseData || (ctx.m_unkstrings.size() || ctx.m_devblocks.size() || ctx.m_lazyLinks.size()))) {
+        GscPhaseTimer pt{ res, GDP_DUMP };
 
         char asmfnamebuffgdb[1000];
         if (opt.m_dbgOutputDir) {
@@ -2579,6 +2817,7 @@ ignoreCscGsc:
             LOG_ERROR("Can't open {}", gdbFile);
             return -1;
         }
+        res.outputs.push_back(gdbFile);
 
         // header
         if (opt.m_copyright) {
@@ -2669,23 +2908,18 @@ ignoreCscGsc:
         gdbpos.close();
     }
 
-    {
-        core::async::opt_lock_guard lg{ gdctx.asyncMtx };
-
-        if (opt.vtable_dump) {
-            for (auto& [n, c] : ctx.m_classes) {
-                auto& t = gdctx.vtables[scriptfile->GetName()][n];
-                for (auto& meth : c.m_vtableMethods) {
-                    t.insert(NameLocated{ meth.name_space , meth.name });
-                }
+    if (opt.vtable_dump) {
+        for (auto& [n, c] : ctx.m_classes) {
+            auto& t = res.vtables[n];
+            for (auto& meth : c.m_vtableMethods) {
+                t.insert(NameLocated{ meth.name_space , meth.name });
             }
-
-        }
-        gdctx.decompiledFiles++;
-        if (exportErrors) {
-            LOG_ERROR("Found {} error(s)", exportErrors);
         }
     }
+    res.decompiled = true;
+    if (exportErrors) {
+        LOG_ERROR("Found {} error(s)", exportErrors);
+    }
 
     return 0;
 }
@@ -2980,7 +3214,7 @@ int tool::gsc::DumpAsm(GSCExportReader& exp, std::ostream& out, GSCOBJHandler& g
                 << std::right << " " << std::flush;
 
             // dump rosetta data
-            RosettaAddOpCode((uint32_t)(reinterpret_cast<uint64_t>(base) - reinterpret_cast<uint64_t>(gscFile.Ptr())), handler->m_id);
+            RosettaAddOpCode(objctx, (uint32_t)(reinterpret_cast<uint64_t>(base) - reinterpret_cast<uint64_t>(gscFile.Ptr())), handler->m_id);
 
             // pass the opcode
 
@@ -3311,6 +3545,9 @@ int tool::gsc::ComputeSize(GSCExportReader& exp, byte* gscFile, Platform plt, Vm
 }
 
 std::unique_ptr<GSCExportReader> tool::gsc::CreateExportReader(VmInfo* vmInfo) {
+    if (vmInfo->vmMagic == VMI_ACTS_F1) {
+        return std::make_unique<ACTSGSCExportReader>();
+    }
     if (vmInfo->HasFlag(VmFlags::VMF_GSCBIN)) {
         return std::make_unique<BINGSCExportReader>();
     }
@@ -3684,82 +3921,224 @@ int tool::gsc::gscinfo(Process& proc, int argc, const char* argv[]) {
         }
     }
 
-    if (gdctx.opt.m_sync) {
+    struct FileToDecompile {
+        std::filesystem::path path;
+        std::filesystem::path pathRel;
+    };
+    std::vector<FileToDecompile> files{};
+    for (FileOrigin& pathLoc : scriptFiles) {
+        for (std::filesystem::path& pathRel : pathLoc.scriptFiles) {
+            files.push_back({ pathLoc.dir ? pathLoc.base / pathRel : pathLoc.base, pathRel });
+        }
+    }
+
+    std::unique_ptr<cache::DecompilerCache> decompCache{};
+    if (gdctx.opt.m_cacheDir) {
+        if (gdctx.opt.vtable_dump || gdctx.opt.m_dump_strings || gdctx.opt.m_rosetta || gdctx.opt.m_dump_hashmap || globalHM) {
+            // these outputs are computed using the decompiler data
+            LOG_WARNING("The cache can't be used with a vtable, strings, rosetta or hashmap dump, ignored");
+        }
+        else {
+            // the hash map is fingerprinted once, the names learned during the run are checked with the resolved
+            // names of each entry
+            uint64_t baseKey{ hash::Hash64Value(gdctx.opt.ComputeOutputKey(), hashutils::GetFingerprint()) };
+            // the warnings are only stored if they are printed
+            baseKey = hash::Hash64Value(baseKey, core::logs::getlevel() <= core::logs::LVL_WARNING);
+            std::vector<std::tuple<uint64_t, uint32_t, uint32_t>> dbgs{};
+            for (auto& [name, gdb] : gdctx.debugObjects) {
+                dbgs.emplace_back(name, gdb->crc, gdb->version);
+            }
+            std::sort(dbgs.begin(), dbgs.end());
+            for (auto& [name, crc, version] : dbgs) {
+                baseKey = hash::Hash64Value(baseKey, name);
+                baseKey = hash::Hash64Value(baseKey, crc);
+                baseKey = hash::Hash64Value(baseKey, version);
+            }
+
+            if (utils::cache::HashBuild(baseKey)) {
+                decompCache = std::make_unique<cache::DecompilerCache>(gdctx.opt.m_cacheDir, baseKey);
+                LOG_INFO("Using decompiler cache '{}'", gdctx.opt.m_cacheDir);
+            }
+            else {
+                LOG_WARNING("The decompiler cache is disabled");
+            }
+        }
+    }
+
+    gdctx.profile = gdctx.opt.m_profileTop || actscli::options().saveProfiler;
+    gdctx.profileStart = actslib::profiler::GetTimestamp();
+
+    // names learned by the previous files in sync mode, the output of a file depends on them
+    uint64_t learnedKey{};
+
+    auto decompileFile = [&gdctx, &decompCache, &learnedKey](const FileToDecompile& file, GscDecompilerFileResult& res) {
         std::string buffer{};
         void* bufferAlign{};
         size_t size{};
-        for (FileOrigin& pathLoc : scriptFiles) {
-            for (std::filesystem::path pathRel : pathLoc.scriptFiles) {
-                std::filesystem::path path{ pathLoc.dir ? pathLoc.base / pathRel : pathLoc.base };
-                LOG_DEBUG("Reading {} ({})", path.string(), pathRel.string());
 
-                if (!utils::ReadFileAlign(path, buffer, bufferAlign, size)) {
-                    LOG_ERROR("Can't read file data for {}", path.string());
-                    continue;
+        res.path = file.pathRel;
+        res.profile = gdctx.profile;
+
+        LOG_DEBUG("Reading {} ({})", file.path.string(), file.pathRel.string());
+        {
+            GscPhaseTimer pt{ res, GDP_READ };
+            if (!utils::ReadFileAlign(file.path, buffer, bufferAlign, size)) {
+                LOG_ERROR("Can't read file data for {}", file.path.string());
+                return;
+            }
+        }
+
+        uint64_t cacheKey{};
+        cache::DecompilerCacheEntry entry{};
+        if (decompCache) {
+            cacheKey = hash::Hash64Value(decompCache->ComputeKey(bufferAlign, size, file.pathRel), learnedKey);
+
+            if (decompCache->Load(cacheKey, entry) && cache::DecompilerCache::WriteOutputs(entry)) {
+                LOG_DEBUG("Cache hit for {} ({:x})", file.path.string(), cacheKey);
+                // replay the warnings printed by the decompiler
+                core::logs::flushbuffer(entry.diagnostics);
+                res.learnedHashes = std::move(entry.learnedHashes);
+                res.ret = entry.ret;
+                res.decompiled = entry.decompiled;
+                res.hardErrors = (size_t)entry.hardErrors;
+                return;
+            }
+            entry = {}; // partially loaded
+        }
+
+        // the learned hashes are only visible by this file until it is merged in sync mode or until the end of the
+        // batch in async mode
+        hashutils::HashRecord record{};
+        // the resolved names are only used to check the cache entries
+        record.recordResolved = decompCache != nullptr;
+        // capture the logs to replay them on a hit
+        std::vector<core::logs::bufferedlog> logs{};
+        std::vector<core::logs::bufferedlog>* outLogs{ core::logs::getthreadbuffer() };
+        if (decompCache) {
+            core::logs::setthreadbuffer(&logs);
+        }
+        {
+            hashutils::RecordHashes(&record);
+            utils::CloseEnd ce{ [&decompCache, &logs, outLogs] {
+                hashutils::RecordHashes(nullptr);
+                if (decompCache) {
+                    core::logs::setthreadbuffer(outLogs);
+                    core::logs::flushbuffer(logs);
                 }
-                try {
-                    auto lret = GscInfoHandleData((byte*)bufferAlign, size, pathRel, gdctx);
-                    if (lret != tool::OK) {
-                        ret = lret;
-                    }
+            } };
+
+            try {
+                res.ret = GscInfoHandleData((byte*)bufferAlign, size, file.pathRel, gdctx, res);
+            }
+            catch (std::exception& e) {
+                LOG_ERROR("Exception when reading {}: {}", file.path.string(), e.what());
+                res.ret = tool::BASIC_ERROR;
+            }
+        }
+
+        res.learnedHashes.assign(record.learned.begin(), record.learned.end());
+        std::sort(res.learnedHashes.begin(), res.learnedHashes.end());
+
+        if (decompCache) {
+            if (res.ret != tool::OK) {
+                return; // do not cache the errors, they can be fixed by the user
+            }
+
+            entry.learnedHashes = res.learnedHashes;
+            entry.resolvedNames.assign(record.resolved.begin(), record.resolved.end());
+            std::sort(entry.resolvedNames.begin(), entry.resolvedNames.end());
+
+            for (core::logs::bufferedlog& log : logs) {
+                if (log.level >= core::logs::LVL_WARNING) {
+                    entry.diagnostics.emplace_back(std::move(log));
                 }
-                catch (std::runtime_error& e) {
-                    LOG_ERROR("Exception when reading {}: {}", path.string(), e.what());
-                    ret = tool::BASIC_ERROR;
+            }
+
+            entry.ret = res.ret;
+            entry.decompiled = res.decompiled;
+            entry.hardErrors = res.hardErrors;
+            entry.outputs.clear();
+            for (const std::filesystem::path& output : res.outputs) {
+                std::string data{};
+                if (!utils::ReadFile(output, data)) {
+                    LOG_WARNING("Can't read output {}, the file won't be cached", output.string());
+                    return;
                 }
+                entry.outputs.emplace_back(output.string(), std::move(data));
+            }
+
+            decompCache->Store(cacheKey, entry);
+        }
+    };
+
+    if (gdctx.opt.m_sync) {
+        for (const FileToDecompile& file : files) {
+            GscDecompilerFileResult res{};
+            decompileFile(file, res);
+            if (res.ret != tool::OK) {
+                ret = res.ret;
             }
+            // the next files can use the names learned by this file
+            for (auto& [hash, str] : res.learnedHashes) {
+                hashutils::AddPrecomputed(hash, str.data());
+                learnedKey = hash::Hash64Value(learnedKey, hash);
+                learnedKey = hash::Hash64Buffer(str.data(), str.length(), learnedKey);
+            }
+            gdctx.MergeResult(res);
         }
     }
     else {
-        LOG_WARNING("Using experimental async mode");
         uint64_t prevAsyncTypes = core::async::GetAsyncTypes();
         core::async::SetAsync(core::async::AT_ALL);
 
-        std::mutex mtx{};
-        gdctx.asyncMtx = &mtx;
+        // load the hashes before starting the workers
+        hashutils::ReadDefaultFile();
 
-        BS::thread_pool pool{};
+        // 0 = hardware concurrency
+        BS::thread_pool pool{ (BS::concurrency_t)gdctx.opt.m_threads };
+        LOG_INFO("Decompiling {} file(s) using {} thread(s)", files.size(), pool.get_thread_count());
 
-        for (FileOrigin& pathLoc : scriptFiles) {
-            for (std::filesystem::path pathRel : pathLoc.scriptFiles) {
-                std::filesystem::path path{ pathLoc.dir ? pathLoc.base / pathRel : pathLoc.base };
-                pool.detach_task([path, pathRel, &mtx, &ret, &gdctx] {
-                    std::string buffer{};
-                    void* bufferAlign{};
-                    size_t size{};
+        // each file has its own result, they are merged in the input order to have the same output as the sync mode
+        std::vector<GscDecompilerFileResult> results(files.size());
 
-                    LOG_DEBUG("Reading {} ({})", path.string(), pathRel.string());
-                    int lret;
-                    if (!utils::ReadFileAlign(path, buffer, bufferAlign, size)) {
-                        lret = tool::BASIC_ERROR;
-                    }
-                    else if (size < 0x8) { // MAGIC (8) or GSC\0 + 3 * uint32_t
-                        LOG_ERROR("Invalid header, file size: {:x}/{:x} for {}", size, 0x8, path.string());
-                        lret = tool::BASIC_ERROR;
-                    }
-                    else {
-                        lret = GscInfoHandleData((byte*)bufferAlign, size, pathRel, gdctx);
-                    }
-
-                    if (lret != tool::OK) {
-                        std::lock_guard lg{ mtx };
-                        ret = lret;
-                    }
-                   });
-            }
+        for (size_t i = 0; i < files.size(); i++) {
+            pool.detach_task([i, &files, &results, &decompileFile] {
+                decompileFile(files[i], results[i]);
+            });
         }
 
         pool.wait();
 
+        for (GscDecompilerFileResult& res : results) {
+            if (res.ret != tool::OK) {
+                ret = res.ret;
+            }
+            gdctx.MergeResult(res);
+        }
+
         core::async::SetAsync(prevAsyncTypes);
     }
 
 
+    // add the learned hashes in the input order, the first file learning a hash keeps it with any number of threads,
+    // they were already added by the sync mode
+    for (auto& [hash, str] : gdctx.learnedHashes) {
+        hashutils::AddPrecomputed(hash, str.data());
+    }
+
     if (gdctx.hardErrors) {
         LOG_ERROR("{} (0x{:x}) error(s), are you using the right vm type?", gdctx.hardErrors, gdctx.hardErrors);
     }
     LOG_INFO("{} (0x{:x}) file(s) decompiled.", gdctx.decompiledFiles, gdctx.decompiledFiles);
 
+    if (decompCache) {
+        decompCache->PrintStats();
+    }
+
+    if (gdctx.profile) {
+        gdctx.WriteProfile();
+    }
+
     if (!globalHM) {
         hashutils::WriteExtracted(gdctx.opt.m_dump_hashmap);
     }
@@ -3770,7 +4149,7 @@ int tool::gsc::gscinfo(Process& proc, int argc, const char* argv[]) {
             LOG_ERROR("Can't open string output");
         }
         else {
-            for (const auto& str : gDumpStringsStore) {
+            for (const auto& str : gdctx.dumpStrings) {
                 os << str << "\n";
             }
             os.close();
@@ -3782,20 +4161,27 @@ int tool::gsc::gscinfo(Process& proc, int argc, const char* argv[]) {
             LOG_ERROR("Can't open vtable output");
         }
         else {
-            os << "script,class,namespace,name";
+            // sort the entries to have the same output with any number of threads
+            std::vector<std::tuple<uint64_t, uint64_t, uint64_t, uint64_t>> entries{};
             for (auto& [script, clss] : gdctx.vtables) {
                 for (auto& [cls, ns] : clss) {
                     for (auto& n : ns) {
-                        os
-                            << "\n"
-                            << hashutils::ExtractTmp("script", script) << ","
-                            << hashutils::ExtractTmp("class", cls) << ","
-                            << hashutils::ExtractTmp("namespace", n.name_space) << ","
-                            << hashutils::ExtractTmp("function", n.name)
-                            ;
+                        entries.emplace_back(script, cls, n.name_space, n.name);
                     }
                 }
             }
+            std::sort(entries.begin(), entries.end());
+
+            os << "script,class,namespace,name";
+            for (auto& [script, cls, nsp, name] : entries) {
+                os
+                    << "\n"
+                    << hashutils::ExtractTmp("script", script) << ","
+                    << hashutils::ExtractTmp("class", cls) << ","
+                    << hashutils::ExtractTmp("namespace", nsp) << ","
+                    << hashutils::ExtractTmp("function", name)
+                    ;
+            }
 
 
             os.close();
@@ -3813,10 +4199,10 @@ int tool::gsc::gscinfo(Process& proc, int argc, const char* argv[]) {
         else {
             os.write("ROS2", 4);
 
-            uint64_t len = (uint64_t)gRosettaBlocks.size();
+            uint64_t len = (uint64_t)gdctx.rosettaBlocks.size();
             os.write(reinterpret_cast<const char*>(&len), sizeof(len));
 
-            for (const auto& [key, data] : gRosettaBlocks) {
+            for (const auto& [key, data] : gdctx.rosettaBlocks) {
                 // gsc header
                 len = (uint64_t)data.header.length();
                 os.write(reinterpret_cast<const char*>(&len), sizeof(len));
@@ -3841,6 +4227,73 @@ int tool::gsc::gscinfo(Process& proc, int argc, const char* argv[]) {
     return ret;
 }
 
+namespace {
+    void gscdecompilebench(acts::unit_test::BenchmarkContext& ctx) {
+        struct CompiledFile {
+            std::filesystem::path path;
+            std::vector<byte> data;
+        };
+        // compiled once, the compiler has its own benchmark
+        static std::vector<CompiledFile> compiled{};
+        static bool compiledLoaded{};
+
+        if (!compiledLoaded) {
+            compiledLoaded = true;
+            acts::compiler::CompilerConfig cfg{};
+            cfg.vm = VMOf(ctx.vm);
+            cfg.platform = PlatformOf(ctx.platform);
+
+            if (!cfg.vm || !cfg.platform) {
+                throw std::runtime_error(std::format("Invalid vm/platform {}/{}", ctx.vm, ctx.platform));
+            }
+
+            for (const std::filesystem::path& path : ctx.GetCorpusFiles("gsc-compiler", ".gsc\0.csc\0")) {
+                std::string name{ path.filename().string() };
+                acts::compiler::CompilerConfig fileCfg{ cfg };
+                fileCfg.clientScript = path.extension() == ".csc";
+                fileCfg.name = name.data();
+
+                CompiledFile file{ path.filename() };
+                file.path.replace_extension(fileCfg.clientScript ? ".cscc" : ".gscc");
+                try {
+                    acts::compiler::CompileGsc(std::vector<std::filesystem::path>{ path }, file.data, fileCfg);
+                }
+                catch (std::runtime_error& e) {
+                    LOG_DEBUG("Can't compile {}: {}", path.string(), e.what());
+                    continue;
+                }
+                compiled.emplace_back(std::move(file));
+            }
+        }
+
+        std::string outDir{ (std::filesystem::temp_directory_path() / "acts-bench").string() };
+        GscDecompilerGlobalContext gdctx{};
+        gdctx.opt.m_dcomp = true;
+        gdctx.opt.m_outputDir = outDir.data();
+        gdctx.opt.m_dbgOutputDir = outDir.data();
+
+        std::vector<byte> buffer{};
+        for (const CompiledFile& file : compiled) {
+            // the decompiler is patching the data
+            buffer = file.data;
+
+            ctx.Measure(buffer.size(), [&]() -> bool {
+                GscDecompilerFileResult res{};
+                try {
+                    res.ret = GscInfoHandleData(buffer.data(), buffer.size(), file.path, gdctx, res);
+                }
+                catch (std::runtime_error& e) {
+                    LOG_DEBUG("Can't decompile {}: {}", file.path.string(), e.what());
+                    return false;
+                }
+                return res.ret == tool::OK;
+            });
+        }
+    }
+
+    ADD_BENCHMARK(gscdecompile, gscdecompilebench);
+}
+
 ADD_TOOL(gscinfo, "gsc", "", "GSC decompiler/disassembler", nullptr, gscinfo);
 ADD_TOOL(gscd, "gsc", "", "GSC decompiler/disassembler", nullptr, gscinfo);
 ADD_TOOL(dds, "gsc", " [input=scriptparsetree] [output=dataset.csv]", "dump dataset from gscinfo", nullptr, dumpdataset);
@@ -3,6 +3,8 @@
 #include "gsc_formatter.hpp"
 #include "gsc_gdb.hpp"
 #include <includes.hpp>
+#include <atomic>
+#include <chrono>
 
 namespace tool::gsc {
     enum GscInfoOptionStepSkip {
@@ -92,6 +94,7 @@ namespace tool::gsc {
         const char* m_dbgOutputDir{};
         const char* m_copyright{};
         const char* m_dbgInputDir{};
+        const char* m_cacheDir{};
         bool m_show_internal_blocks{};
         bool m_show_func_vars{};
         bool m_mark_jump_type{};
@@ -104,6 +107,8 @@ namespace tool::gsc {
         bool m_noPath{};
         bool m_ignoreDebugPlatform{};
         bool m_sync{ true };
+        size_t m_threads{};
+        size_t m_profileTop{};
         bool m_vtable{};
         bool m_debugHashes{};
         bool m_usePathOutput{};
@@ -132,6 +137,11 @@ namespace tool::gsc {
          * Print help in a stream
          */
         void PrintHelp();
+        /*
+         * Compute a key of the options changing the decompiler output
+         * @return key
+         */
+        uint64_t ComputeOutputKey() const;
     };
     struct T8GSCExport;
     struct IW23GSCImport;
@@ -773,14 +783,106 @@ namespace tool::gsc {
         GDGCW_BAD_HASH_PATH_INCLUDE = 1 << 3,
     };
 
+    enum RosettaBlockType : byte {
+        RBT_START = 0x50,
+        RBT_OPCODE = 0x51,
+    };
+    struct RosettaOpCodeBlock {
+        uint32_t location;
+        uint16_t opcode;
+    };
+    struct RosettaFileData {
+        std::string header{};
+        std::vector<RosettaOpCodeBlock> blocks{};
+    };
+
+    // Decompiler phases measured by the profiler
+    enum GscDecompilerPhase : size_t {
+        GDP_READ = 0,
+        GDP_PRELOAD,
+        GDP_PATCH,
+        GDP_DISASM,
+        GDP_DEFAULT_PARAM_VALUE,
+        GDP_PRE_SPECIAL_PATTERN,
+        GDP_DEV_BLOCKS,
+        GDP_SWITCH_BLOCKS,
+        GDP_FOREACH_BLOCKS,
+        GDP_WHILE_BLOCKS,
+        GDP_FOR_BLOCKS,
+        GDP_IF_BLOCKS,
+        GDP_RETURN_JUMP,
+        GDP_BOOL_RETURN,
+        GDP_SPECIAL_PATTERN,
+        GDP_DUMP,
+        GDP_COUNT,
+    };
+
+    /*
+     * Get the name of a decompiler phase
+     * @param phase phase
+     * @return name
+     */
+    const char* GetDecompilerPhaseName(GscDecompilerPhase phase);
+
+    // Data produced while decompiling a file, only the worker of this file can access it
+    struct GscDecompilerFileResult {
+        std::filesystem::path path{};
+        bool profile{};
+        std::array<uint64_t, GDP_COUNT> phaseTimes{};
+        int ret{};
+        bool decompiled{};
+        size_t hardErrors{};
+        uint64_t scriptName{};
+        std::unordered_map<uint64_t, std::unordered_set<NameLocated, NameLocatedHash, NameLocatedEquals>> vtables{};
+        std::vector<std::string> dumpStrings{};
+        bool rosetta{};
+        RosettaFileData rosettaData{};
+        std::vector<std::filesystem::path> outputs{};
+        // hashes learned while decompiling the file, sorted by hash
+        std::vector<std::pair<uint64_t, std::string>> learnedHashes{};
+    };
+
+    // Add the time spent in a scope to a decompiler phase of a file, nothing is done if the profiling isn't enabled
+    class GscPhaseTimer {
+        GscDecompilerFileResult& res;
+        GscDecompilerPhase phase;
+        std::chrono::steady_clock::time_point start{};
+    public:
+        GscPhaseTimer(GscDecompilerFileResult& res, GscDecompilerPhase phase) : res(res), phase(phase) {
+            if (res.profile) {
+                start = std::chrono::steady_clock::now();
+            }
+        }
+
+        ~GscPhaseTimer() {
+            if (res.profile) {
+                res.phaseTimes[phase] += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+            }
+        }
+    };
+
+    // Phase times aggregated over all the decompiled files
+    struct GscDecompilerPhaseStats {
+        uint64_t totalTime{};
+        size_t files{};
+        // min-heap of the slowest files
+        std::vector<std::pair<uint64_t, std::filesystem::path>> slowest{};
+    };
+
     struct GscDecompilerGlobalContext {
-        std::mutex* asyncMtx{};
         GscInfoOption opt{};
-        uint64_t warningOpt{};
+        std::atomic<uint64_t> warningOpt{};
         std::unordered_map<uint64_t, tool::gsc::gdb::ACTS_GSC_GDB*> debugObjects{};
         size_t decompiledFiles{};
         size_t hardErrors{};
         std::unordered_map<uint64_t, std::unordered_map<uint64_t, std::unordered_set<NameLocated, NameLocatedHash, NameLocatedEquals>>> vtables{};
+        // hashes learned by the files, added to the hash map after the batch
+        std::vector<std::pair<uint64_t, std::string>> learnedHashes{};
+        std::unordered_set<std::string> dumpStrings{};
+        std::map<uint64_t, RosettaFileData> rosettaBlocks{};
+        bool profile{};
+        long long profileStart{};
+        std::array<GscDecompilerPhaseStats, GDP_COUNT> phaseStats{};
 
         ~GscDecompilerGlobalContext() {
             for (auto& [n, d] : debugObjects) {
@@ -789,6 +891,16 @@ namespace tool::gsc {
         }
 
         bool WarningType(GscDecompilerGlobalContextWarn warn);
+        /*
+         * Merge the result of a file into the global context, to keep the same output
+         * as the sync mode, the results should be merged in the input order.
+         * @param res file result
+         */
+        void MergeResult(GscDecompilerFileResult& res);
+        /*
+         * Write the aggregated phase times into the tool profiler and log the slowest files of each phase
+         */
+        void WriteProfile();
     };
     // Result context for T8GSCOBJ::PatchCode
     class T8GSCOBJContext {
@@ -810,6 +922,7 @@ namespace tool::gsc {
         std::unordered_map<uint64_t, gscclass> m_classes{};
         tool::gsc::gdb::ACTS_GSC_GDB* gdbctx{};
         const tool::gsc::formatter::FormatterInfo* m_formatter{};
+        GscDecompilerFileResult* m_result{};
         const GscInfoOption& opt;
         T8GSCOBJContext(const GscInfoOption& opt);
         ~T8GSCOBJContext();
@@ -1434,30 +1547,19 @@ namespace tool::gsc {
         T9_IF_DEV_CALL = 0x20,
     };
 
-    enum RosettaBlockType : byte {
-        RBT_START = 0x50,
-        RBT_OPCODE = 0x51,
-    };
-    struct RosettaOpCodeBlock {
-        uint32_t location;
-        uint16_t opcode;
-    };
-    struct RosettaFileData {
-        std::string header{};
-        std::vector<RosettaOpCodeBlock> blocks{};
-    };
-
     /*
      * Begin rosetta file data
+     * @param ctx file context
      * @param reader reader
      */
-    void RosettaStartFile(GSCOBJHandler& reader);
+    void RosettaStartFile(T8GSCOBJContext& ctx, GSCOBJHandler& reader);
     /*
      * Add rosetta opcode data
+     * @param ctx file context
      * @param loc opcode location
      * @param opcode opcode
      */
-    void RosettaAddOpCode(uint32_t loc, uint16_t opcode);
+    void RosettaAddOpCode(T8GSCOBJContext& ctx, uint32_t loc, uint16_t opcode);
 
     // gsc tool
     int gscinfo(Process& proc, int argc, const char* argv[]);
@@ -0,0 +1,146 @@
+#include <includes.hpp>
+#include <utils/utils.hpp>
+#include "gsc_decompiler_cache.hpp"
+
+namespace tool::gsc::cache {
+	using utils::cache::CacheReader;
+	using utils::cache::WriteString;
+
+	std::filesystem::path DecompilerCache::GetEntryPath(uint64_t key) const {
+		return dir / utils::va("%02llx", key >> 56) / utils::va("%016llx.gdc", key);
+	}
+
+	uint64_t DecompilerCache::ComputeKey(const void* data, size_t size, const std::filesystem::path& path) const {
+		std::string pathStr{ path.string() };
+
+		uint64_t key{ hash::Hash64Value(baseKey, (uint64_t)size) };
+		key = hash::Hash64Buffer(data, size, key);
+		return hash::Hash64Buffer(pathStr.data(), pathStr.length(), key);
+	}
+
+	bool DecompilerCache::Load(uint64_t key, DecompilerCacheEntry& entry) {
+		std::filesystem::path path{ GetEntryPath(key) };
+		std::string buffer{};
+
+		if (!std::filesystem::exists(path) || !utils::ReadFile(path, buffer)) {
+			stats.misses++;
+			return false;
+		}
+
+		try {
+			CacheReader reader{ buffer };
+
+			if (reader.Read<uint64_t>() != MAGIC || reader.Read<uint32_t>() != VERSION) {
+				throw std::runtime_error("bad magic");
+			}
+
+			entry.ret = reader.Read<int32_t>();
+			entry.decompiled = reader.Read<byte>() != 0;
+			entry.hardErrors = reader.Read<uint64_t>();
+
+			uint64_t outputs{ reader.Read<uint64_t>() };
+			entry.outputs.clear();
+			for (size_t i = 0; i < outputs; i++) {
+				std::string name{ reader.ReadString() };
+				entry.outputs.emplace_back(std::move(name), reader.ReadString());
+			}
+
+			uint64_t learned{ reader.Read<uint64_t>() };
+			entry.learnedHashes.clear();
+			for (size_t i = 0; i < learned; i++) {
+				uint64_t hash{ reader.Read<uint64_t>() };
+				entry.learnedHashes.emplace_back(hash, reader.ReadString());
+			}
+
+			uint64_t resolved{ reader.Read<uint64_t>() };
+			entry.resolvedNames.clear();
+			for (size_t i = 0; i < resolved; i++) {
+				uint64_t hash{ reader.Read<uint64_t>() };
+				entry.resolvedNames.emplace_back(hash, reader.ReadString());
+			}
+
+			uint64_t diagnostics{ reader.Read<uint64_t>() };
+			entry.diagnostics.clear();
+			for (size_t i = 0; i < diagnostics; i++) {
+				entry.diagnostics.emplace_back(reader.ReadLog());
+			}
+		}
+		catch (std::runtime_error& e) {
+			LOG_WARNING("Invalid cache entry {}: {}", path.string(), e.what());
+			stats.errors++;
+			stats.misses++;
+			return false;
+		}
+
+		// the names learned by the file are added with the entry
+		std::unordered_set<uint64_t> learned{};
+		for (const auto& [hash, str] : entry.learnedHashes) {
+			learned.insert(hash);
+		}
+		for (const auto& [hash, str] : entry.resolvedNames) {
+			if (learned.contains(hash)) {
+				continue;
+			}
+			const char* current{ hashutils::ExtractPtr(hash) };
+			if (!current || str != current) {
+				LOG_DEBUG("Outdated cache entry {}: {:x}", path.string(), hash);
+				stats.outdated++;
+				stats.misses++;
+				return false;
+			}
+		}
+
+		stats.hits++;
+		stats.bytesRead += buffer.size();
+		return true;
+	}
+
+	bool DecompilerCache::Store(uint64_t key, const DecompilerCacheEntry& entry) {
+		std::vector<byte> buffer{};
+
+		utils::WriteValue<uint64_t>(buffer, MAGIC);
+		utils::WriteValue<uint32_t>(buffer, VERSION);
+		utils::WriteValue<int32_t>(buffer, entry.ret);
+		utils::WriteValue<byte>(buffer, entry.decompiled ? 1 : 0);
+		utils::WriteValue<uint64_t>(buffer, entry.hardErrors);
+		utils::WriteValue<uint64_t>(buffer, (uint64_t)entry.outputs.size());
+		for (const auto& [name, data] : entry.outputs) {
+			WriteString(buffer, name);
+			WriteString(buffer, data);
+		}
+		utils::WriteValue<uint64_t>(buffer, (uint64_t)entry.learnedHashes.size());
+		for (const auto& [hash, str] : entry.learnedHashes) {
+			utils::WriteValue<uint64_t>(buffer, hash);
+			WriteString(buffer, str);
+		}
+		utils::WriteValue<uint64_t>(buffer, (uint64_t)entry.resolvedNames.size());
+		for (const auto& [hash, str] : entry.resolvedNames) {
+			utils::WriteValue<uint64_t>(buffer, hash);
+			WriteString(buffer, str);
+		}
+		utils::WriteValue<uint64_t>(buffer, (uint64_t)entry.diagnostics.size());
+		for (const core::logs::bufferedlog& log : entry.diagnostics) {
+			utils::cache::WriteLog(buffer, log);
+		}
+
+		return utils::cache::WriteEntry(GetEntryPath(key), buffer, stats);
+	}
+
+	bool DecompilerCache::WriteOutputs(const DecompilerCacheEntry& entry) {
+		for (const auto& [name, data] : entry.outputs) {
+			std::filesystem::path path{ name };
+			std::error_code ec{};
+			std::filesystem::create_directories(path.parent_path(), ec);
+
+			if (!utils::WriteFile(path, data)) {
+				LOG_ERROR("Can't write cached output {}", name);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	void DecompilerCache::PrintStats() const {
+		stats.Print();
+	}
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <utils/cache_utils.hpp>
+
+namespace tool::gsc::cache {
+	constexpr uint64_t MAGIC = 0x3130434447534341; // ACSGDC01
+	constexpr uint32_t VERSION = 3;
+
+	// Cached result of a decompiled file
+	struct DecompilerCacheEntry {
+		int ret{};
+		bool decompiled{};
+		uint64_t hardErrors{};
+		// files written by the decompiler and their content
+		std::vector<std::pair<std::string, std::string>> outputs{};
+		// hashes added to the hash map while decompiling the file
+		std::vector<std::pair<uint64_t, std::string>> learnedHashes{};
+		// names read from the hash map while decompiling the file, sorted by hash
+		std::vector<std::pair<uint64_t, std::string>> resolvedNames{};
+		// warnings and errors printed by the decompiler
+		std::vector<core::logs::bufferedlog> diagnostics{};
+	};
+
+	// Content addressed cache of the decompiled files, the key is computed from the file data,
+	// the decompiler build and options, the warnings level and the hash map at the start of the run, an entry is
+	// stored in <dir>/<key[0:2]>/<key>.gdc
+	class DecompilerCache {
+		std::filesystem::path dir;
+		uint64_t baseKey;
+		utils::cache::CacheStats stats{};
+
+		std::filesystem::path GetEntryPath(uint64_t key) const;
+	public:
+		/*
+		 * Create a cache
+		 * @param dir cache directory
+		 * @param baseKey key of the build, of the options and of the hash map used to decompile the files
+		 */
+		DecompilerCache(const std::filesystem::path& dir, uint64_t baseKey) : dir(dir), baseKey(baseKey) {}
+
+		/*
+		 * Compute the key of a file, it only depends on the base key and on the file
+		 * @param data file data
+		 * @param size file size
+		 * @param path relative path of the file, used to compute the output names
+		 * @return key
+		 */
+		uint64_t ComputeKey(const void* data, size_t size, const std::filesystem::path& path) const;
+
+		/*
+		 * Load a cache entry, the entry is ignored if one of its resolved names isn't in the hash map anymore
+		 * @param key entry key
+		 * @param entry entry to fill
+		 * @return true if the entry was loaded
+		 */
+		bool Load(uint64_t key, DecompilerCacheEntry& entry);
+
+		/*
+		 * Store a cache entry
+		 * @param key entry key
+		 * @param entry entry to store
+		 * @return true if the entry was stored
+		 */
+		bool Store(uint64_t key, const DecompilerCacheEntry& entry);
+
+		/*
+		 * Write the outputs of an entry
+		 * @param entry entry
+		 * @return true if all the outputs were written
+		 */
+		static bool WriteOutputs(const DecompilerCacheEntry& entry);
+
+		/*
+		 * Print the cache stats
+		 */
+		void PrintStats() const;
+	};
+}
@@ -150,7 +150,7 @@ namespace {
             return sizeof(tool::gsc::IW23GSCImport);
         }
         size_t GetExportSize() override {
-            return sizeof(tool::gsc::IW23GSCExport);
+            return sizeof(ScriptExport);
         }
         size_t GetStringSize() override {
             return sizeof(tool::gsc::T8GSCString);
@@ -165,7 +165,14 @@ namespace {
             return sizeof(tool::gsc::GSC_ANIMTREE_ITEM);
         }
         void WriteExport(byte* data, const tool::gsc::IW23GSCExport& item) override {
-            *reinterpret_cast<tool::gsc::IW23GSCExport*>(data) = item;
+            // layout read by the acts vm
+            ScriptExport* exp{ reinterpret_cast<ScriptExport*>(data) };
+            exp->address = item.address;
+            exp->name = (uint32_t)item.name;
+            exp->name_space = (uint32_t)item.name_space;
+            exp->export_data = (uint32_t)item.file_name_space;
+            exp->param_count = item.param_count;
+            exp->flags = item.flags;
         }
         void WriteImport(byte* data, const tool::gsc::IW23GSCImport& item) override {
             *reinterpret_cast<tool::gsc::IW23GSCImport*>(data) = item;
@@ -195,6 +202,18 @@ namespace {
             }
             return "acts/default.gsc";
         }
+        byte RemapFlagsExport(byte flags) override {
+            byte nflags{};
+            if (flags & SEF_AUTOEXEC) nflags |= AUTOEXEC;
+            if (flags & SEF_PRIVATE) nflags |= PRIVATE;
+            return nflags;
+        }
+        byte MapFlagsExportToInt(byte flags) override {
+            byte nflags{};
+            if (flags & AUTOEXEC) nflags |= SEF_AUTOEXEC;
+            if (flags & PRIVATE) nflags |= SEF_PRIVATE;
+            return nflags;
+        }
         bool IsVTableImportFlags(byte flags) override {
             return false;
         }
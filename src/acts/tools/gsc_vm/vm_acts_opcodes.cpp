@@ -14,8 +14,10 @@ namespace {
 		af1->RegisterOpCode(PLATFORM_PC, OPCODE_CheckClearParams, acts::vm::opcodes::OPCODE_EXPORT_NO_PARAMS);
 		af1->RegisterOpCode(PLATFORM_PC, OPCODE_End, acts::vm::opcodes::OPCODE_END);
 		af1->RegisterOpCode(PLATFORM_PC, OPCODE_SafeCreateLocalVariables, acts::vm::opcodes::OPCODE_EXPORT_PARAMS);
+		af1->RegisterOpCode(PLATFORM_PC, OPCODE_Wait, acts::vm::opcodes::OPCODE_WAIT);
+		af1->RegisterOpCode(PLATFORM_PC, OPCODE_WaitFrame, acts::vm::opcodes::OPCODE_WAIT_FRAME);
 		af1->RegisterOpCode(PLATFORM_PC, OPCODE_GetFloat, acts::vm::opcodes::OPCODE_GET_FLOAT);
-		af1->RegisterOpCode(PLATFORM_PC, OPCODE_GetInteger, acts::vm::opcodes::OPCODE_GET_INT);
+		af1->RegisterOpCode(PLATFORM_PC, OPCODE_GetLongInteger, acts::vm::opcodes::OPCODE_GET_INT);
 		af1->RegisterOpCode(PLATFORM_PC, OPCODE_GetHash, acts::vm::opcodes::OPCODE_GET_HASH);
 		af1->RegisterOpCode(PLATFORM_PC, OPCODE_GetUndefined, acts::vm::opcodes::OPCODE_GET_UNDEFINED);
 		af1->RegisterOpCode(PLATFORM_PC, OPCODE_IsDefined, acts::vm::opcodes::OPCODE_IS_DEFINED);
@@ -0,0 +1,1018 @@
+#include <includes.hpp>
+#include <unit_test.hpp>
+#include <core/memory_allocator_static.hpp>
+#include <acts_vm.hpp>
+#include <acts_vm_registry.hpp>
+#ifdef ACTS_VM_PROFILER
+#include <actslib/profiler.hpp>
+#endif
+
+// Acts VM tests and benchmarks
+
+namespace {
+    using namespace acts::vm;
+
+    // deterministic random generator, the same operations are done in all the runs
+    struct XorShift {
+        uint64_t state{ 0x2545F4914F6CDD1D };
+
+        uint64_t Next() {
+            state ^= state << 13;
+            state ^= state >> 7;
+            state ^= state << 17;
+            return state;
+        }
+    };
+
+    /*
+     * Allocate and free the VM heap objects with the pattern of array heavy scripts, the arrays are filled and released
+     * @param alloc allocator
+     * @param ops number of operations
+     * @return number of live blocks at the end
+     */
+    template<typename Allocator>
+    size_t VmHeapChurn(Allocator& alloc, size_t ops) {
+        // linked array node, used before the hash arrays
+        struct ArrayNode {
+            VmVar idx;
+            VmVar var;
+            VmRef next;
+        };
+        constexpr size_t nodeSize = sizeof(ArrayNode);
+        constexpr size_t sizes[]{ sizeof(VmArray), nodeSize, nodeSize, nodeSize, sizeof(VmVector) };
+        // small enough to fit in the static allocator
+        constexpr size_t maxLive = 0x400;
+        std::vector<VmRef> live{};
+        live.reserve(maxLive);
+        XorShift rnd{};
+
+        for (size_t i = 0; i < ops; i++) {
+            uint64_t r{ rnd.Next() };
+
+            if (live.size() < maxLive && (live.empty() || (r & 3))) {
+                live.push_back(alloc.AllocRef(sizes[(r >> 8) % ARRAYSIZE(sizes)]));
+            }
+            else {
+                // release a random object, the heap is fragmented
+                size_t idx{ (size_t)((r >> 16) % live.size()) };
+                alloc.FreeRef(live[idx]);
+                live[idx] = live.back();
+                live.pop_back();
+            }
+        }
+
+        size_t count{ live.size() };
+        for (VmRef ref : live) {
+            alloc.FreeRef(ref);
+        }
+        return count;
+    }
+
+    void actsvmheapslabbench(acts::unit_test::BenchmarkContext& ctx) {
+        constexpr size_t ops = 100000;
+        core::memory_allocator::MemoryAllocatorSlab<VmRef> alloc{};
+        ctx.Measure(ops, [&alloc] { return VmHeapChurn(alloc, ops) != 0; });
+    }
+
+    void actsvmheapstaticbench(acts::unit_test::BenchmarkContext& ctx) {
+        constexpr size_t ops = 100000;
+        // allocator used before the slab allocator, 0x20000 bytes
+        auto alloc{ std::make_unique<core::memory_allocator::MemoryAllocatorStatic<0x20000, VmRef>>() };
+        ctx.Measure(ops, [&alloc] { return VmHeapChurn(*alloc, ops) != 0; });
+    }
+
+    void actsvmheaptest() {
+        core::memory_allocator::MemoryAllocatorSlab<VmRef> alloc{};
+
+        VmRef a{ alloc.AllocRef(sizeof(VmVector)) };
+        VmRef b{ alloc.AllocRef(sizeof(VmVector)) };
+        VmRef c{ alloc.AllocRef(sizeof(VmVector)) };
+        ASSERT_VAL("non null refs", a && b && c);
+        ASSERT_VAL("distinct refs", a != b && b != c && a != c);
+        ASSERT_EQ("ref by data", a, alloc.RefByData(alloc.DataByRef(a)));
+
+        alloc.FreeRef(b);
+        ASSERT_EQ("reused block", b, alloc.AllocRef(sizeof(VmVector)));
+
+        // more than one page
+        std::vector<VmRef> refs{};
+        for (size_t i = 0; i < 0x10000; i++) {
+            refs.push_back(alloc.AllocRef(sizeof(VmVector)));
+            *(uint64_t*)alloc.DataByRef(refs.back()) = i;
+        }
+        bool valid{ true };
+        for (size_t i = 0; i < refs.size(); i++) {
+            if (*(uint64_t*)alloc.DataByRef(refs[i]) != i) valid = false;
+            alloc.FreeRef(refs[i]);
+        }
+        ASSERT_VAL("data after grow", valid);
+        ASSERT_VAL("grown heap", alloc.GetStats().pages > 1);
+        ASSERT_EQ("live blocks", (size_t)3, alloc.GetStats().liveBlocks);
+    }
+
+    VmVar ArrayKey(size_t i, size_t count) {
+        // the first half is using integer keys, the second half hash keys like a lookup table
+        VmVar key{};
+        if (i < count / 2) {
+            key.SetInteger((int64_t)i);
+        }
+        else {
+            key.SetHash(hash::Hash64(utils::va("key_%lld", (long long)i)));
+        }
+        return key;
+    }
+
+    VmVar CreateArrayVar(ActsVm& vm) {
+        VmVar arr{};
+        arr.SetRef(VT_ARRAY, vm.CreateArray());
+        vm.IncRef(&arr);
+        return arr;
+    }
+
+    void BuildArray(ActsVm& vm, VmVar& arr, const std::vector<VmVar>& keys) {
+        for (size_t i = 0; i < keys.size(); i++) {
+            VmVar key{ keys[i] };
+            VmVar val{};
+            val.SetInteger((int64_t)i);
+            vm.ArraySet(&arr, &key, &val);
+        }
+    }
+
+    std::vector<VmVar> ArrayKeys(size_t count) {
+        std::vector<VmVar> keys{};
+        keys.reserve(count);
+        for (size_t i = 0; i < count; i++) {
+            keys.push_back(ArrayKey(i, count));
+        }
+        return keys;
+    }
+
+    template<size_t Count>
+    void actsvmarraybuildbench(acts::unit_test::BenchmarkContext& ctx) {
+        auto vm{ std::make_unique<ActsVm>(ActsVmConfig{}) };
+        std::vector<VmVar> keys{ ArrayKeys(Count) };
+
+        ctx.Measure(Count, [&vm, &keys] {
+            VmVar arr{ CreateArrayVar(*vm) };
+            BuildArray(*vm, arr, keys);
+            bool ok{ vm->ArraySize(&arr) == Count };
+            vm->ReleaseVariable(&arr);
+            vm->ReleasePending();
+            return ok;
+        });
+    }
+
+    template<size_t Count>
+    void actsvmarraylookupbench(acts::unit_test::BenchmarkContext& ctx) {
+        auto vm{ std::make_unique<ActsVm>(ActsVmConfig{}) };
+        std::vector<VmVar> keys{ ArrayKeys(Count) };
+        VmVar arr{ CreateArrayVar(*vm) };
+        BuildArray(*vm, arr, keys);
+
+        // same number of lookups for all the sizes
+        constexpr size_t lookups = 100000;
+        ctx.Measure(lookups, [&vm, &keys, &arr] {
+            XorShift rnd{};
+            int64_t sum{};
+            for (size_t i = 0; i < lookups; i++) {
+                VmVar* v{ vm->ArrayGet(&arr, &keys[rnd.Next() % keys.size()]) };
+                if (!v) return false;
+                sum += v->GetInteger();
+            }
+            return sum >= 0;
+        });
+        vm->ReleaseVariable(&arr);
+    }
+
+    template<size_t Count>
+    void actsvmarrayiteratebench(acts::unit_test::BenchmarkContext& ctx) {
+        auto vm{ std::make_unique<ActsVm>(ActsVmConfig{}) };
+        VmVar arr{ CreateArrayVar(*vm) };
+        BuildArray(*vm, arr, ArrayKeys(Count));
+
+        ctx.Measure(Count, [&vm, &arr] {
+            // foreach (k, v in arr)
+            size_t count{};
+            VmArrayCursor cursor;
+            VmVar key;
+            for (bool ok{ vm->ArrayFirstKey(&arr, &cursor, &key) }; ok; ok = vm->ArrayNextKey(&arr, &cursor, &key)) {
+                if (!vm->ArrayGet(&arr, &key)) return false;
+                count++;
+            }
+            return count == Count;
+        });
+        vm->ReleaseVariable(&arr);
+    }
+
+    void actsvmarraytest() {
+        auto vm{ std::make_unique<ActsVm>(ActsVmConfig{}) };
+        constexpr size_t count = 1000;
+        std::vector<VmVar> keys{ ArrayKeys(count) };
+        VmVar arr{ CreateArrayVar(*vm) };
+        BuildArray(*vm, arr, keys);
+
+        ASSERT_EQ("size", count, vm->ArraySize(&arr));
+        bool valid{ true };
+        for (size_t i = 0; i < count; i++) {
+            VmVar* v{ vm->ArrayGet(&arr, &keys[i]) };
+            if (!v || !v->IsInteger() || v->GetInteger() != (int64_t)i) valid = false;
+        }
+        ASSERT_VAL("lookup", valid);
+        VmVar missing{};
+        missing.SetHash(hash::Hash64("missing"));
+        ASSERT_VAL("missing key", !vm->ArrayGet(&arr, &missing));
+
+        // remove the even keys by setting undefined
+        for (size_t i = 0; i < count; i += 2) {
+            VmVar undef{};
+            vm->ArraySet(&arr, &keys[i], &undef);
+        }
+        ASSERT_EQ("size after remove", count / 2, vm->ArraySize(&arr));
+
+        // nested array, released with its parent
+        VmVar sub{ CreateArrayVar(*vm) };
+        VmVar subKey{ keys[0] };
+        vm->ArraySet(&arr, &subKey, &sub);
+        ASSERT_VAL("moved value", sub.IsUndefined());
+
+        // insertion order
+        std::vector<size_t> order{};
+        VmArrayCursor cursor;
+        VmVar key;
+        for (bool ok{ vm->ArrayFirstKey(&arr, &cursor, &key) }; ok; ok = vm->ArrayNextKey(&arr, &cursor, &key)) {
+            VmVar* v{ vm->ArrayGet(&arr, &key) };
+            order.push_back(v->IsInteger() ? (size_t)v->GetInteger() : count);
+        }
+        bool ordered{ order.size() == count / 2 + 1 && order.back() == count };
+        for (size_t i = 0; ordered && i < count / 2; i++) {
+            ordered = order[i] == i * 2 + 1;
+        }
+        ASSERT_VAL("insertion order", ordered);
+
+        // foreach removing the current key, the removes are compacting the entries
+        VmVar arr2{ CreateArrayVar(*vm) };
+        BuildArray(*vm, arr2, keys);
+        size_t visited{};
+        for (bool ok{ vm->ArrayFirstKey(&arr2, &cursor, &key) }; ok; ok = vm->ArrayNextKey(&arr2, &cursor, &key)) {
+            VmVar* v{ vm->ArrayGet(&arr2, &key) };
+            if (!v || v->GetInteger() != (int64_t)visited) break;
+            visited++;
+            VmVar undef{};
+            vm->ArraySet(&arr2, &key, &undef);
+        }
+        ASSERT_EQ("foreach remove", count, visited);
+        ASSERT_EQ("size after foreach remove", (size_t)0, vm->ArraySize(&arr2));
+        vm->ReleaseVariable(&arr2);
+        vm->ReleasePending();
+
+        vm->ReleaseVariable(&arr);
+        ASSERT_EQ("pending release", (size_t)1, vm->GetReleaseStats().pending);
+        vm->ReleasePending();
+        ASSERT_EQ("released arrays", (size_t)0, vm->GetAllocStats().liveBlocks);
+    }
+
+    void actsvmreleasetest() {
+        ActsVmConfig cfg{};
+        cfg.releaseFrameBudget = 0x1000;
+        auto vm{ std::make_unique<ActsVm>(cfg) };
+
+        // big array with nested arrays
+        constexpr size_t count = 100000;
+        constexpr size_t nested = 10;
+        constexpr size_t nestedCount = 1000;
+        VmVar arr{ CreateArrayVar(*vm) };
+        BuildArray(*vm, arr, ArrayKeys(count));
+        std::vector<VmVar> nestedKeys{ ArrayKeys(nestedCount) };
+        for (size_t i = 0; i < nested; i++) {
+            VmVar sub{ CreateArrayVar(*vm) };
+            BuildArray(*vm, sub, nestedKeys);
+            VmVar key{};
+            key.SetInteger((int64_t)(count + i));
+            vm->ArraySet(&arr, &key, &sub);
+        }
+
+        vm->ReleaseVariable(&arr);
+        ASSERT_EQ("release deferred", (size_t)nested + 1, vm->GetAllocStats().liveBlocks);
+
+        // the release is split between the frames
+        utils::Timestamp t{ 10000 };
+        size_t frames{};
+        bool bounded{ true };
+        while (vm->GetReleaseStats().pending) {
+            vm->RunFrame(t += 16);
+            bounded &= vm->GetReleaseStats().lastFrame <= cfg.releaseFrameBudget;
+            frames++;
+        }
+        constexpr size_t values = count + nested + nested * nestedCount + nested + 1;
+        ASSERT_VAL("bounded frame release", bounded);
+        ASSERT_EQ("released values", values, vm->GetReleaseStats().released);
+        ASSERT_EQ("release frames", (values + cfg.releaseFrameBudget - 1) / cfg.releaseFrameBudget, frames);
+        ASSERT_EQ("released arrays", (size_t)0, vm->GetAllocStats().liveBlocks);
+
+        // churn without frames, the allocations are freeing the pending releases
+        std::vector<VmVar> churnKeys{ ArrayKeys(64) };
+        size_t peakBlocks{};
+        for (size_t i = 0; i < 10000; i++) {
+            VmVar churn{ CreateArrayVar(*vm) };
+            for (VmVar& key : churnKeys) {
+                VmVar sub{ CreateArrayVar(*vm) };
+                VmVar k{ key };
+                vm->ArraySet(&churn, &k, &sub);
+            }
+            vm->ReleaseVariable(&churn);
+            peakBlocks = std::max(peakBlocks, vm->GetAllocStats().liveBlocks);
+        }
+        ASSERT_VAL("bounded heap", peakBlocks < churnKeys.size() * 4);
+        vm->ReleasePending();
+        ASSERT_EQ("released churn", (size_t)0, vm->GetAllocStats().liveBlocks);
+
+        // arrays still referenced or pending when the vm is deleted, their data is freed by the vm
+        VmVar kept{ CreateArrayVar(*vm) };
+        BuildArray(*vm, kept, nestedKeys);
+        VmVar sub{ CreateArrayVar(*vm) };
+        VmVar subKey{ nestedKeys[0] };
+        vm->ArraySet(&kept, &subKey, &sub);
+        VmVar pending{ CreateArrayVar(*vm) };
+        BuildArray(*vm, pending, nestedKeys);
+        vm->ReleaseVariable(&pending);
+        vm.reset();
+    }
+
+    // script built without the compiler, with one autoexec export if no export is added
+    class TestScriptBuilder {
+        std::vector<byte> code{};
+        std::vector<ScriptExport> exports{};
+        std::vector<uint64_t> includes{};
+
+    public:
+        void Include(uint64_t name) {
+            includes.push_back(name);
+        }
+
+        // start an export at the current location
+        void Export(uint32_t name, byte flags = 0) {
+            ScriptExport& exp{ exports.emplace_back() };
+            exp.name = name;
+            exp.address = (uint32_t)code.size();
+            exp.flags = flags;
+        }
+
+        void Op(opcodes::OpCodeId op) {
+            code.push_back(op);
+        }
+
+        template<typename T>
+        void Op(opcodes::OpCodeId op, T val) {
+            code.push_back(op);
+            utils::Aligned<T>(code);
+            utils::WriteValue<T>(code, val);
+        }
+
+        // write a jump, returns the location to patch with Label
+        size_t Jump(opcodes::OpCodeId op) {
+            code.push_back(op);
+            utils::Aligned<int16_t>(code);
+            return utils::WriteValue<int16_t>(code, 0);
+        }
+
+        void Label(size_t jump) {
+            *(int16_t*)&code[jump] = (int16_t)(code.size() - (jump + sizeof(int16_t)));
+        }
+
+        size_t Here() const {
+            return code.size();
+        }
+
+        void JumpBack(opcodes::OpCodeId op, size_t label) {
+            size_t jump{ Jump(op) };
+            *(int16_t*)&code[jump] = (int16_t)((int64_t)label - (int64_t)(jump + sizeof(int16_t)));
+        }
+
+        void Invalid() {
+            code.push_back(0xFF);
+        }
+
+        // the script is stored in uint64 to align the code like in a loaded script
+        std::vector<uint64_t> Build(uint64_t name) const {
+            std::vector<byte> data{};
+            data.resize(sizeof(ActScript));
+            utils::Aligned<uint64_t>(data);
+
+            size_t includesTable{ data.size() };
+            data.resize(data.size() + sizeof(uint64_t) * includes.size());
+            if (!includes.empty()) {
+                std::memcpy(&data[includesTable], includes.data(), sizeof(uint64_t) * includes.size());
+            }
+
+            std::vector<ScriptExport> exps{ exports };
+            if (exps.empty()) {
+                ScriptExport& exp{ exps.emplace_back() };
+                exp.name = (uint32_t)name;
+                exp.flags = SEF_AUTOEXEC;
+            }
+
+            size_t exportsTable{ data.size() };
+            data.resize(data.size() + sizeof(ScriptExport) * exps.size());
+            utils::Aligned<uint64_t>(data);
+
+            size_t cseg{ data.size() };
+            for (ScriptExport& exp : exps) {
+                exp.address += (uint32_t)cseg;
+            }
+            std::memcpy(&data[exportsTable], exps.data(), sizeof(ScriptExport) * exps.size());
+            data.insert(data.end(), code.begin(), code.end());
+
+            ActScript* header{ (ActScript*)data.data() };
+            *(uint64_t*)header->magic = ACTSCRIPT_MAGIC;
+            header->name = name;
+            header->fileSize = (uint32_t)data.size();
+            header->includes_table = (uint32_t)includesTable;
+            header->includes_count = (uint16_t)includes.size();
+            header->exports_table = (uint32_t)exportsTable;
+            header->exports_count = (uint16_t)exps.size();
+            header->cseg_offset = (uint32_t)cseg;
+            header->cseg_size = (uint32_t)code.size();
+
+            std::vector<uint64_t> script((data.size() + sizeof(uint64_t) - 1) / sizeof(uint64_t));
+            std::memcpy(script.data(), data.data(), data.size());
+            return script;
+        }
+    };
+
+    std::unique_ptr<ActsVm> CreateScriptVm(std::vector<uint64_t>& script, bool predecode) {
+        ActsVmConfig cfg{};
+        cfg.getterFunction = [&script](uint64_t name) -> ActScript* {
+            ActScript* s{ (ActScript*)script.data() };
+            return s->name == name ? s : nullptr;
+        };
+        cfg.hashToString = [](uint64_t hash) -> const char* { return utils::va("%llx", hash); };
+        cfg.predecode = predecode;
+        return std::make_unique<ActsVm>(cfg);
+    }
+
+    /*
+     * Load a test script and run its autoexec
+     * @param builder script
+     * @param predecode use the predecoded code
+     * @param predecoded set if the export was predecoded
+     * @return false if the script was terminated by an error
+     */
+    bool RunTestScript(const TestScriptBuilder& builder, bool predecode, bool& predecoded) {
+        std::vector<uint64_t> script{ builder.Build(0x1234) };
+        auto vm{ CreateScriptVm(script, predecode) };
+        ActScript* s{ (ActScript*)script.data() };
+
+        try {
+            vm->LoadScript(0x1234);
+        }
+        catch (std::runtime_error&) {
+            predecoded = vm->IsPredecoded(s->magic + s->cseg_offset);
+            return false;
+        }
+        predecoded = vm->IsPredecoded(s->magic + s->cseg_offset);
+        return true;
+    }
+
+    // blocks of common instructions, the stack is balanced after each block
+    TestScriptBuilder ExecBenchScript(size_t blocks) {
+        using namespace opcodes;
+        TestScriptBuilder b{};
+        b.Op(OPCODE_EXPORT_NO_PARAMS);
+        for (size_t i = 0; i < blocks; i++) {
+            b.Op<int64_t>(OPCODE_GET_INT, (int64_t)i);
+            b.Op(OPCODE_DEC_TOP);
+            b.Op<uint64_t>(OPCODE_GET_HASH, hash::Hash64("var"));
+            b.Op(OPCODE_IS_DEFINED);
+            b.Label(b.Jump(OPCODE_JUMP_IF_FALSE));
+            b.Op<float>(OPCODE_GET_FLOAT, 1.5f);
+            b.Label(b.Jump(OPCODE_JUMP_IF_DEFINED));
+            b.Op(OPCODE_DEC_TOP);
+            b.Op<int64_t>(OPCODE_GET_INT, 1);
+            b.Label(b.Jump(OPCODE_JUMP_IF_TRUE));
+            b.Op(OPCODE_NOP);
+        }
+        b.Op(OPCODE_END);
+        return b;
+    }
+
+    template<bool Predecode>
+    void actsvmexecbench(acts::unit_test::BenchmarkContext& ctx) {
+        constexpr size_t blocks = 1000;
+        // raw instructions per block
+        constexpr size_t blockInstructions = 11;
+        std::vector<uint64_t> script{ ExecBenchScript(blocks).Build(0x1234) };
+        auto vm{ CreateScriptVm(script, Predecode) };
+        vm->LoadScript(0x1234);
+
+        ActScript* s{ (ActScript*)script.data() };
+        byte* exp{ s->magic + s->cseg_offset };
+        ctx.Measure(blocks * blockInstructions, [&vm, exp] {
+            vm->RunThread(exp);
+            return true;
+        });
+    }
+
+    void actsvmpredecodetest() {
+        using namespace opcodes;
+        bool predecoded;
+
+        // the jumps are skipping the invalid opcode
+        TestScriptBuilder jumps{};
+        jumps.Op(OPCODE_EXPORT_NO_PARAMS);
+        jumps.Op<int64_t>(OPCODE_GET_INT, 3);
+        size_t j1{ jumps.Jump(OPCODE_JUMP_IF_FALSE) };
+        jumps.Op<uint64_t>(OPCODE_GET_HASH, 0x42);
+        jumps.Op(OPCODE_IS_DEFINED);
+        size_t j2{ jumps.Jump(OPCODE_JUMP_IF_FALSE) };
+        jumps.Op<float>(OPCODE_GET_FLOAT, 2.0f);
+        size_t j3{ jumps.Jump(OPCODE_JUMP_IF_TRUE_EXPR) };
+        size_t j4{ jumps.Jump(OPCODE_JUMP) };
+        jumps.Label(j3);
+        jumps.Op(OPCODE_DEC_TOP);
+        jumps.Op(OPCODE_END);
+        jumps.Label(j1);
+        jumps.Label(j2);
+        jumps.Label(j4);
+        jumps.Invalid();
+
+        ASSERT_VAL("raw jumps", RunTestScript(jumps, false, predecoded));
+        ASSERT_VAL("raw not predecoded", !predecoded);
+        ASSERT_VAL("predecoded jumps", RunTestScript(jumps, true, predecoded));
+        ASSERT_VAL("predecoded", predecoded);
+
+        // a constant false condition is reaching the invalid opcode
+        TestScriptBuilder invalid{};
+        invalid.Op(OPCODE_EXPORT_NO_PARAMS);
+        invalid.Op<int64_t>(OPCODE_GET_INT, 0);
+        size_t j5{ invalid.Jump(OPCODE_JUMP_IF_FALSE) };
+        invalid.Op(OPCODE_END);
+        invalid.Label(j5);
+        invalid.Invalid();
+
+        ASSERT_VAL("raw invalid", !RunTestScript(invalid, false, predecoded));
+        ASSERT_VAL("predecoded invalid", !RunTestScript(invalid, true, predecoded));
+        ASSERT_VAL("predecoded with invalid", predecoded);
+
+        // a jump after an invalid opcode can't be predecoded, the raw bytecode is used
+        TestScriptBuilder fallback{};
+        fallback.Op(OPCODE_EXPORT_NO_PARAMS);
+        fallback.Op<int64_t>(OPCODE_GET_INT, 1);
+        size_t j6{ fallback.Jump(OPCODE_JUMP_IF_TRUE) };
+        fallback.Invalid();
+        fallback.Op(OPCODE_DEC_TOP);
+        fallback.Label(j6);
+        fallback.Op(OPCODE_END);
+
+        ASSERT_VAL("fallback", RunTestScript(fallback, true, predecoded));
+        ASSERT_VAL("fallback not predecoded", !predecoded);
+
+        // same instructions in both modes
+        ASSERT_VAL("raw bench script", RunTestScript(ExecBenchScript(10), false, predecoded));
+        ASSERT_VAL("predecoded bench script", RunTestScript(ExecBenchScript(10), true, predecoded) && predecoded);
+    }
+
+    void actsvmschedbench(acts::unit_test::BenchmarkContext& ctx) {
+        using namespace opcodes;
+        TestScriptBuilder b{};
+        b.Export(1);
+        b.Op(OPCODE_EXPORT_NO_PARAMS);
+        b.Op<int64_t>(OPCODE_GET_INT, 10000);
+        b.Op(OPCODE_WAIT);
+        b.Op(OPCODE_END);
+        b.Export(2);
+        b.Op(OPCODE_EXPORT_NO_PARAMS);
+        size_t loop{ b.Here() };
+        b.Op<int64_t>(OPCODE_GET_INT, 1);
+        b.Op(OPCODE_WAIT_FRAME);
+        b.JumpBack(OPCODE_JUMP, loop);
+
+        std::vector<uint64_t> script{ b.Build(0x1234) };
+        auto vm{ CreateScriptVm(script, true) };
+        vm->LoadScript(0x1234);
+        ActScript* s{ (ActScript*)script.data() };
+
+        // most of the threads are waiting, only the frame loops are runnable
+        constexpr size_t idle = 200;
+        constexpr size_t runnable = 32;
+        for (size_t i = 0; i < idle; i++) {
+            vm->StartThread(s->magic + s->Exports()[0].address);
+        }
+        for (size_t i = 0; i < runnable; i++) {
+            vm->StartThread(s->magic + s->Exports()[1].address);
+        }
+        utils::Timestamp now{ 1000 };
+        vm->RunFrame(now);
+
+        constexpr size_t frames = 1000;
+        ctx.Measure(frames, [&vm, &now] {
+            for (size_t i = 0; i < frames; i++) {
+                vm->RunFrame(now += 16);
+            }
+            return vm->GetThreadsCount() == idle + runnable;
+        });
+    }
+
+    void actsvmschedtest() {
+        using namespace opcodes;
+
+        TestScriptBuilder b{};
+        b.Export(1, SEF_AUTOEXEC);
+        b.Op(OPCODE_EXPORT_NO_PARAMS);
+        b.Op<int64_t>(OPCODE_GET_INT, 2);
+        b.Op(OPCODE_WAIT_FRAME);
+        b.Op<float>(OPCODE_GET_FLOAT, 0.5f);
+        b.Op(OPCODE_WAIT);
+        b.Op(OPCODE_END);
+        // deep stack, the stack is grown
+        b.Export(2);
+        b.Op(OPCODE_EXPORT_NO_PARAMS);
+        for (size_t i = 0; i < 0x100; i++) {
+            b.Op<int64_t>(OPCODE_GET_INT, (int64_t)i);
+        }
+        b.Op<int64_t>(OPCODE_GET_INT, 0);
+        b.Op(OPCODE_WAIT);
+        for (size_t i = 0; i < 0x100; i++) {
+            b.Op(OPCODE_DEC_TOP);
+        }
+        b.Op(OPCODE_END);
+
+        for (bool predecode : { false, true }) {
+            std::vector<uint64_t> script{ b.Build(0x1234) };
+            auto vm{ CreateScriptVm(script, predecode) };
+            ActScript* s{ (ActScript*)script.data() };
+
+            vm->LoadScript(0x1234);
+            ASSERT_EQ("autoexec waiting", (size_t)1, vm->GetThreadsCount());
+
+            VmExecutionThread* deep{ vm->StartThread(s->magic + s->Exports()[1].address) };
+            ASSERT_EQ("started thread", (size_t)2, vm->GetThreadsCount());
+
+            utils::Timestamp t{ 10000 };
+            vm->RunFrame(t);
+            ASSERT_EQ("deep stack", (size_t)0x100, (size_t)(deep->top - deep->stack.get() - 1));
+            vm->RunFrame(t);
+            // the autoexec waitframe ended in the same frame
+            ASSERT_EQ("deep thread ended", (size_t)1, vm->GetThreadsCount());
+            vm->RunFrame(t += 499);
+            ASSERT_EQ("wait not ended", (size_t)1, vm->GetThreadsCount());
+            vm->RunFrame(t += 1);
+            ASSERT_EQ("wait ended", (size_t)0, vm->GetThreadsCount());
+        }
+    }
+
+    void actsvmvartest() {
+        using namespace opcodes;
+
+        VmVar v{};
+        ASSERT_VAL("default undefined", v.IsUndefined() && v.GetType() == VT_UNDEFINED);
+        v.SetInteger(-42);
+        ASSERT_VAL("negative integer", v.IsInteger() && v.GetType() == VT_INTEGER && v.GetInteger() == -42);
+        v.SetInteger(0x1FFFFFFFFFFFFFFF);
+        ASSERT_VAL("large integer", v.IsInteger() && v.GetInteger() == 0x1FFFFFFFFFFFFFFF);
+        v.SetInteger(VmVar::INTEGER_MIN);
+        ASSERT_VAL("min integer", v.IsInteger() && v.GetInteger() == VmVar::INTEGER_MIN);
+        ASSERT_VAL("integer range", VmVar::IsValidInteger(VmVar::INTEGER_MAX) && VmVar::IsValidInteger(VmVar::INTEGER_MIN));
+        v.SetHash(hash::Hash64("acts_vm_var"));
+        ASSERT_VAL("hash", v.IsHash() && v.GetType() == VT_HASH && v.GetHash() == hash::Hash64("acts_vm_var"));
+        v.SetFloat(-1.5f);
+        ASSERT_VAL("float", v.IsFloat() && v.GetType() == VT_FLOAT && v.GetFloat() == -1.5f);
+        v.SetRef(VT_ARRAY, 0x1234);
+        ASSERT_VAL("ref", v.GetType() == VT_ARRAY && v.GetRef() == 0x1234);
+        v.SetRef(VT_PRECALL, 0);
+        ASSERT_VAL("precall", v.GetType() == VT_PRECALL && !v.IsUndefined());
+        v.SetUndefined();
+        ASSERT_VAL("undefined", v.IsUndefined());
+
+        TestScriptBuilder b{};
+        b.Export(1);
+        b.Op(OPCODE_EXPORT_NO_PARAMS);
+        // ((7 + -3) * 5 * 0.5) - 2
+        b.Op<int64_t>(OPCODE_GET_INT, 7);
+        b.Op<int64_t>(OPCODE_GET_INT, -3);
+        b.Op(OPCODE_OP_PLUS);
+        b.Op<int64_t>(OPCODE_GET_INT, 5);
+        b.Op(OPCODE_OP_MULTIPLY);
+        b.Op<float>(OPCODE_GET_FLOAT, 0.5f);
+        b.Op(OPCODE_OP_MULTIPLY);
+        b.Op<int64_t>(OPCODE_GET_INT, 2);
+        b.Op(OPCODE_OP_MINUS);
+        // invalid operands, the result is undefined
+        b.Op<uint64_t>(OPCODE_GET_HASH, 0x10);
+        b.Op<int64_t>(OPCODE_GET_INT, 1);
+        b.Op(OPCODE_OP_PLUS);
+        // wait to read the results
+        b.Op<int64_t>(OPCODE_GET_INT, 1);
+        b.Op(OPCODE_WAIT_FRAME);
+        b.Op(OPCODE_DEC_TOP);
+        b.Op(OPCODE_DEC_TOP);
+        b.Op(OPCODE_END);
+
+        for (bool predecode : { false, true }) {
+            std::vector<uint64_t> script{ b.Build(0x1234) };
+            auto vm{ CreateScriptVm(script, predecode) };
+            ActScript* s{ (ActScript*)script.data() };
+            vm->LoadScript(0x1234);
+
+            VmExecutionThread* thread{ vm->StartThread(s->magic + s->Exports()[0].address) };
+            utils::Timestamp t{ 10000 };
+            vm->RunFrame(t);
+            ASSERT_EQ("stack size", (size_t)2, (size_t)(thread->top - thread->stack.get() - 1));
+            ASSERT_VAL("float result", thread->top[-2].IsFloat() && thread->top[-2].GetFloat() == 8.0f);
+            ASSERT_VAL("invalid operands", thread->top[-1].IsUndefined());
+            vm->RunFrame(t);
+            vm->RunFrame(t);
+            ASSERT_EQ("thread ended", (size_t)0, vm->GetThreadsCount());
+        }
+
+#ifdef ACTS_VM_PACKED_VAR
+        // the integer constants not fitting in a packed var are reported and pushed as undefined
+        ASSERT_VAL("out of range integer", !VmVar::IsValidInteger(VmVar::INTEGER_MAX + 1) && !VmVar::IsValidInteger(VmVar::INTEGER_MIN - 1));
+
+        TestScriptBuilder range{};
+        range.Export(1);
+        range.Op(OPCODE_EXPORT_NO_PARAMS);
+        range.Op<int64_t>(OPCODE_GET_INT, VmVar::INTEGER_MAX + 1);
+        // wait to read the result
+        range.Op<int64_t>(OPCODE_GET_INT, 1);
+        range.Op(OPCODE_WAIT_FRAME);
+        range.Op(OPCODE_DEC_TOP);
+        range.Op(OPCODE_END);
+
+        for (bool predecode : { false, true }) {
+            std::vector<uint64_t> script{ range.Build(0x1234) };
+            auto vm{ CreateScriptVm(script, predecode) };
+            ActScript* s{ (ActScript*)script.data() };
+            vm->LoadScript(0x1234);
+
+            VmExecutionThread* thread{ vm->StartThread(s->magic + s->Exports()[0].address) };
+            utils::Timestamp t{ 10000 };
+            vm->RunFrame(t);
+            ASSERT_EQ("range stack size", (size_t)1, (size_t)(thread->top - thread->stack.get() - 1));
+            ASSERT_VAL("out of range constant", thread->top[-1].IsUndefined());
+            vm->RunFrame(t);
+            vm->RunFrame(t);
+            ASSERT_EQ("range thread ended", (size_t)0, vm->GetThreadsCount());
+        }
+#endif
+    }
+
+    TestScriptBuilder StackBenchScript(size_t blocks) {
+        using namespace opcodes;
+        TestScriptBuilder b{};
+        b.Op(OPCODE_EXPORT_NO_PARAMS);
+        for (size_t i = 0; i < blocks; i++) {
+            for (size_t j = 0; j < 8; j++) {
+                b.Op<int64_t>(OPCODE_GET_INT, (int64_t)j);
+            }
+            for (size_t j = 0; j < 8; j++) {
+                b.Op(OPCODE_DEC_TOP);
+            }
+        }
+        b.Op(OPCODE_END);
+        return b;
+    }
+
+    TestScriptBuilder ArithBenchScript(size_t blocks) {
+        using namespace opcodes;
+        TestScriptBuilder b{};
+        b.Op(OPCODE_EXPORT_NO_PARAMS);
+        for (size_t i = 0; i < blocks; i++) {
+            b.Op<int64_t>(OPCODE_GET_INT, (int64_t)i);
+            b.Op<int64_t>(OPCODE_GET_INT, 3);
+            b.Op(OPCODE_OP_PLUS);
+            b.Op<float>(OPCODE_GET_FLOAT, 1.5f);
+            b.Op(OPCODE_OP_MULTIPLY);
+            b.Op<int64_t>(OPCODE_GET_INT, 2);
+            b.Op(OPCODE_OP_MINUS);
+            b.Op(OPCODE_DEC_TOP);
+        }
+        b.Op(OPCODE_END);
+        return b;
+    }
+
+    /*
+     * Run a predecoded bench script, used to compare the var layouts
+     * @param ctx context
+     * @param builder script
+     * @param instructions instructions per run
+     */
+    void RunVarBench(acts::unit_test::BenchmarkContext& ctx, const TestScriptBuilder& builder, size_t instructions) {
+        std::vector<uint64_t> script{ builder.Build(0x1234) };
+        auto vm{ CreateScriptVm(script, true) };
+        vm->LoadScript(0x1234);
+
+        ActScript* s{ (ActScript*)script.data() };
+        byte* exp{ s->magic + s->cseg_offset };
+        ctx.Measure(instructions, [&vm, exp] {
+            vm->RunThread(exp);
+            return true;
+        });
+    }
+
+    void actsvmvarstackbench(acts::unit_test::BenchmarkContext& ctx) {
+        constexpr size_t blocks = 1000;
+        RunVarBench(ctx, StackBenchScript(blocks), blocks * 16);
+    }
+
+    void actsvmvararithbench(acts::unit_test::BenchmarkContext& ctx) {
+        constexpr size_t blocks = 1000;
+        RunVarBench(ctx, ArithBenchScript(blocks), blocks * 8);
+    }
+
+#ifdef ACTS_VM_PROFILER
+    std::unique_ptr<ActsVm> CreateProfiledVm(std::vector<uint64_t>& script, bool predecode, uint64_t sampleRate) {
+        ActsVmConfig cfg{};
+        cfg.getterFunction = [&script](uint64_t name) -> ActScript* {
+            ActScript* s{ (ActScript*)script.data() };
+            return s->name == name ? s : nullptr;
+        };
+        cfg.hashToString = [](uint64_t hash) -> const char* { return utils::va("%llx", hash); };
+        cfg.predecode = predecode;
+        cfg.profile = true;
+        cfg.profileSampleRate = sampleRate;
+        return std::make_unique<ActsVm>(cfg);
+    }
+
+    void actsvmprofilertest() {
+        using namespace opcodes;
+
+        // shadow stack, a calls b
+        VmProfiler prof{ 4 };
+        byte code[0x10]{};
+        prof.EnterFunction(0, &code[0]);
+        for (size_t i = 0; i < 3; i++) prof.OnInstruction(0, OPCODE_NOP, &code[0]);
+        prof.EnterFunction(0, &code[8]);
+        for (size_t i = 0; i < 2; i++) prof.OnInstruction(0, OPCODE_DEC_TOP, &code[8]);
+        prof.LeaveFunction(0);
+        prof.OnInstruction(0, OPCODE_NOP, &code[1]);
+        prof.OnInstruction(0, VM_PROFILER_NO_OPCODE, &code[2]);
+        prof.LeaveThread(0);
+
+        const VmProfilerFunction& a{ prof.GetFunctions().at(&code[0]) };
+        const VmProfilerFunction& b{ prof.GetFunctions().at(&code[8]) };
+        ASSERT_EQ("instructions", (uint64_t)6, prof.GetInstructions());
+        ASSERT_EQ("nop count", (uint64_t)4, prof.GetOpCodeCount(OPCODE_NOP));
+        ASSERT_VAL("caller counts", a.inclusive == 6 && a.exclusive == 4 && a.calls == 1);
+        ASSERT_VAL("callee counts", b.inclusive == 2 && b.exclusive == 2 && b.calls == 1);
+        // the 4th instruction is in b
+        ASSERT_VAL("code samples", prof.GetCodeSamples().size() == 1 && prof.GetCodeSamples().at(&code[8]) == 1);
+
+        TestScriptBuilder builder{};
+        builder.Op(OPCODE_EXPORT_NO_PARAMS);
+        for (size_t i = 0; i < 100; i++) {
+            builder.Op<int64_t>(OPCODE_GET_INT, (int64_t)i);
+            builder.Op(OPCODE_DEC_TOP);
+        }
+        builder.Op(OPCODE_END);
+        constexpr uint64_t instructions = 202;
+
+        for (bool predecode : { false, true }) {
+            std::vector<uint64_t> script{ builder.Build(0x1234) };
+            auto vm{ CreateProfiledVm(script, predecode, 0x10) };
+            vm->LoadScript(0x1234);
+            ActScript* s{ (ActScript*)script.data() };
+            byte* exp{ s->magic + s->cseg_offset };
+
+            VmProfiler* vmProf{ vm->GetProfiler() };
+            ASSERT_EQ("script instructions", instructions, vmProf->GetInstructions());
+            ASSERT_EQ("getint count", (uint64_t)100, vmProf->GetOpCodeCount(OPCODE_GET_INT));
+            ASSERT_EQ("end count", (uint64_t)1, vmProf->GetOpCodeCount(OPCODE_END));
+            const VmProfilerFunction& func{ vmProf->GetFunctions().at(exp) };
+            ASSERT_VAL("export counts", func.inclusive == instructions && func.exclusive == instructions && func.calls == 1);
+
+            std::stringstream folded{};
+            vmProf->WriteFolded(vm.get(), folded);
+            ASSERT_EQ("folded stacks", std::format("{} {}\n", vm->GetFunctionName(exp), instructions / 0x10), folded.str());
+
+            // written and read with the actslib format
+            actslib::profiler::Profiler hdt{ "acts vm" };
+            vmProf->WriteProfile(vm.get(), hdt);
+            hdt.Stop();
+            std::stringstream hdtData{};
+            hdt.Write(hdtData);
+            actslib::profiler::Profiler read{ hdtData };
+            const std::vector<actslib::profiler::ProfilerSection>& sections{ read.GetMainSection().GetSubSections() };
+            ASSERT_EQ("profile sections", (size_t)3, sections.size());
+            ASSERT_VAL("profile function", sections[1].GetSubSections().size() == 1 && sections[1].GetSubSections()[0].GetMillis() == (long long)instructions);
+        }
+    }
+
+    void actsvmexecprofilebench(acts::unit_test::BenchmarkContext& ctx) {
+        constexpr size_t blocks = 1000;
+        constexpr size_t blockInstructions = 11;
+        std::vector<uint64_t> script{ ExecBenchScript(blocks).Build(0x1234) };
+        auto vm{ CreateProfiledVm(script, true, 0x100) };
+        vm->LoadScript(0x1234);
+
+        ActScript* s{ (ActScript*)script.data() };
+        byte* exp{ s->magic + s->cseg_offset };
+        ctx.Measure(blocks * blockInstructions, [&vm, exp] {
+            vm->RunThread(exp);
+            return true;
+        });
+    }
+#endif
+
+    // scripts including the previous script and random older scripts, the last script is the root
+    std::vector<std::vector<uint64_t>> LinkBenchScripts(size_t count) {
+        using namespace opcodes;
+        XorShift rng{};
+        std::vector<std::vector<uint64_t>> scripts{};
+        scripts.reserve(count);
+
+        for (size_t i = 0; i < count; i++) {
+            TestScriptBuilder b{};
+            if (i) {
+                b.Include(0x1000 + i - 1);
+                for (size_t j = 0; j < 3; j++) {
+                    b.Include(0x1000 + rng.Next() % i);
+                }
+            }
+            for (uint32_t e = 0; e < 4; e++) {
+                b.Export(e + 1);
+                b.Op(OPCODE_EXPORT_NO_PARAMS);
+                b.Op<int64_t>(OPCODE_GET_INT, (int64_t)e);
+                b.Op(OPCODE_DEC_TOP);
+                b.Op(OPCODE_END);
+            }
+            scripts.push_back(b.Build(0x1000 + i));
+        }
+        return scripts;
+    }
+
+    std::unique_ptr<ActsVm> CreateLinkVm(std::vector<std::vector<uint64_t>>& scripts) {
+        ActsVmConfig cfg{};
+        cfg.getterFunction = [&scripts](uint64_t name) -> ActScript* {
+            if (name < 0x1000 || name - 0x1000 >= scripts.size()) {
+                return nullptr;
+            }
+            return (ActScript*)scripts[name - 0x1000].data();
+        };
+        cfg.hashToString = [](uint64_t hash) -> const char* { return utils::va("%llx", hash); };
+        return std::make_unique<ActsVm>(cfg);
+    }
+
+    void actsvmlinktest() {
+        std::vector<std::vector<uint64_t>> scripts{ LinkBenchScripts(100) };
+        auto vm{ CreateLinkVm(scripts) };
+
+        vm->LoadScript(0x1000 + scripts.size() - 1);
+        // already linked by the root
+        vm->LoadScript(0x1010);
+
+        // all the scripts are reachable from the root
+        for (std::vector<uint64_t>& data : scripts) {
+            ActScript* s{ (ActScript*)data.data() };
+            for (size_t i = 0; i < s->exports_count; i++) {
+                ScriptExport* exp{ &s->Exports()[i] };
+                ScriptExport* foundExp{};
+                ActScript* foundScript{};
+                // inside the export, after the first opcode
+                ASSERT_VAL("export found", vm->GetFunctionInfo(s->magic + exp->address + 1, &foundExp, &foundScript));
+                ASSERT_VAL("same export", foundExp == exp && foundScript == s);
+            }
+        }
+
+        ScriptExport* exp{};
+        ASSERT_VAL("outside code", !vm->GetFunctionInfo((byte*)scripts[0].data(), &exp, nullptr));
+    }
+
+    void actsvmlinkbench(acts::unit_test::BenchmarkContext& ctx) {
+        std::vector<std::vector<uint64_t>> scripts{ LinkBenchScripts(1000) };
+
+        ctx.Measure(scripts.size(), [&scripts] {
+            auto vm{ CreateLinkVm(scripts) };
+            vm->LoadScript(0x1000 + scripts.size() - 1);
+            return true;
+        });
+    }
+
+    ADD_TEST(actsvmheap, actsvmheaptest);
+    ADD_TEST(actsvmarray, actsvmarraytest);
+    ADD_TEST(actsvmpredecode, actsvmpredecodetest);
+    ADD_TEST(actsvmsched, actsvmschedtest);
+    ADD_TEST(actsvmlink, actsvmlinktest);
+    ADD_TEST(actsvmvar, actsvmvartest);
+    ADD_TEST(actsvmrelease, actsvmreleasetest);
+#ifdef ACTS_VM_PROFILER
+    ADD_TEST(actsvmprofiler, actsvmprofilertest);
+    ADD_BENCHMARK(actsvmexecprofile, actsvmexecprofilebench);
+#endif
+    ADD_BENCHMARK(actsvmheapslab, actsvmheapslabbench);
+    ADD_BENCHMARK(actsvmheapstatic, actsvmheapstaticbench);
+    ADD_BENCHMARK(actsvmarraybuild10, actsvmarraybuildbench<10>);
+    ADD_BENCHMARK(actsvmarraybuild1k, actsvmarraybuildbench<1000>);
+    ADD_BENCHMARK(actsvmarraybuild100k, actsvmarraybuildbench<100000>);
+    ADD_BENCHMARK(actsvmarraylookup10, actsvmarraylookupbench<10>);
+    ADD_BENCHMARK(actsvmarraylookup1k, actsvmarraylookupbench<1000>);
+    ADD_BENCHMARK(actsvmarraylookup100k, actsvmarraylookupbench<100000>);
+    ADD_BENCHMARK(actsvmarrayiterate10, actsvmarrayiteratebench<10>);
+    ADD_BENCHMARK(actsvmarrayiterate1k, actsvmarrayiteratebench<1000>);
+    ADD_BENCHMARK(actsvmarrayiterate100k, actsvmarrayiteratebench<100000>);
+    ADD_BENCHMARK(actsvmexecraw, actsvmexecbench<false>);
+    ADD_BENCHMARK(actsvmexecpredecode, actsvmexecbench<true>);
+    ADD_BENCHMARK(actsvmsched, actsvmschedbench);
+    ADD_BENCHMARK(actsvmlink, actsvmlinkbench);
+    ADD_BENCHMARK(actsvmvarstack, actsvmvarstackbench);
+    ADD_BENCHMARK(actsvmvararith, actsvmvararithbench);
+}
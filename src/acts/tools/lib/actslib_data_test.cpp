@@ -0,0 +1,303 @@
+#include <includes.hpp>
+#include <unit_test.hpp>
+#include <actslib/data/iterator.hpp>
+#include <actslib/data/kmerger.hpp>
+
+namespace {
+	using namespace actslib;
+
+	/*
+	 * KMerger config without files, a chunk is only its count of created chunks
+	 */
+	class CountKMergerConfig : public data::KMergerConfig {
+		std::mutex mutex{};
+		size_t created{};
+		size_t merges{};
+	public:
+		const size_t chunks;
+		const size_t mergeWork;
+		const size_t throwAt;
+		std::map<std::filesystem::path, size_t> weights{};
+
+		CountKMergerConfig(size_t chunks, size_t mergeWork = 0, size_t throwAt = 0) : chunks(chunks), mergeWork(mergeWork), throwAt(throwAt) {}
+
+		void CreateDefaultChunk(const std::filesystem::path& chunkLocation) override {
+			std::lock_guard lg{ mutex };
+			weights[chunkLocation] = 0;
+		}
+
+		bool CreateChunk(const std::filesystem::path& chunkLocation) override {
+			std::lock_guard lg{ mutex };
+			if (created == chunks) {
+				return false;
+			}
+			created++;
+			weights[chunkLocation] = 1;
+			return true;
+		}
+
+		void MergeChunks(const std::vector<data::KMergerChunk>& ch, const std::filesystem::path& chunkLocation) override {
+			// fake merge work
+			volatile size_t work{};
+			for (size_t i = 0; i < mergeWork; i++) {
+				work = work + i;
+			}
+
+			std::lock_guard lg{ mutex };
+			if (++merges == throwAt) {
+				throw std::runtime_error(va("merge %lld failed", merges));
+			}
+			size_t weight{};
+			for (const data::KMergerChunk& chunk : ch) {
+				auto it{ weights.find(chunk.file) };
+				if (it == weights.end()) {
+					throw std::runtime_error(va("chunk %s merged twice", chunk.file.string().c_str()));
+				}
+				weight += it->second;
+				weights.erase(it);
+			}
+			weights[chunkLocation] = weight;
+		}
+	};
+
+	void actslibkmergertest() {
+		for (size_t workers : { 1, 4, 16 }) {
+			for (size_t chunks : { 0, 1, 7, 8, 100, 1000 }) {
+				CountKMergerConfig cfg{ chunks };
+				data::KMerger merger{ std::filesystem::temp_directory_path() / "acts_kmerger_test", 8, workers, cfg };
+
+				std::filesystem::path end{ merger.PushAndJoin() };
+
+				// all the chunks were merged into the end chunk
+				ASSERT_EQ("chunks", 1, cfg.weights.size());
+				ASSERT_VAL("end chunk", cfg.weights.contains(end));
+				ASSERT_EQ("merged chunks", chunks, cfg.weights[end]);
+			}
+		}
+
+		// the config exception is thrown by the join
+		for (size_t workers : { 1, 4, 16 }) {
+			CountKMergerConfig cfg{ 1000, 0, 50 };
+			data::KMerger merger{ std::filesystem::temp_directory_path() / "acts_kmerger_test", 8, workers, cfg };
+
+			bool thrown{};
+			try {
+				merger.PushAndJoin();
+			}
+			catch (std::runtime_error& e) {
+				thrown = true;
+				ASSERT_VAL(e.what(), !std::strcmp(e.what(), "merge 50 failed"));
+			}
+			ASSERT_VAL("exception", thrown);
+		}
+	}
+
+	template<size_t Workers>
+	void actslibkmergerbench(acts::unit_test::BenchmarkContext& ctx) {
+		constexpr size_t chunks = 4096;
+		ctx.Measure(chunks, [] {
+			CountKMergerConfig cfg{ chunks, 2000 };
+			data::KMerger merger{ std::filesystem::temp_directory_path() / "acts_kmerger_bench", 4, Workers, cfg };
+			merger.PushAndJoin();
+			return cfg.weights.size() == 1;
+		});
+	}
+
+	struct MergeElem {
+		uint32_t key;
+		uint32_t run;
+		uint32_t pos;
+	};
+
+	class MergeElemComparator {
+	public:
+		static inline bool Compare(const MergeElem& a, const MergeElem& b) {
+			return a.key < b.key;
+		}
+	};
+
+	std::vector<std::vector<MergeElem>> CreateMergeRuns(size_t k, size_t elements, uint32_t keys) {
+		std::mt19937 rand{ (uint32_t)(k * 31 + elements) };
+		std::vector<std::vector<MergeElem>> runs{};
+		runs.resize(k);
+		for (size_t i = 0; i < k; i++) {
+			std::vector<MergeElem>& run{ runs[i] };
+			// some empty runs
+			size_t len{ i % 7 == 3 ? 0 : elements / k + rand() % 8 };
+			for (size_t j = 0; j < len; j++) {
+				run.emplace_back(rand() % keys, (uint32_t)i, (uint32_t)j);
+			}
+			std::stable_sort(run.begin(), run.end(), [](const MergeElem& a, const MergeElem& b) { return a.key < b.key; });
+			for (size_t j = 0; j < len; j++) {
+				run[j].pos = (uint32_t)j;
+			}
+		}
+		return runs;
+	}
+
+	using MergeElemIterator = data::iterator::HandleAIterator<MergeElem, MergeElem*>;
+
+	std::vector<std::shared_ptr<data::iterator::AIterator<MergeElem>>> CreateMergeIterators(std::vector<std::vector<MergeElem>>& runs) {
+		std::vector<std::shared_ptr<data::iterator::AIterator<MergeElem>>> its{};
+		for (std::vector<MergeElem>& run : runs) {
+			its.emplace_back(std::make_shared<MergeElemIterator>(run.data(), run.data() + run.size()));
+		}
+		return its;
+	}
+
+	// balanced tree of MergeIterator pairs, the order to match
+	data::iterator::AIterator<MergeElem>* CreatePairTree(std::vector<std::shared_ptr<data::iterator::AIterator<MergeElem>>>& its) {
+		if (its.empty()) {
+			its.emplace_back(std::make_shared<data::iterator::EmptyAIterator<MergeElem>>());
+		}
+		size_t start{};
+		size_t len{ its.size() };
+		while (len > 1) {
+			for (size_t i = 0; i + 1 < len; i += 2) {
+				its.emplace_back(std::make_shared<data::iterator::MergeIterator<MergeElem, MergeElemComparator>>(*its[start + i], *its[start + i + 1]));
+			}
+			if (len & 1) {
+				its.emplace_back(its[start + len - 1]);
+			}
+			start += len;
+			len = its.size() - start;
+		}
+		return &*its[its.size() - 1];
+	}
+
+	bool SameMergeElem(const MergeElem& a, const MergeElem& b) {
+		return a.key == b.key && a.run == b.run && a.pos == b.pos;
+	}
+
+	void actslibmergetest() {
+		for (size_t k : { 0, 1, 2, 3, 5, 16, 17, 256 }) {
+			for (uint32_t keys : { 4, 1000 }) {
+				std::vector<std::vector<MergeElem>> runs{ CreateMergeRuns(k, k * 20, keys) };
+
+				std::vector<MergeElem> expected{};
+				{
+					std::vector<std::shared_ptr<data::iterator::AIterator<MergeElem>>> its{ CreateMergeIterators(runs) };
+					data::iterator::AIterator<MergeElem>& tree{ *CreatePairTree(its) };
+					for (; tree; ++tree) {
+						expected.push_back(*tree);
+					}
+				}
+
+				// loser tree with final runs
+				{
+					std::vector<std::shared_ptr<data::iterator::AIterator<MergeElem>>> its{ CreateMergeIterators(runs) };
+					std::vector<MergeElemIterator*> ptrs{};
+					for (auto& it : its) {
+						ptrs.push_back((MergeElemIterator*)&*it);
+					}
+					data::iterator::LoserTreeMergeIterator<MergeElem, MergeElemIterator, MergeElemComparator> merger{ ptrs };
+					size_t idx{};
+					for (; merger; ++merger) {
+						ASSERT_VAL("loser tree size", idx < expected.size());
+						ASSERT_VAL("loser tree element", SameMergeElem(expected[idx++], *merger));
+					}
+					ASSERT_EQ("loser tree size", expected.size(), idx);
+				}
+
+				// allocated merge
+				{
+					data::iterator::AllocatedMergeAIterator<MergeElem, std::vector<MergeElem>, MergeElemComparator> merger{
+						runs, [](std::vector<MergeElem>& run) { return std::make_shared<MergeElemIterator>(run.data(), run.data() + run.size()); }
+					};
+					size_t idx{};
+					for (; merger; ++merger) {
+						ASSERT_VAL("allocated size", idx < expected.size());
+						ASSERT_VAL("allocated element", SameMergeElem(expected[idx++], *merger));
+					}
+					ASSERT_EQ("allocated size", expected.size(), idx);
+				}
+
+				// batches
+				for (size_t maxSize : { (size_t)1, (size_t)3, (size_t)-1 }) {
+					std::vector<std::span<MergeElem>> spans{ runs.begin(), runs.end() };
+					data::iterator::LoserTreeSpanMerger<MergeElem, MergeElemComparator> merger{ spans };
+					size_t idx{};
+					for (std::span<MergeElem> batch{ merger.NextBatch(maxSize) }; !batch.empty(); batch = merger.NextBatch(maxSize)) {
+						ASSERT_VAL("batch max size", batch.size() <= maxSize);
+						for (const MergeElem& e : batch) {
+							ASSERT_VAL("batch size", idx < expected.size());
+							ASSERT_VAL("batch run", e.run == batch[0].run);
+							ASSERT_VAL("batch element", SameMergeElem(expected[idx++], e));
+						}
+					}
+					ASSERT_EQ("batch size", expected.size(), idx);
+				}
+			}
+		}
+	}
+
+	constexpr size_t MERGE_BENCH_ELEMENTS = 0x40000;
+
+	template<size_t K>
+	void actslibmergepairbench(acts::unit_test::BenchmarkContext& ctx) {
+		std::vector<std::vector<MergeElem>> runs{ CreateMergeRuns(K, MERGE_BENCH_ELEMENTS, 0x10000) };
+		ctx.Measure(MERGE_BENCH_ELEMENTS, [&runs] {
+			std::vector<std::shared_ptr<data::iterator::AIterator<MergeElem>>> its{ CreateMergeIterators(runs) };
+			data::iterator::AIterator<MergeElem>& tree{ *CreatePairTree(its) };
+			uint64_t sum{};
+			for (; tree; ++tree) {
+				sum += tree->key;
+			}
+			return sum != 0;
+		});
+	}
+
+	template<size_t K>
+	void actslibmergeloserbench(acts::unit_test::BenchmarkContext& ctx) {
+		std::vector<std::vector<MergeElem>> runs{ CreateMergeRuns(K, MERGE_BENCH_ELEMENTS, 0x10000) };
+		ctx.Measure(MERGE_BENCH_ELEMENTS, [&runs] {
+			std::vector<MergeElemIterator> its{};
+			its.reserve(runs.size());
+			std::vector<MergeElemIterator*> ptrs{};
+			for (std::vector<MergeElem>& run : runs) {
+				ptrs.push_back(&its.emplace_back(run.data(), run.data() + run.size()));
+			}
+			data::iterator::LoserTreeMergeIterator<MergeElem, MergeElemIterator, MergeElemComparator> merger{ ptrs };
+			uint64_t sum{};
+			for (; merger; ++merger) {
+				sum += merger->key;
+			}
+			return sum != 0;
+		});
+	}
+
+	template<size_t K>
+	void actslibmergespanbench(acts::unit_test::BenchmarkContext& ctx) {
+		std::vector<std::vector<MergeElem>> runs{ CreateMergeRuns(K, MERGE_BENCH_ELEMENTS, 0x10000) };
+		ctx.Measure(MERGE_BENCH_ELEMENTS, [&runs] {
+			data::iterator::LoserTreeSpanMerger<MergeElem, MergeElemComparator> merger{ { runs.begin(), runs.end() } };
+			uint64_t sum{};
+			for (std::span<MergeElem> batch{ merger.NextBatch() }; !batch.empty(); batch = merger.NextBatch()) {
+				for (const MergeElem& e : batch) {
+					sum += e.key;
+				}
+			}
+			return sum != 0;
+		});
+	}
+
+	ADD_TEST(actslibkmerger, actslibkmergertest);
+	ADD_TEST(actslibmerge, actslibmergetest);
+
+	ADD_BENCHMARK(actslibkmerger2, actslibkmergerbench<2>);
+	ADD_BENCHMARK(actslibkmerger4, actslibkmergerbench<4>);
+	ADD_BENCHMARK(actslibkmerger8, actslibkmergerbench<8>);
+	ADD_BENCHMARK(actslibkmerger16, actslibkmergerbench<16>);
+	ADD_BENCHMARK(actslibkmerger32, actslibkmergerbench<32>);
+	ADD_BENCHMARK(actslibkmerger64, actslibkmergerbench<64>);
+
+	ADD_BENCHMARK(actslibmergepair2, actslibmergepairbench<2>);
+	ADD_BENCHMARK(actslibmergepair16, actslibmergepairbench<16>);
+	ADD_BENCHMARK(actslibmergepair256, actslibmergepairbench<256>);
+	ADD_BENCHMARK(actslibmergeloser2, actslibmergeloserbench<2>);
+	ADD_BENCHMARK(actslibmergeloser16, actslibmergeloserbench<16>);
+	ADD_BENCHMARK(actslibmergeloser256, actslibmergeloserbench<256>);
+	ADD_BENCHMARK(actslibmergespan2, actslibmergespanbench<2>);
+	ADD_BENCHMARK(actslibmergespan16, actslibmergespanbench<16>);
+	ADD_BENCHMARK(actslibmergespan256, actslibmergespanbench<256>);
+}
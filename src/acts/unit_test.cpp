@@ -1,6 +1,10 @@
 #include <includes.hpp>
 #include <unit_test.hpp>
+#include <utils/utils.hpp>
 #include <cli/clicolor.hpp>
+#include <rapidjson/document.h>
+#include <rapidjson/prettywriter.h>
+#include <rapidjson/stringbuffer.h>
 
 namespace acts::unit_test {
 	std::unordered_map<uint64_t, UnitTest*>& GetTests() {
@@ -8,6 +12,11 @@ namespace acts::unit_test {
 		return tests;
 	}
 
+	std::map<uint64_t, Benchmark*>& GetBenchmarks() {
+		static std::map<uint64_t, Benchmark*> benchmarks{};
+		return benchmarks;
+	}
+
 	void AssertImpl(const std::string& msg, const char* file, size_t line, bool value) {
 		if (value) {
 			LOG_TRACE("{}@{}: {} -> {}OK", file, line, msg, cli::clicolor::Color(1, 5, 1));
@@ -26,6 +35,17 @@ namespace acts::unit_test {
 		GetTests()[uid] = this;
 	}
 
+	Benchmark::Benchmark(uint64_t uid, const char* id, void(*func)(BenchmarkContext& ctx)) : id(id), func(func) {
+		GetBenchmarks()[uid] = this;
+	}
+
+	std::vector<std::filesystem::path> BenchmarkContext::GetCorpusFiles(const char* dir, const char* exts) const {
+		std::vector<std::filesystem::path> files{};
+		utils::GetFileRecurseExt(corpus / dir, files, exts);
+		std::sort(files.begin(), files.end());
+		return files;
+	}
+
 	bool UnitTest::HandleTest() {
 		if (IsDebuggerPresent()) {
 			func();
@@ -77,6 +97,220 @@ namespace acts::unit_test {
 			return errors ? tool::BASIC_ERROR : tool::OK;
 		}
 
+		struct BenchmarkResult {
+			std::string id{};
+			size_t files{};
+			uint64_t bytes{};
+			uint64_t errors{};
+			double timeMs{};
+			double filesPerSec{};
+			double mbPerSec{};
+			double p50Us{};
+			double p99Us{};
+		};
+
+		double Percentile(std::vector<uint64_t>& sorted, double pct) {
+			if (sorted.empty()) {
+				return 0;
+			}
+			size_t idx{ (size_t)(pct * (sorted.size() - 1) / 100.0 + 0.5) };
+			return sorted[std::min(idx, sorted.size() - 1)] / 1000.0;
+		}
+
+		int ubench(int argc, const char* argv[]) {
+			BenchmarkContext ctx{};
+			size_t warmup{ 1 };
+			size_t iterations{ 5 };
+			const char* output{};
+			const char* baseline{};
+			double threshold{ 10 };
+			std::unordered_set<uint64_t> selected{};
+
+			for (size_t i = 2; i < argc; i++) {
+				const char* arg{ argv[i] };
+
+				if (*arg != '-') {
+					selected.insert(hash::Hash64(arg));
+					continue;
+				}
+				if (i + 1 == argc) {
+					LOG_ERROR("Missing value for param: {}!", arg);
+					return tool::BAD_USAGE;
+				}
+				const char* val{ argv[++i] };
+
+				if (!strcmp("-w", arg) || !_strcmpi("--warmup", arg)) {
+					warmup = (size_t)utils::ParseFormatInt(val);
+				}
+				else if (!strcmp("-n", arg) || !_strcmpi("--iterations", arg)) {
+					iterations = (size_t)utils::ParseFormatInt(val);
+				}
+				else if (!strcmp("-c", arg) || !_strcmpi("--corpus", arg)) {
+					ctx.corpus = val;
+				}
+				else if (!strcmp("-v", arg) || !_strcmpi("--vm", arg)) {
+					ctx.vm = val;
+				}
+				else if (!strcmp("-p", arg) || !_strcmpi("--platform", arg)) {
+					ctx.platform = val;
+				}
+				else if (!strcmp("-o", arg) || !_strcmpi("--output", arg)) {
+					output = val;
+				}
+				else if (!strcmp("-b", arg) || !_strcmpi("--baseline", arg)) {
+					baseline = val;
+				}
+				else if (!strcmp("-t", arg) || !_strcmpi("--threshold", arg)) {
+					threshold = std::strtod(val, nullptr);
+				}
+				else {
+					LOG_ERROR("Unknown option: {}!", arg);
+					return tool::BAD_USAGE;
+				}
+			}
+
+			if (!iterations) {
+				LOG_ERROR("At least one iteration is required");
+				return tool::BAD_USAGE;
+			}
+
+			std::vector<BenchmarkResult> results{};
+			for (auto& [uid, bench] : GetBenchmarks()) {
+				if (!selected.empty() && !selected.contains(uid)) {
+					continue;
+				}
+
+				LOG_INFO("Benchmark - {}", bench->id);
+				ctx.samples.clear();
+				ctx.bytes = 0;
+				ctx.errors = 0;
+
+				try {
+					ctx.warmup = true;
+					for (size_t i = 0; i < warmup; i++) {
+						bench->func(ctx);
+					}
+					ctx.warmup = false;
+					for (size_t i = 0; i < iterations; i++) {
+						bench->func(ctx);
+					}
+				}
+				catch (std::runtime_error& re) {
+					LOG_ERROR("{} -> {}", bench->id, re.what());
+					ctx.errors++;
+				}
+
+				BenchmarkResult& res{ results.emplace_back() };
+				res.id = bench->id;
+				res.files = ctx.samples.size() / iterations;
+				res.bytes = ctx.bytes / iterations;
+				res.errors = ctx.errors;
+
+				uint64_t total{};
+				for (uint64_t s : ctx.samples) {
+					total += s;
+				}
+				res.timeMs = total / 1000000.0 / iterations;
+				if (total) {
+					res.filesPerSec = ctx.samples.size() * 1000000000.0 / total;
+					res.mbPerSec = ctx.bytes * 1000.0 / total;
+				}
+				std::sort(ctx.samples.begin(), ctx.samples.end());
+				res.p50Us = Percentile(ctx.samples, 50);
+				res.p99Us = Percentile(ctx.samples, 99);
+
+				LOG_INFO("{} -> {} file(s), {:.3f}ms, {:.1f} files/s, {:.2f} MB/s, p50={:.1f}us, p99={:.1f}us, {} error(s)",
+					res.id, res.files, res.timeMs, res.filesPerSec, res.mbPerSec, res.p50Us, res.p99Us, res.errors);
+			}
+
+			if (results.empty()) {
+				LOG_ERROR("No benchmark found");
+				return tool::BASIC_ERROR;
+			}
+
+			if (output) {
+				rapidjson::Document doc{};
+				doc.SetObject();
+				auto& alloc{ doc.GetAllocator() };
+
+				doc.AddMember("warmup", (uint64_t)warmup, alloc);
+				doc.AddMember("iterations", (uint64_t)iterations, alloc);
+				rapidjson::Value benchmarks{ rapidjson::kObjectType };
+				for (const BenchmarkResult& res : results) {
+					rapidjson::Value val{ rapidjson::kObjectType };
+					val.AddMember("files", (uint64_t)res.files, alloc);
+					val.AddMember("bytes", res.bytes, alloc);
+					val.AddMember("errors", res.errors, alloc);
+					val.AddMember("time_ms", res.timeMs, alloc);
+					val.AddMember("files_per_s", res.filesPerSec, alloc);
+					val.AddMember("mb_per_s", res.mbPerSec, alloc);
+					val.AddMember("p50_us", res.p50Us, alloc);
+					val.AddMember("p99_us", res.p99Us, alloc);
+					benchmarks.AddMember(rapidjson::Value{ res.id.data(), alloc }, val, alloc);
+				}
+				doc.AddMember("benchmarks", benchmarks, alloc);
+
+				rapidjson::StringBuffer buffer{};
+				rapidjson::PrettyWriter<rapidjson::StringBuffer> writer{ buffer };
+				doc.Accept(writer);
+
+				if (!utils::WriteFile(output, buffer.GetString(), buffer.GetSize())) {
+					LOG_ERROR("Can't write {}", output);
+					return tool::BASIC_ERROR;
+				}
+				LOG_INFO("Results written into {}", output);
+			}
+
+			if (!baseline) {
+				return tool::OK;
+			}
+
+			std::string buffer{};
+			if (!utils::ReadFile(baseline, buffer)) {
+				LOG_ERROR("Can't read baseline {}", baseline);
+				return tool::BASIC_ERROR;
+			}
+			rapidjson::Document doc{};
+			doc.Parse(buffer.c_str());
+			if (doc.HasParseError() || !doc.IsObject() || !doc.HasMember("benchmarks") || !doc["benchmarks"].IsObject()) {
+				LOG_ERROR("Invalid baseline {}", baseline);
+				return tool::BASIC_ERROR;
+			}
+
+			// compare the throughput and the tail latency, the time per file is too noisy for small corpora
+			size_t regressions{};
+			const rapidjson::Value& benchmarks{ doc["benchmarks"] };
+			for (const BenchmarkResult& res : results) {
+				auto it{ benchmarks.FindMember(res.id.data()) };
+				if (it == benchmarks.MemberEnd() || !it->value.IsObject()) {
+					LOG_WARNING("{} isn't in the baseline", res.id);
+					continue;
+				}
+				const rapidjson::Value& base{ it->value };
+				double baseFps{ base.HasMember("files_per_s") ? base["files_per_s"].GetDouble() : 0 };
+				double baseP99{ base.HasMember("p99_us") ? base["p99_us"].GetDouble() : 0 };
+
+				if (baseFps && res.filesPerSec < baseFps * (1 - threshold / 100)) {
+					LOG_ERROR("{} -> regression: {:.1f} files/s < {:.1f} files/s", res.id, res.filesPerSec, baseFps);
+					regressions++;
+				}
+				else if (baseP99 && res.p99Us > baseP99 * (1 + threshold / 100)) {
+					LOG_ERROR("{} -> regression: p99 {:.1f}us > {:.1f}us", res.id, res.p99Us, baseP99);
+					regressions++;
+				}
+				else {
+					LOG_INFO("{} -> {}OK", res.id, cli::clicolor::Color(1, 5, 1));
+				}
+			}
+
+			if (regressions) {
+				LOG_ERROR("{} regression(s) compared to {} (threshold {}%)", regressions, baseline, threshold);
+				return tool::BASIC_ERROR;
+			}
+			LOG_INFO("No regression compared to {}", baseline);
+			return tool::OK;
+		}
+
 		void utesttest() {
 			ASSERT_VAL("test", true);
 			ASSERT_VAL("test", true);
@@ -86,6 +320,7 @@ namespace acts::unit_test {
 		}
 
 		ADD_TOOL(utest, "dev", " (test)", "start unit test", utest);
+		ADD_TOOL(ubench, "dev", " [-w warmup] [-n iterations] [-c corpus] [-v vm] [-p platform] [-o out.json] [-b baseline.json] [-t threshold%] (bench)", "start benchmarks", ubench);
 		ADD_TEST(utest, utesttest);
 	}
 }
\ No newline at end of file
@@ -1,5 +1,6 @@
 #pragma once
 #include <core/logs.hpp>
+#include <chrono>
 
 namespace acts::unit_test {
 	void AssertImpl(const std::string& msg, const char* file, size_t line, bool value);
@@ -12,8 +13,62 @@ namespace acts::unit_test {
 
 		bool HandleTest();
 	};
+
+	// Context of a benchmark run, a benchmark is called once per warmup/iteration round
+	class BenchmarkContext {
+	public:
+		// test corpora directory
+		std::filesystem::path corpus{ "test" };
+		// vm and platform used by the gsc benchmarks
+		const char* vm{ "t9" };
+		const char* platform{ "pc" };
+		// warmup round, the measures are ignored
+		bool warmup{};
+		// time per element in nanoseconds
+		std::vector<uint64_t> samples{};
+		uint64_t bytes{};
+		uint64_t errors{};
+
+		/*
+		 * Get the files of a test corpus
+		 * @param dir corpus directory name
+		 * @param exts extensions, separated by '\0'
+		 * @return files, sorted to have the same order in all the runs
+		 */
+		std::vector<std::filesystem::path> GetCorpusFiles(const char* dir, const char* exts) const;
+
+		/*
+		 * Measure the time to process an element
+		 * @param size size of the element
+		 * @param func function processing the element, returns false if the element can't be processed
+		 */
+		template<typename Func>
+		void Measure(size_t size, Func&& func) {
+			auto start{ std::chrono::steady_clock::now() };
+			bool ok{ func() };
+			uint64_t time{ (uint64_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count() };
+
+			if (warmup) {
+				return;
+			}
+			if (!ok) {
+				errors++;
+				return;
+			}
+			samples.push_back(time);
+			bytes += size;
+		}
+	};
+
+	class Benchmark {
+	public:
+		const char* id;
+		void(*func)(BenchmarkContext& ctx);
+		Benchmark(uint64_t uid, const char* id, void(*func)(BenchmarkContext& ctx));
+	};
 }
 
 #define ASSERT_VAL(msg, val) acts::unit_test::AssertImpl(std::format("{} - {}", #val, msg), LOG_GET_LOG_REF_STR, __LINE__, val)
 #define ASSERT_EQ(msg, expected, actual) ASSERT_VAL(msg, (expected) == (actual))
-#define ADD_TEST(id, func) static acts::unit_test::UnitTest __unittest_##id(hash::Hash64(#id), #id, func)
\ No newline at end of file
+#define ADD_TEST(id, func) static acts::unit_test::UnitTest __unittest_##id(hash::Hash64(#id), #id, func)
+#define ADD_BENCHMARK(id, func) static acts::unit_test::Benchmark __benchmark_##id(hash::Hash64(#id), #id, func)
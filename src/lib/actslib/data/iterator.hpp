@@ -1,4 +1,5 @@
 #pragma once
+#include <span>
 #include "../actslib.hpp"
 
 namespace actslib::data::iterator {
@@ -32,7 +33,7 @@ namespace actslib::data::iterator {
 	};
 
 	template<typename Type, typename ItType>
-	class HandleAIterator : public AIterator<Type> {
+	class HandleAIterator final : public AIterator<Type> {
 		ItType it;
 		ItType end;
 	public:
@@ -109,59 +110,242 @@ namespace actslib::data::iterator {
 		}
 	};
 
-	template<typename Type, typename InputType, typename Comparator = MergeIteratorBasicComp<Type>>
-	class AllocatedMergeAIterator : public AIterator<Type> {
-		std::vector<std::shared_ptr<AIterator<Type>>> its{};
-		AIterator<Type>* main;
+	/*
+	 * Loser tree of k runs, the internal nodes are keeping the loser of their match and the winner is the smallest
+	 * head with one comparison by level. The ties are won by the highest run, it gives the same order as a
+	 * MergeIterator tree.
+	 */
+	template<typename Type, typename Comparator = MergeIteratorBasicComp<Type>>
+	class LoserTree {
+		// head of each run, nullptr if the run is empty
+		std::vector<Type*> heads{};
+		// tree[0] is the winner, tree[1..k) the losers, the run i is the leaf k + i
+		std::vector<size_t> tree{};
 
+		inline size_t Match(size_t a, size_t b) const {
+			size_t lo{ a < b ? a : b };
+			size_t hi{ a < b ? b : a };
+			if (!heads[hi]) {
+				return lo;
+			}
+			if (!heads[lo]) {
+				return hi;
+			}
+			return Comparator::Compare(*heads[lo], *heads[hi]) ? lo : hi;
+		}
 	public:
-		AllocatedMergeAIterator(std::vector<InputType>& input, std::function<std::shared_ptr<AIterator<Type>>(InputType&)> map) {
-#ifdef max
-#undef max
-#endif
-			its.reserve(actslib::max<size_t>(1, input.size() * 2));
+		static constexpr size_t NO_RUN = (size_t)-1;
 
-			for (InputType& in : input) {
-				its.emplace_back(map(in));
+		void Init(std::vector<Type*>&& runHeads) {
+			heads = std::move(runHeads);
+			size_t k{ heads.size() };
+			tree.resize(k);
+
+			if (!k) {
+				return;
 			}
 
-			if (its.empty()) {
-				its.emplace_back(std::make_shared<EmptyAIterator<Type>>());
+			std::vector<size_t> winners(k * 2);
+			for (size_t i = 0; i < k; i++) {
+				winners[k + i] = i;
+			}
+			for (size_t p = k - 1; p; p--) {
+				size_t a{ winners[p * 2] };
+				size_t b{ winners[p * 2 + 1] };
+				size_t w{ Match(a, b) };
+				tree[p] = w == a ? b : a;
+				winners[p] = w;
 			}
-			else if (its.size() > 1) {
-				// at least 2 elements, we need to merge
+			tree[0] = winners[1];
+		}
 
-				size_t start{};
-				size_t len = its.size();
+		constexpr size_t Size() const {
+			return heads.size();
+		}
 
-				do {
-					for (size_t i = 0; i + 1 < len; i += 2) {
-						its.emplace_back(std::make_shared<MergeIterator<Type, Comparator>>(*its[start + i], *its[start + i + 1]));
-					}
+		inline size_t Winner() const {
+			return tree.empty() ? NO_RUN : tree[0];
+		}
+
+		inline Type* GetHead(size_t run) const {
+			return heads[run];
+		}
+
+		inline Type* WinnerHead() const {
+			return tree.empty() ? nullptr : heads[tree[0]];
+		}
 
-					if (len & 1) {
-						// add last one just in case
-						its.emplace_back(its[start + len - 1]);
+		/*
+		 * Update the head of a run and replay its matches, only the winner run can be updated
+		 * @param run run
+		 * @param head new head or nullptr if the run is empty
+		 */
+		inline void Replay(size_t run, Type* head) {
+			heads[run] = head;
+			size_t w{ run };
+			for (size_t p = (heads.size() + run) >> 1; p; p >>= 1) {
+				size_t l{ tree[p] };
+				if (Match(l, w) == l) {
+					tree[p] = w;
+					w = l;
+				}
+			}
+			tree[0] = w;
+		}
+
+		/*
+		 * @return the run of the second smallest head or NO_RUN if the winner is the only run
+		 */
+		size_t RunnerUp() const {
+			size_t r{ NO_RUN };
+			if (tree.empty()) {
+				return r;
+			}
+			for (size_t p = (heads.size() + tree[0]) >> 1; p; p >>= 1) {
+				r = r == NO_RUN ? tree[p] : Match(r, tree[p]);
+			}
+			return r;
+		}
+	};
+
+	/*
+	 * K-way merge iterator of sorted runs using a loser tree, the runs are called using their Source type, so a final
+	 * Source isn't using a virtual call in the merge.
+	 */
+	template<typename Type, typename Source, typename Comparator = MergeIteratorBasicComp<Type>>
+	class LoserTreeMergeIterator : public AIterator<Type> {
+		std::vector<Source*> runs{};
+		LoserTree<Type, Comparator> tree{};
+	public:
+		/*
+		 * @param input pointers to the runs, the runs should be alive during the merge
+		 */
+		template<typename Range>
+		LoserTreeMergeIterator(Range& input) {
+			std::vector<Type*> heads{};
+			for (auto& in : input) {
+				Source& run{ *in };
+				runs.push_back(&run);
+				heads.push_back(run ? &*run : nullptr);
+			}
+			tree.Init(std::move(heads));
+		}
+
+		LoserTreeMergeIterator<Type, Source, Comparator>& operator++() override {
+			if (tree.WinnerHead()) {
+				size_t w{ tree.Winner() };
+				Source& run{ *runs[w] };
+				++run;
+				tree.Replay(w, run ? &*run : nullptr);
+			}
+			return *this;
+		}
+
+		Type& operator*() override {
+			Type* head{ tree.WinnerHead() };
+			if (!head) {
+				throw std::runtime_error("Empty iterator");
+			}
+			return *head;
+		}
+
+		operator bool() override {
+			return tree.WinnerHead();
+		}
+	};
+
+	/*
+	 * K-way merge of sorted spans using a loser tree, the elements are pulled by batches of consecutive elements
+	 * of the same run.
+	 */
+	template<typename Type, typename Comparator = MergeIteratorBasicComp<Type>>
+	class LoserTreeSpanMerger {
+		std::vector<std::span<Type>> runs;
+		LoserTree<Type, Comparator> tree{};
+	public:
+		LoserTreeSpanMerger(std::vector<std::span<Type>> input) : runs(std::move(input)) {
+			std::vector<Type*> heads{};
+			heads.reserve(runs.size());
+			for (std::span<Type>& run : runs) {
+				heads.push_back(run.empty() ? nullptr : run.data());
+			}
+			tree.Init(std::move(heads));
+		}
+
+		/*
+		 * Pull the next elements, the batch is the longest prefix of a run before an element of another run
+		 * @param maxSize max size of the batch, at least 1
+		 * @return the elements or an empty span if the merge is done
+		 */
+		std::span<Type> NextBatch(size_t maxSize = (size_t)-1) {
+			if (!tree.WinnerHead()) {
+				return {};
+			}
+			size_t w{ tree.Winner() };
+			std::span<Type>& run{ runs[w] };
+			size_t limit{ actslib::max<size_t>(1, actslib::min(maxSize, run.size())) };
+			size_t len{ 1 };
+
+			tree.Replay(w, run.size() > 1 ? &run[1] : nullptr);
+
+			if (len < limit && tree.Winner() == w) {
+				// the run is still winning, we compare the next elements to the runner-up instead of replaying them
+				size_t r{ tree.RunnerUp() };
+				Type* next{ r == tree.NO_RUN ? nullptr : tree.GetHead(r) };
+				len++;
+				if (!next) {
+					len = limit;
+				}
+				else if (w > r) {
+					// the winner run wins the ties
+					while (len < limit && !Comparator::Compare(*next, run[len])) {
+						len++;
+					}
+				}
+				else {
+					while (len < limit && Comparator::Compare(run[len], *next)) {
+						len++;
 					}
+				}
+				tree.Replay(w, run.size() > len ? &run[len] : nullptr);
+			}
+
+			std::span<Type> batch{ run.first(len) };
+			run = run.subspan(len);
+			return batch;
+		}
+	};
+
+	template<typename Type, typename InputType, typename Comparator = MergeIteratorBasicComp<Type>>
+	class AllocatedMergeAIterator : public AIterator<Type> {
+		std::vector<std::shared_ptr<AIterator<Type>>> its;
+		LoserTreeMergeIterator<Type, AIterator<Type>, Comparator> main;
 
-					start += len;
-					len = its.size() - start;
-				} while (len > 1);
+		static std::vector<std::shared_ptr<AIterator<Type>>> MapInput(std::vector<InputType>& input, std::function<std::shared_ptr<AIterator<Type>>(InputType&)>& map) {
+			std::vector<std::shared_ptr<AIterator<Type>>> mapped{};
+			mapped.reserve(input.size());
+			for (InputType& in : input) {
+				mapped.emplace_back(map(in));
 			}
-			main = &*its[its.size() - 1];
+			return mapped;
+		}
+
+	public:
+		AllocatedMergeAIterator(std::vector<InputType>& input, std::function<std::shared_ptr<AIterator<Type>>(InputType&)> map)
+			: its(MapInput(input, map)), main(its) {
 		}
 
 		AllocatedMergeAIterator<Type, InputType, Comparator>& operator++() override {
-			++(*main);
+			++main;
 			return *this;
 		}
 
 		Type& operator*() override {
-			return **main;
+			return *main;
 		}
 
 		operator bool() override {
-			return (*main);
+			return (bool)main;
 		}
 	};
 }
\ No newline at end of file
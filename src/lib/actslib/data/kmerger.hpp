@@ -1,4 +1,9 @@
 #pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <exception>
+#include <thread>
 #include "../actslib.hpp"
 
 
@@ -19,30 +24,52 @@ namespace actslib::data {
 	struct KMergerTask {
 		std::function<void()> func;
 		const char* type;
-		bool end{};
 	};
 
+	/*
+	 * Create chunks and merge them by groups of units chunks of the same layer using a pool of workers. Each worker
+	 * has its own task deque, the tasks pushed by a worker are popped back by it and the idle workers are stealing
+	 * the oldest tasks of the others.
+	 */
 	class KMerger {
+		struct Worker {
+			std::deque<KMergerTask> tasks{};
+			std::mutex mutex{};
+		};
+
 		KMergerConfig& cfg;
 		const size_t units;
 		const size_t workersCount;
 		const std::filesystem::path workdir;
-		bool completed{};
 		std::vector<std::thread> workers{};
+		std::unique_ptr<Worker[]> workerTasks;
 
-		std::vector<KMergerChunk> chunks{};
-		size_t maxLayer{};
+		// chunks by layer, a layer can only be ready to merge after a chunk was added into it
+		std::vector<std::vector<KMergerChunk>> layers{};
+		size_t chunksCount{};
+		size_t runningMerges{};
+		bool completed{};
 		std::mutex chunksMutex;
 
-		std::vector<KMergerTask> tasks{};
-		std::condition_variable taskCondVar;
-		std::mutex taskCondMutex;
+		// tasks in the worker deques
+		std::atomic<size_t> pendingTasks{};
+		// tasks in the worker deques or running, the run is done when it is 0, it starts at 1 to hold the workers
+		// until the first task is pushed
+		std::atomic<size_t> outstandingTasks{ 1 };
+		std::atomic<size_t> sleepingWorkers{};
+		std::atomic<bool> stopped{};
+		std::condition_variable idleCondVar;
+		std::mutex idleMutex;
+		size_t pushWorker{};
 
-		size_t idGen{};
-		std::mutex idMutex{};
+		std::atomic<size_t> idGen{};
 
-		const char* exception{};
+		std::exception_ptr exception{};
 		std::mutex exceptionMutex{};
+
+		// worker of the current thread, used to push the tasks into its own deque
+		inline static thread_local const KMerger* currentMerger{};
+		inline static thread_local size_t currentWorker{};
 	public:
 		KMerger(const std::filesystem::path workdir, size_t units, size_t workersCount, KMergerConfig& cfg)
 			: workdir(workdir), units(units), workersCount(workersCount), cfg(cfg) {
@@ -52,10 +79,10 @@ namespace actslib::data {
 			if (units < 2) {
 				throw std::invalid_argument("units should be at least 2");
 			}
+			workerTasks = std::make_unique<Worker[]>(workersCount);
 		}
 
 		size_t GetNewIdSync() {
-			std::lock_guard lg{ idMutex };
 			return ++idGen;
 		}
 
@@ -63,188 +90,229 @@ namespace actslib::data {
 			return workdir / va("c_%lld", GetNewIdSync());
 		}
 
-		void PushTask(const char* type, std::function<void()> task, bool sync) {
-			if (sync) {
-				std::lock_guard lg{ taskCondMutex };
-
-				tasks.emplace_back(task, type);
-
-				taskCondVar.notify_one();
+		/*
+		 * Push a task, the task is pushed into the deque of the current worker or shared between the workers if
+		 * it was pushed from another thread.
+		 * @param type task type
+		 * @param task task
+		 */
+		void PushTask(const char* type, std::function<void()> task) {
+			Worker* worker;
+			if (currentMerger == this) {
+				worker = &workerTasks[currentWorker];
 			}
 			else {
-				tasks.emplace_back(task, type);
-
-				taskCondVar.notify_one();
+				std::lock_guard lg{ idleMutex };
+				worker = &workerTasks[pushWorker++ % workersCount];
 			}
-		}
-
-	private:
-
-		KMergerTask PopTask() {
-			std::unique_lock ul{ taskCondMutex };
-
-			auto& that = *this;
 
-			taskCondVar.wait(ul, [&that] {return !that.tasks.empty() || that.completed;  });
-
-			if (tasks.empty() || exception) {
-				return { [] {}, "empty", true };
+			outstandingTasks++;
+			pendingTasks++;
+			{
+				std::lock_guard lg{ worker->mutex };
+				worker->tasks.emplace_back(std::move(task), type);
 			}
 
-			auto f = tasks[tasks.size() - 1];
-
-			tasks.pop_back();
-
-			ul.unlock();
-
-			return f;
+			// the sleeping workers are counted before checking the pending tasks, so one of them will see the task
+			if (sleepingWorkers) {
+				{ std::lock_guard lg{ idleMutex }; }
+				idleCondVar.notify_one();
+			}
 		}
 
-		bool FindChunksToMerge(std::vector<KMergerChunk>& ch) {
-			if (completed) {
-				ALOG_TRACE("completed size: {}", chunks.size());
-				if (chunks.size() > 1) {
-					ch.reserve(chunks.size() > units ? units : chunks.size());
-					if (units > chunks.size()) {
-						ch.insert(ch.begin(), chunks.begin(), chunks.end());
-						chunks.clear();
-					}
-					else {
-						auto start = chunks.begin() + (chunks.size() - units);
-						ch.insert(ch.begin(), start, chunks.end());
-						chunks.erase(start, chunks.end());
-					}
+	private:
+		bool TryPopTask(size_t id, KMergerTask& task) {
+			// own tasks, last pushed first
+			{
+				Worker& worker{ workerTasks[id] };
+				std::lock_guard lg{ worker.mutex };
+				if (!worker.tasks.empty()) {
+					task = std::move(worker.tasks.back());
+					worker.tasks.pop_back();
+					pendingTasks--;
 					return true;
 				}
-				ALOG_TRACE("done size: {}", chunks.size());
-				return false; // done
 			}
-
-			// not completed, we need to search for the same layers
-			
-			// clear chunks
-			for (size_t i = 0; i <= maxLayer; i++) {
-				size_t count{};
-
-				for (const auto& chunk : chunks) {
-					if (chunk.layer == i) {
-						count++;
-					}
+			// steal the oldest task of another worker
+			for (size_t i = 1; i < workersCount; i++) {
+				Worker& worker{ workerTasks[(id + i) % workersCount] };
+				std::lock_guard lg{ worker.mutex };
+				if (!worker.tasks.empty()) {
+					task = std::move(worker.tasks.front());
+					worker.tasks.pop_front();
+					pendingTasks--;
+					return true;
 				}
+			}
+			return false;
+		}
 
-				if (count >= units) {
-					ch.reserve(units);
-					auto it = chunks.begin();
-
-					// insert the nodes at the right level into ch
-					while (ch.size() < units) {
-						if (it->layer == i) {
-							ch.push_back(*it);
-							it = chunks.erase(it);
-							continue;
-						}
-						it++;
-					}
-
+		bool PopTask(size_t id, KMergerTask& task) {
+			while (true) {
+				if (pendingTasks && TryPopTask(id, task)) {
 					return true;
 				}
+				if (!outstandingTasks) {
+					return false; // no more tasks can be created
+				}
+
+				std::unique_lock ul{ idleMutex };
+				sleepingWorkers++;
+				idleCondVar.wait(ul, [this] { return pendingTasks || !outstandingTasks; });
+				sleepingWorkers--;
 			}
+		}
 
-			return false;
+		void EndTask() {
+			if (!--outstandingTasks) {
+				// last task, wake up everyone to end the workers
+				{ std::lock_guard lg{ idleMutex }; }
+				idleCondVar.notify_all();
+			}
 		}
 
-		void PushMergeTaskIfRequired(bool sync) {
-			std::unique_lock ul{ chunksMutex };
+		// the chunksMutex should be locked
+		void AddChunk(size_t layer, std::filesystem::path&& file) {
+			if (layer >= layers.size()) {
+				layers.resize(layer + 1);
+			}
+			layers[layer].emplace_back(layer, std::move(file));
+			chunksCount++;
+		}
 
+		// the chunksMutex should be locked
+		bool FindChunksToMerge(size_t layer, std::vector<KMergerChunk>& ch) {
+			if (layer < layers.size() && layers[layer].size() >= units) {
+				// merge the oldest chunks of the layer
+				std::vector<KMergerChunk>& lchunks{ layers[layer] };
+				ch.insert(ch.end(), std::make_move_iterator(lchunks.begin()), std::make_move_iterator(lchunks.begin() + units));
+				lchunks.erase(lchunks.begin(), lchunks.begin() + units);
+				chunksCount -= units;
+				return true;
+			}
 
-			std::vector<KMergerChunk> ch{};
-			if (!FindChunksToMerge(ch)) {
-				return;
+			if (!completed) {
+				return false;
 			}
-			ul.unlock();
 
-			auto& that = *this;
+			// completed, we merge the remaining chunks, we wait for the running merges if we can't fill a merge
+			if (chunksCount < 2 || (chunksCount < units && runningMerges)) {
+				ALOG_TRACE("completed size: {}, running: {}", chunksCount, runningMerges);
+				return false;
+			}
 
-			PushTask("merge", [&that, ch] {
-				size_t layer{};
+			// use the lowest layers first to merge the smallest chunks
+			size_t count{ actslib::min(units, chunksCount) };
+			ch.reserve(count);
+			for (std::vector<KMergerChunk>& lchunks : layers) {
+				size_t take{ actslib::min(count - ch.size(), lchunks.size()) };
+				ch.insert(ch.end(), std::make_move_iterator(lchunks.begin()), std::make_move_iterator(lchunks.begin() + take));
+				lchunks.erase(lchunks.begin(), lchunks.begin() + take);
+				if (ch.size() == count) {
+					break;
+				}
+			}
+			chunksCount -= count;
+			return true;
+		}
 
-				// compute max layer
-				for (const auto& chk : ch) {
-					if (chk.layer > layer) {
-						layer = chk.layer;
-					}
+		// the chunksMutex should be locked
+		void FindMergeTasks(size_t layer, std::vector<std::vector<KMergerChunk>>& merges) {
+			while (true) {
+				std::vector<KMergerChunk> ch{};
+				if (!FindChunksToMerge(layer, ch)) {
+					return;
 				}
+				runningMerges++;
+				merges.emplace_back(std::move(ch));
+			}
+		}
 
-				std::filesystem::path chunkLoc = that.GetNewIdSyncPath();
-				// merge chunks into new chunk
-				that.cfg.MergeChunks(ch, chunkLoc);
+		void PushMergeTasks(std::vector<std::vector<KMergerChunk>>& merges) {
+			for (std::vector<KMergerChunk>& ch : merges) {
+				PushTask("merge", [this, ch = std::move(ch)] {
+					size_t layer{};
 
-				// insert the new chunk
-				{
-					std::lock_guard lg{ that.chunksMutex };
-					that.chunks.emplace_back(layer + 1, chunkLoc);
-					if (layer + 1 > that.maxLayer) {
-						that.maxLayer = layer + 1;
+					// compute max layer
+					for (const auto& chk : ch) {
+						if (chk.layer > layer) {
+							layer = chk.layer;
+						}
 					}
-				}
 
-				// create a new merge task if this one is required
-				that.PushMergeTaskIfRequired(true);
-			}, sync);
+					std::filesystem::path chunkLoc = GetNewIdSyncPath();
+					// merge chunks into new chunk
+					cfg.MergeChunks(ch, chunkLoc);
+
+					// insert the new chunk and create a new merge task if this one is required
+					std::vector<std::vector<KMergerChunk>> next{};
+					{
+						std::lock_guard lg{ chunksMutex };
+						runningMerges--;
+						AddChunk(layer + 1, std::move(chunkLoc));
+						FindMergeTasks(layer + 1, next);
+					}
+					PushMergeTasks(next);
+				});
+			}
 		}
 
-		void PushCreateChunkTask(bool sync) {
-			auto& that = *this;
-			PushTask("create", [&that] {
-				std::filesystem::path chunkLoc = that.GetNewIdSyncPath();
-
-				if (!that.cfg.CreateChunk(chunkLoc)) {
-					std::lock_guard lg{ that.taskCondMutex };
-
-					that.completed = true;
-					// call the merge to force the full completion
-					that.PushMergeTaskIfRequired(false);
-					// chunk completed, we don't have to handle more than required. We close all the ones not working
-					that.taskCondVar.notify_all();
+		void PushCreateChunkTask() {
+			PushTask("create", [this] {
+				std::filesystem::path chunkLoc = GetNewIdSyncPath();
+
+				std::vector<std::vector<KMergerChunk>> merges{};
+				if (!cfg.CreateChunk(chunkLoc)) {
+					{
+						std::lock_guard lg{ chunksMutex };
+						completed = true;
+						// call the merge to force the full completion
+						FindMergeTasks(0, merges);
+					}
+					PushMergeTasks(merges);
 					return;
 				}
 
-				// insert the new chunk
-				{
-					std::lock_guard lg{ that.chunksMutex };
-					that.chunks.emplace_back(0, chunkLoc);
-				}
 				// create new chunk after
-				that.PushCreateChunkTask(true);
-				// maybe we need to merge the new chunk
-				that.PushMergeTaskIfRequired(true);
-			}, sync);
-
+				PushCreateChunkTask();
 
+				// insert the new chunk, maybe we need to merge it
+				{
+					std::lock_guard lg{ chunksMutex };
+					AddChunk(0, std::move(chunkLoc));
+					FindMergeTasks(0, merges);
+				}
+				PushMergeTasks(merges);
+			});
 		}
 
-		void HandleWorker() {
-			KMergerTask task{ [] {}, "none" };
+		void HandleWorker(size_t id) {
+			currentMerger = this;
+			currentWorker = id;
 
-			try {
-				while (!task.end) {
-					task = PopTask();
-					task.func();
-				}
-			}
-			catch (std::exception& e) {
-				{
-					std::lock_guard lg{ exceptionMutex };
-					exception = actslib::va("KMerger error in %s : %s", task.type, e.what());
+			KMergerTask task{};
+			while (PopTask(id, task)) {
+				if (!stopped) {
+					try {
+						task.func();
+					}
+					catch (...) {
+						ALOG_ERROR("KMerger error in {} task", task.type);
+						{
+							std::lock_guard lg{ exceptionMutex };
+							if (!exception) {
+								exception = std::current_exception();
+							}
+						}
+						// the remaining tasks are popped without being run
+						stopped = true;
+					}
 				}
-			
-				std::lock_guard lg{ taskCondMutex };
-				completed = true;
-			
-				tasks.clear(); // clear all tasks
-			
-				taskCondVar.notify_all();
+				task.func = nullptr;
+				EndTask();
 			}
+
+			currentMerger = nullptr;
 		}
 	public:
 		void Init() {
@@ -256,39 +324,46 @@ namespace actslib::data {
 
 			workers.reserve(workersCount);
 
-			auto& that = *this;
-
 			for (size_t i = 0; i < workersCount; i++) {
-				workers.emplace_back([&that] { that.HandleWorker(); });
+				workers.emplace_back([this, i] { HandleWorker(i); });
 			}
 		}
 
+		/*
+		 * Create and merge all the chunks
+		 * @return the merged chunk
+		 * @throws the first exception thrown by the config
+		 */
 		std::filesystem::path PushAndJoin() {
 			Init(); // Just in case
 
-			PushCreateChunkTask(true);
+			PushCreateChunkTask();
+			// release the workers, they can end once all the tasks are done
+			EndTask();
 
 			for (std::thread& th : workers) {
 				th.join();
 			}
 
 			if (exception) {
-				throw std::runtime_error(actslib::va("%s", exception));
+				std::rethrow_exception(exception);
 			}
 
-			if (chunks.size() > 1) {
+			if (chunksCount > 1) {
 				throw std::runtime_error("More than 1 chunk after a KMerger run");
 			}
 
-			if (chunks.empty()) {
-				std::filesystem::path dp = GetNewIdSyncPath();
-				cfg.CreateDefaultChunk(dp);
-				return dp;
+			for (std::vector<KMergerChunk>& lchunks : layers) {
+				if (!lchunks.empty()) {
+					return lchunks[0].file;
+				}
 			}
 
-			return chunks[0].file;
+			std::filesystem::path dp = GetNewIdSyncPath();
+			cfg.CreateDefaultChunk(dp);
+			return dp;
 		}
 	};
 
 
-}
\ No newline at end of file
+}
@@ -47,6 +47,15 @@ namespace actslib::profiler {
 			endTime = startTime = GetTimestamp();
 		}
 
+		/*
+		 * Ended section with name
+		 * @param name name
+		 * @param startTime start timestamp
+		 * @param endTime end timestamp
+		 */
+		ProfilerSection(std::string name, long long startTime, long long endTime) : startTime(startTime), endTime(endTime), name(name) {
+		}
+
 		/*
 		 * Read section from stream
 		 * @param is stream
@@ -150,6 +159,21 @@ namespace actslib::profiler {
 			current = &sections[sections.size() - 1];
 		}
 
+		/*
+		 * Add an ended sub section to the latest sub section or this section, can be used to write aggregated times
+		 * @param name sub section name
+		 * @param start start timestamp
+		 * @param end end timestamp
+		 * @return added section
+		 */
+		ProfilerSection& AddSection(std::string name, long long start, long long end) {
+			if (IsRunning()) {
+				return current->AddSection(name, start, end);
+			}
+
+			return sections.emplace_back(name, start, end);
+		}
+
 		/*
 		 * End the latest sub section or this section
 		 */
@@ -268,6 +292,17 @@ namespace actslib::profiler {
 			mainSec.PushSection(name);
 		}
 
+		/*
+		 * Add an ended section to the current section
+		 * @param name section's name
+		 * @param start start timestamp
+		 * @param end end timestamp
+		 * @return added section
+		 */
+		ProfilerSection& AddSection(std::string name, long long start, long long end) {
+			return mainSec.AddSection(name, start, end);
+		}
+
 		/*
 		 * End a section
 		 */
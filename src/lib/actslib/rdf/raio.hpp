@@ -110,7 +110,7 @@ namespace actslib::rdf::raio {
 		}
 	};
 
-	class CompressComponentReaderFile : public CompressComponentReader {
+	class CompressComponentReaderFile final : public CompressComponentReader {
 		std::ifstream stream;
 
 	public:
@@ -339,9 +339,8 @@ namespace actslib::rdf::raio {
 					}
 				};
 
-				actslib::data::iterator::AllocatedMergeAIterator<const rdf::raio::IdComponent, std::shared_ptr<rdf::raio::CompressComponentReaderFile>, IdCompComparator> merger{
-					readers, [](auto& e) { return e; }
-				};
+				// the readers are final, the merge isn't using virtual calls
+				actslib::data::iterator::LoserTreeMergeIterator<const rdf::raio::IdComponent, rdf::raio::CompressComponentReaderFile, IdCompComparator> merger{ readers };
 
 
 				std::filesystem::create_directories(chunkLocation);
@@ -29,4 +29,21 @@ namespace core::async {
 			}
 		}
 	};
+
+	template<typename Mutex>
+	class opt_shared_lock_guard {
+	private:
+		Mutex* lock;
+	public:
+		opt_shared_lock_guard(Mutex* lock) : lock(lock) {
+			if (lock) {
+				lock->lock_shared();
+			}
+		}
+		~opt_shared_lock_guard() {
+			if (lock) {
+				lock->unlock_shared();
+			}
+		}
+	};
 }
\ No newline at end of file
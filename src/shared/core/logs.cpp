@@ -6,6 +6,10 @@
 #include <utils/utils.hpp>
 
 namespace core::logs {
+	namespace {
+		thread_local std::vector<bufferedlog>* threadBuffer{};
+	}
+
 	std::mutex* getasyncmutex() {
 		if (core::async::IsSync(core::async::AT_LOGS)) {
 			static std::mutex mtx{};
@@ -66,6 +70,17 @@ namespace core::logs {
 	void addoutstream(std::ostream* outStream) {
 		core::shared_cfg::GetSharedConfig().log.outStream = outStream;
 	}
+	void setthreadbuffer(std::vector<bufferedlog>* buffer) {
+		threadBuffer = buffer;
+	}
+	std::vector<bufferedlog>* getthreadbuffer() {
+		return threadBuffer;
+	}
+	void flushbuffer(const std::vector<bufferedlog>& buffer) {
+		for (const bufferedlog& log : buffer) {
+			core::logs::log(log.level, log.header.empty() ? nullptr : log.header.data(), log.file.empty() ? nullptr : log.file.data(), log.line, log.str.data());
+		}
+	}
 	const char* logfile() {
 		return core::shared_cfg::GetSharedConfig().log.logfile;
 	}
@@ -92,6 +107,10 @@ namespace core::logs {
 	}
 
 	void log(loglevel level, const char* header, const char* file, size_t line, const char* str) {
+		if (threadBuffer) {
+			threadBuffer->push_back(bufferedlog{ level, header ? header : "", file ? file : "", line, str });
+			return;
+		}
 		core::shared_cfg::SharedCfg& cfg{ core::shared_cfg::GetSharedConfig() };
 
 		if (file && cfg.log.paths.size()) {
@@ -76,6 +76,29 @@ namespace core::logs {
 
 	void addoutstream(std::ostream* outStream);
 
+	struct bufferedlog {
+		loglevel level;
+		std::string header;
+		std::string file;
+		size_t line;
+		std::string str;
+	};
+
+	/*
+	 * Buffer the logs of the current thread instead of printing them, used to print the logs of parallel tasks in order
+	 * @param buffer buffer, nullptr to print the logs directly
+	 */
+	void setthreadbuffer(std::vector<bufferedlog>* buffer);
+	/*
+	 * @return the log buffer of the current thread, nullptr if the logs are printed directly
+	 */
+	std::vector<bufferedlog>* getthreadbuffer();
+	/*
+	 * Print buffered logs
+	 * @param buffer buffer
+	 */
+	void flushbuffer(const std::vector<bufferedlog>& buffer);
+
 	void log(loglevel level, const char* header, const char* file, size_t line, const char* str);
 	void log(loglevel level, const char* file, size_t line, const char* str);
 	inline void log(loglevel level, const char* header, const char* file, size_t line, const std::string& str) {
@@ -0,0 +1,172 @@
+#pragma once
+
+namespace core::memory_allocator {
+	struct MemoryAllocatorSlabStats {
+		size_t allocs{};
+		size_t frees{};
+		size_t liveBlocks{};
+		size_t liveBytes{};
+		size_t peakBytes{};
+		size_t pages{};
+		// blocks reused from a free list
+		size_t reused{};
+	};
+
+	/*
+	 * Growable allocator using references instead of pointers, the memory is allocated by pages that never move
+	 * and the freed blocks are kept in a free list per size class, the alloc and the free are O(1).
+	 * A reference is (page << PageShift) | offset, 0 is never returned.
+	 */
+	template<typename DataRefType = uint32_t, size_t PageShift = 16>
+	class MemoryAllocatorSlab {
+		static constexpr size_t PAGE_SIZE = 1ull << PageShift;
+		static constexpr size_t MAX_PAGES = (1ull << (sizeof(DataRefType) << 3)) >> PageShift;
+		static constexpr size_t GRANULARITY = 8;
+		static constexpr size_t CLASS_COUNT = 0x100;
+		static_assert(MAX_PAGES && "PageShift too big for DataRefType");
+
+	public:
+		// max size of a block
+		static constexpr size_t MAX_ALLOC_SIZE = GRANULARITY * CLASS_COUNT;
+
+	private:
+		struct alignas(GRANULARITY) BlockHeader {
+			uint16_t sizeClass;
+			uint16_t allocated;
+			DataRefType ref;
+		};
+		static_assert(sizeof(BlockHeader) == GRANULARITY);
+		static_assert(PAGE_SIZE >= MAX_ALLOC_SIZE + sizeof(BlockHeader) && "Page too small for the max block size");
+
+		std::vector<std::unique_ptr<byte[]>> pages{};
+		// location of the next block in the last page
+		size_t pageLoc{ PAGE_SIZE };
+		// first free block of each class, 0 for none, the next free block is stored in the block data
+		DataRefType freeLists[CLASS_COUNT]{};
+		size_t classCounts[CLASS_COUNT]{};
+		MemoryAllocatorSlabStats stats{};
+
+		static constexpr size_t SizeClass(size_t len) {
+			return len ? (len - 1) / GRANULARITY : 0;
+		}
+
+		static constexpr size_t ClassSize(size_t cls) {
+			return (cls + 1) * GRANULARITY;
+		}
+
+		BlockHeader* HeaderByRef(DataRefType ref) {
+			return (BlockHeader*)DataByRef(ref) - 1;
+		}
+
+		DataRefType AllocNewBlock(size_t cls) {
+			size_t len{ sizeof(BlockHeader) + ClassSize(cls) };
+
+			if (pageLoc + len > PAGE_SIZE) {
+				if (pages.size() == MAX_PAGES) {
+					throw std::runtime_error("Not enough data in the allocator");
+				}
+				pages.emplace_back(std::make_unique<byte[]>(PAGE_SIZE));
+				// the data of a block is after its header, so a ref is never 0
+				pageLoc = 0;
+				stats.pages++;
+			}
+
+			BlockHeader* header{ (BlockHeader*)(pages.back().get() + pageLoc) };
+			header->sizeClass = (uint16_t)cls;
+			header->ref = (DataRefType)(((pages.size() - 1) << PageShift) | (pageLoc + sizeof(BlockHeader)));
+			pageLoc += len;
+			return header->ref;
+		}
+
+	public:
+		MemoryAllocatorSlab() = default;
+		MemoryAllocatorSlab(const MemoryAllocatorSlab&) = delete;
+		MemoryAllocatorSlab& operator=(const MemoryAllocatorSlab&) = delete;
+
+		void* DataByRef(DataRefType ref) {
+			return pages[ref >> PageShift].get() + (ref & (PAGE_SIZE - 1));
+		}
+
+		DataRefType RefByData(void* ptr) {
+			return ((BlockHeader*)ptr - 1)->ref;
+		}
+
+		DataRefType AllocRef(size_t len) {
+			if (len > MAX_ALLOC_SIZE) {
+				throw std::runtime_error(utils::va("Can't allocate 0x%llx bytes in the allocator", len));
+			}
+
+			size_t cls{ SizeClass(len) };
+			DataRefType ref{ freeLists[cls] };
+
+			if (ref) {
+				freeLists[cls] = *(DataRefType*)DataByRef(ref);
+				stats.reused++;
+			}
+			else {
+				ref = AllocNewBlock(cls);
+			}
+
+			HeaderByRef(ref)->allocated = true;
+			classCounts[cls]++;
+			stats.allocs++;
+			stats.liveBlocks++;
+			stats.liveBytes += ClassSize(cls);
+			stats.peakBytes = std::max(stats.peakBytes, stats.liveBytes);
+			return ref;
+		}
+
+		void* Alloc(size_t len) {
+			return DataByRef(AllocRef(len));
+		}
+
+		template<typename T = void>
+		T* Alloc(size_t len) {
+			return (T*)DataByRef(AllocRef(sizeof(T) * len));
+		}
+
+		void FreeRef(DataRefType ref) {
+			BlockHeader* header{ HeaderByRef(ref) };
+			if (!header->allocated) {
+				throw std::runtime_error("Free of a non allocated block");
+			}
+			header->allocated = false;
+
+			size_t cls{ header->sizeClass };
+			*(DataRefType*)DataByRef(ref) = freeLists[cls];
+			freeLists[cls] = ref;
+
+			classCounts[cls]--;
+			stats.frees++;
+			stats.liveBlocks--;
+			stats.liveBytes -= ClassSize(cls);
+		}
+
+		void Free(void* ptr) {
+			FreeRef(RefByData(ptr));
+		}
+
+		const char* Alloc(const std::string& str) {
+			char* cstr = Alloc<char>(str.length() + 1);
+			std::memcpy(cstr, str.data(), str.length() + 1);
+			return cstr;
+		}
+
+		const MemoryAllocatorSlabStats& GetStats() const {
+			return stats;
+		}
+
+		/*
+		 * Get the live blocks of each size class
+		 * @param func function called with the block size and the number of live blocks of each used class
+		 */
+		template<typename Func>
+		void ForEachSizeClass(Func&& func) const {
+			for (size_t i = 0; i < CLASS_COUNT; i++) {
+				if (classCounts[i]) {
+					func(ClassSize(i), classCounts[i]);
+				}
+			}
+		}
+	};
+}
@@ -0,0 +1,88 @@
+#include <includes_shared.hpp>
+#include <utils/utils.hpp>
+#include <utils/hash.hpp>
+#include <utils/cache_utils.hpp>
+#include <thread>
+
+namespace utils::cache {
+	void CacheStats::Print() const {
+		size_t hit{ hits.load() };
+		size_t total{ hit + misses.load() };
+		LOG_INFO("Cache: {}/{} hit(s) ({}%), {} outdated, {} store(s), {} error(s), {}B read, {}B written",
+			hit, total, total ? hit * 100 / total : 0, outdated.load(), stores.load(), errors.load(),
+			utils::FancyNumber(bytesRead.load()), utils::FancyNumber(bytesWritten.load())
+		);
+	}
+
+	core::logs::bufferedlog CacheReader::ReadLog() {
+		core::logs::bufferedlog log{};
+		log.level = (core::logs::loglevel)Read<uint32_t>();
+		log.line = (size_t)Read<uint64_t>();
+		log.header = ReadString();
+		log.file = ReadString();
+		log.str = ReadString();
+		return log;
+	}
+
+	void WriteString(std::vector<byte>& buffer, const std::string_view& str) {
+		utils::WriteValue<uint64_t>(buffer, (uint64_t)str.length());
+		utils::WriteValue(buffer, (void*)str.data(), str.length());
+	}
+
+	void WriteLog(std::vector<byte>& buffer, const core::logs::bufferedlog& log) {
+		utils::WriteValue<uint32_t>(buffer, (uint32_t)log.level);
+		utils::WriteValue<uint64_t>(buffer, (uint64_t)log.line);
+		WriteString(buffer, log.header);
+		WriteString(buffer, log.file);
+		WriteString(buffer, log.str);
+	}
+
+	bool WriteEntry(const std::filesystem::path& path, const std::vector<byte>& buffer, CacheStats& stats) {
+		std::error_code ec{};
+		std::filesystem::create_directories(path.parent_path(), ec);
+
+		// unique name by process and thread
+		std::filesystem::path tmp{ path };
+		tmp += utils::va(".%lx.%llx.tmp", GetCurrentProcessId(), (uint64_t)std::hash<std::thread::id>{}(std::this_thread::get_id()));
+
+		if (!utils::WriteFile(tmp, buffer)) {
+			LOG_WARNING("Can't write cache entry {}", tmp.string());
+			stats.errors++;
+			return false;
+		}
+
+		std::filesystem::rename(tmp, path, ec);
+		if (ec) {
+			LOG_WARNING("Can't write cache entry {}: {}", path.string(), ec.message());
+			std::filesystem::remove(tmp, ec);
+			stats.errors++;
+			return false;
+		}
+
+		stats.stores++;
+		stats.bytesWritten += buffer.size();
+		return true;
+	}
+
+	bool HashBuild(uint64_t& key) {
+		key = hash::Hash64Value(key, (uint64_t)core::actsinfo::VERSION_ID);
+		if constexpr (core::actsinfo::VERSION_ID != core::actsinfo::DEV_VERSION_ID) {
+			return true;
+		}
+
+		std::filesystem::path prog{ utils::GetProgPath() };
+		std::error_code ec{};
+		uintmax_t progSize{ std::filesystem::file_size(prog, ec) };
+		std::filesystem::file_time_type progTime{};
+		if (!ec) progTime = std::filesystem::last_write_time(prog, ec);
+
+		if (ec) {
+			LOG_WARNING("Can't read the build of {}: {}", prog.string(), ec.message());
+			return false;
+		}
+
+		key = hash::Hash64Value(key, (uint64_t)progSize);
+		key = hash::Hash64Value(key, (uint64_t)progTime.time_since_epoch().count());
+		return true;
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <atomic>
+
+namespace utils::cache {
+	// Stats of a cache, they can be updated by multiple threads
+	struct CacheStats {
+		std::atomic<size_t> hits{};
+		std::atomic<size_t> misses{};
+		// entries found, but not matching the current run
+		std::atomic<size_t> outdated{};
+		std::atomic<size_t> stores{};
+		std::atomic<size_t> errors{};
+		std::atomic<size_t> bytesRead{};
+		std::atomic<size_t> bytesWritten{};
+
+		/*
+		 * Print the stats
+		 */
+		void Print() const;
+	};
+
+	// Reader of a cache entry, a std::runtime_error is thrown if the entry is truncated
+	class CacheReader {
+		const byte* data;
+		size_t size;
+		size_t loc{};
+	public:
+		CacheReader(const std::string& buffer) : data((const byte*)buffer.data()), size(buffer.size()) {}
+
+		template<typename Type>
+		Type Read() {
+			if (loc + sizeof(Type) > size) {
+				throw std::runtime_error("truncated entry");
+			}
+			Type val;
+			std::memcpy(&val, data + loc, sizeof(val));
+			loc += sizeof(val);
+			return val;
+		}
+
+		const byte* ReadBuffer(size_t len) {
+			if (len > size - loc) {
+				throw std::runtime_error("truncated buffer");
+			}
+			const byte* ptr{ data + loc };
+			loc += len;
+			return ptr;
+		}
+
+		std::string ReadString() {
+			uint64_t len{ Read<uint64_t>() };
+			return { reinterpret_cast<const char*>(ReadBuffer((size_t)len)), (size_t)len };
+		}
+
+		core::logs::bufferedlog ReadLog();
+	};
+
+	/*
+	 * Write a string, it can be read with CacheReader::ReadString
+	 * @param buffer buffer
+	 * @param str string
+	 */
+	void WriteString(std::vector<byte>& buffer, const std::string_view& str);
+
+	/*
+	 * Write a log, it can be read with CacheReader::ReadLog
+	 * @param buffer buffer
+	 * @param log log
+	 */
+	void WriteLog(std::vector<byte>& buffer, const core::logs::bufferedlog& log);
+
+	/*
+	 * Write a cache entry into a temp file and rename it, another thread or process can read the same entry
+	 * @param path entry path
+	 * @param buffer entry data
+	 * @param stats stats to update
+	 * @return true if the entry was written
+	 */
+	bool WriteEntry(const std::filesystem::path& path, const std::vector<byte>& buffer, CacheStats& stats);
+
+	/*
+	 * Add the running build to a cache key, the dev builds are all using the same version id, the size and the
+	 * write time of the executable are used instead, they are changed by a rebuild of any translation unit
+	 * @param key key to update
+	 * @return false if the executable can't be read
+	 */
+	bool HashBuild(uint64_t& key);
+}
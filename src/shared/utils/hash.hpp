@@ -130,6 +130,36 @@ namespace hash {
 		return Hash64(str.data(), start, iv);
 	}
 
+	/*
+	 * Compute the hash64 on a raw buffer (fnva1), no formatting is applied
+	 * @param data buffer
+	 * @param len buffer size
+	 * @param start Start value, can be a previous hash to concatenate hashes
+	 * @return Hashed value
+	 */
+	inline uint64_t Hash64Buffer(const void* data, size_t len, uint64_t start = FNV1A_PRIME, uint64_t iv = IV_DEFAULT) {
+		uint64_t hash = start;
+
+		const uint8_t* ptr = static_cast<const uint8_t*>(data);
+		for (size_t i = 0; i < len; i++) {
+			hash = (hash ^ ptr[i]) * iv;
+		}
+
+		return hash;
+	}
+
+	/*
+	 * Concatenate a value to a hash64 computed with Hash64Buffer
+	 * @param hash previous hash
+	 * @param value value to add
+	 * @return Hashed value
+	 */
+	template<typename Type>
+	inline uint64_t Hash64Value(uint64_t hash, Type value) {
+		static_assert(std::is_trivially_copyable_v<Type>, "Type should be trivially copyable");
+		return Hash64Buffer(&value, sizeof(value), hash);
+	}
+
 	constexpr bool TryHashPattern(const char* str, uint64_t& outVal) {
 		std::string_view v{ str };
 
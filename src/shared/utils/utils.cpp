@@ -25,8 +25,8 @@ namespace utils {
     }
 
     char* vap(const char* fmt, va_list ap) {
-        static char buffer[0x10][0x500];
-        static size_t bufferIndex = 0;
+        static thread_local char buffer[0x10][0x500];
+        static thread_local size_t bufferIndex = 0;
         bufferIndex = (bufferIndex + 1) % ARRAYSIZE(buffer);
         auto& buff = buffer[bufferIndex];
 
@@ -315,9 +315,12 @@ namespace utils {
     }
 
     std::filesystem::path GetProgDir() {
+        return GetProgPath().parent_path();
+    }
+    std::filesystem::path GetProgPath() {
         wchar_t szFileName[MAX_PATH];
         GetModuleFileNameW(NULL, szFileName, MAX_PATH);
-        return std::filesystem::absolute(szFileName).parent_path();
+        return std::filesystem::absolute(szFileName);
     }
     int64_t ParseFormatInt(const char* number) {
         if (!number || !*number) {
@@ -392,6 +392,10 @@ namespace utils {
 	 * @return prog exe directory
 	 */
 	std::filesystem::path GetProgDir();
+	/*
+	 * @return prog exe path
+	 */
+	std::filesystem::path GetProgPath();
 
 	/*
 	 * Parse a number considering format (0xYYYY = 16, 0bYYYY = 2, 0YYYY = 8)
@@ -23,7 +23,55 @@ namespace acts::vm {
 		}
 		return utils::va("UNKNOWN:%d", (int)type);
 	}
-	ActsVm::ActsVm(ActsVmConfig cfg) : cfg(cfg) {
+
+	namespace {
+		// comparators of the wait min heaps
+		bool TimedWaitAfter(const VmTimedWait& a, const VmTimedWait& b) {
+			return a.time > b.time || (a.time == b.time && a.id > b.id);
+		}
+
+		bool FrameWaitAfter(const VmFrameWait& a, const VmFrameWait& b) {
+			return a.frame > b.frame || (a.frame == b.frame && a.id > b.id);
+		}
+	}
+	ActsVm::ActsVm(ActsVmConfig cfg) : cfg(cfg), frameTime(utils::GetTimestamp()) {
+		freeThreads.reserve(VM_MAX_THREADS);
+		for (size_t i = 0; i < VM_MAX_THREADS; i++) {
+			VmRef id{ (VmRef)(VM_MAX_THREADS - i - 1) };
+			threads[id].threadId = id;
+			freeThreads.push_back(id);
+		}
+#ifdef ACTS_VM_PROFILER
+		if (cfg.profile) {
+			profiler = std::make_unique<VmProfiler>(cfg.profileSampleRate);
+		}
+#endif
+	}
+
+	ActsVm::~ActsVm() {
+		// the heap is freed with the vm, only the data of the arrays is allocated outside of it
+		for (VmArrayData* data : liveArrays) {
+			delete data;
+		}
+	}
+
+	void VmExecutionThread::GrowStack(size_t count) {
+		size_t used{ (size_t)(top - stack.get()) };
+		if (used + count > VM_MAX_STACK) {
+			throw std::runtime_error("Invalid push: too much data");
+		}
+
+		size_t size{ std::max<size_t>(stackEnd - stack.get(), VM_MIN_STACK) };
+		while (size < used + count) {
+			size <<= 1;
+		}
+		size = std::min(size, VM_MAX_STACK);
+
+		std::unique_ptr<VmVar[]> newStack{ std::make_unique<VmVar[]>(size) };
+		std::memcpy(newStack.get(), stack.get(), used * sizeof(VmVar));
+		stack = std::move(newStack);
+		stackEnd = stack.get() + size;
+		top = stack.get() + used;
 	}
 
 	void ActsVm::AssertThreadStarted() {
@@ -31,36 +79,142 @@ namespace acts::vm {
 	}
 
 	VmExecutionThread* ActsVm::AllocThread(byte* codePos) {
-		for (VmExecutionThread& thread : threads) {
-			if (thread.running) continue;
+		if (freeThreads.empty()) {
+			Error("Can't alloc thread", true);
+			return nullptr;
+		}
 
-			thread.stack[0].type = VT_THREAD;
-			thread.stack[0].val.ref = thread.threadId;
-			thread.top = thread.stack + 1;
-			thread.waitTime = 0;
-			thread.waitFrameTime = 0;
-			thread.running = true;
-			thread.codePos = codePos;
-			return currentThread;
+		VmExecutionThread& thread{ threads[freeThreads.back()] };
+		freeThreads.pop_back();
+
+		if (!thread.stack) {
+			thread.stack = std::make_unique<VmVar[]>(VM_MIN_STACK);
+			thread.stackEnd = thread.stack.get() + VM_MIN_STACK;
 		}
-		Error("Can't alloc thread", true);
-		return nullptr;
+		thread.stack[0].SetRef(VT_THREAD, thread.threadId);
+		thread.top = thread.stack.get() + 1;
+		thread.state = VTS_READY;
+		thread.codePos = codePos;
+		auto it{ decodedExports.find(codePos) };
+		thread.ip = it != decodedExports.end() ? it->second.data() : nullptr;
+		ACTS_VM_PROFILE(this, EnterFunction(thread.threadId, codePos));
+		return &thread;
 	}
 
-	void ActsVm::Execute() {
-		AssertThreadStarted();
-		if (currentThread->waitFrameTime > 0) {
-			if (--currentThread->waitFrameTime) {
-				return; // wait using waitframe()
+	VmExecutionThread* ActsVm::StartThread(byte* codePos) {
+		VmExecutionThread* thread{ AllocThread(codePos) };
+		readyThreads.push_back(thread->threadId);
+		return thread;
+	}
+
+	void ActsVm::ReadyThread(VmExecutionThread* thread) {
+		thread->state = VTS_READY;
+		readyThreads.push_back(thread->threadId);
+	}
+
+	void ActsVm::Wait(VmExecutionThread* thread, utils::Timestamp time) {
+		thread->state = VTS_WAIT_TIME;
+		timedWaits.push_back(VmTimedWait{ frameTime + std::max<utils::Timestamp>(time, 0), waitId++, thread->threadId });
+		std::push_heap(timedWaits.begin(), timedWaits.end(), TimedWaitAfter);
+	}
+
+	void ActsVm::WaitFrames(VmExecutionThread* thread, uint64_t frames) {
+		thread->state = VTS_WAIT_FRAME;
+		frameWaits.push_back(VmFrameWait{ frame + std::max<uint64_t>(frames, 1), waitId++, thread->threadId });
+		std::push_heap(frameWaits.begin(), frameWaits.end(), FrameWaitAfter);
+	}
+
+	void ActsVm::RunFrame(utils::Timestamp now) {
+		frame++;
+		frameTime = now;
+
+		// only the threads to wake up are visited
+		while (!frameWaits.empty() && frameWaits.front().frame <= frame) {
+			std::pop_heap(frameWaits.begin(), frameWaits.end(), FrameWaitAfter);
+			ReadyThread(&threads[frameWaits.back().thread]);
+			frameWaits.pop_back();
+		}
+		while (!timedWaits.empty() && timedWaits.front().time <= now) {
+			std::pop_heap(timedWaits.begin(), timedWaits.end(), TimedWaitAfter);
+			ReadyThread(&threads[timedWaits.back().thread]);
+			timedWaits.pop_back();
+		}
+
+		VmExecutionThread* prev{ currentThread };
+		utils::CloseEnd ce{ [this, prev] { currentThread = prev; } };
+
+		// the releases are done between the threads, with a budget for the whole frame
+		size_t budget{ cfg.releaseFrameBudget };
+		budget -= ReleasePending(budget);
+
+		// the threads started during the frame are run in the next frame
+		for (size_t count{ readyThreads.size() }; count; count--) {
+			currentThread = &threads[readyThreads.front()];
+			readyThreads.pop_front();
+			Execute();
+			budget -= ReleasePending(budget);
+		}
+
+		releaseStats.lastFrame = cfg.releaseFrameBudget - budget;
+	}
+
+	size_t ActsVm::ReleasePending(size_t budget) {
+		size_t work{};
+		while (work < budget && !releaseQueue.empty()) {
+			VmRef ref{ releaseQueue.front() };
+			// the pages don't move, the nested arrays are added to the queue
+			VmArray* v{ (VmArray*)alloc.DataByRef(ref) };
+			VmVar val;
+			while (work < budget && v->data->PopValue(&val)) {
+				ReleaseVariable(&val);
+				work++;
 			}
+			if (v->data->Size() || work >= budget) {
+				break; // budget reached
+			}
+			FreeArrayData(v->data);
+			alloc.FreeRef(ref);
+			releaseQueue.pop_front();
+			work++;
+		}
+		releaseStats.released += work;
+		return work;
+	}
+
+	VmRef ActsVm::AllocHeap(size_t len) {
+		if (releaseQueue.empty()) {
+			return alloc.AllocRef(len);
+		}
+
+		ReleasePending(cfg.releaseAllocBudget);
+		try {
+			return alloc.AllocRef(len);
 		}
-		else if (currentThread->waitFrameTime) {
-			if (currentThread->waitFrameTime <= utils::GetTimestamp()) {
-				return; // wait using wait()
+		catch (std::runtime_error&) {
+			// the heap is full, free all the pending releases before failing
+			if (releaseQueue.empty()) {
+				throw;
 			}
-			else {
-				currentThread->waitFrameTime = 0;
+			ReleasePending();
+			return alloc.AllocRef(len);
+		}
+	}
+
+	void ActsVm::Execute() {
+		AssertThreadStarted();
+		currentThread->state = VTS_RUNNING;
+
+		if (currentThread->ip) {
+			VmInstruction* ip{ currentThread->ip };
+			do {
+				ACTS_VM_PROFILE(this, OnInstruction(currentThread->threadId, ip->opcode, ip->codePos));
+				ip = ip->handler(this, currentThread, ip);
+			} while (ip);
+
+			if (currentThread->state != VTS_RUNNING) {
+				return; // ended or waiting
 			}
+			// end of the predecoded code, continue with the raw bytecode
 		}
 
 		bool terminated{};
@@ -70,19 +224,21 @@ namespace acts::vm {
 			opcodes::OpCode op{ *base };
 			currentThread->codePos = (byte*)(base + 1);
 
+			ACTS_VM_PROFILE(this, OnInstruction(currentThread->threadId, op, (byte*)base));
 			opcodes::HandleOpCode(op, this, currentThread, &terminated);
 		}
 	}
 
 	void ActsVm::IncRef(VmVar* var) {
-		switch (var->type) {
-		case VT_ARRAY: {
-			VmArray* v{ (VmArray*)alloc.DataByRef(var->val.ref) };
+		switch (var->GetType()) {
+		case VT_ARRAY:
+		case VT_STRUCT: {
+			VmArray* v{ (VmArray*)alloc.DataByRef(var->GetRef()) };
 			v->ref++;
 			break;
 		}
 		case VT_VECTOR: {
-			VmVector* v{ (VmVector*)alloc.DataByRef(var->val.ref) };
+			VmVector* v{ (VmVector*)alloc.DataByRef(var->GetRef()) };
 			v->ref++;
 			break;
 		}
@@ -90,31 +246,22 @@ namespace acts::vm {
 	}
 
 	void ActsVm::DecRef(VmVar* var) {
-		switch (var->type) {
-		case VT_ARRAY: {
-			VmArray* v{ (VmArray*)alloc.DataByRef(var->val.ref) };
+		switch (var->GetType()) {
+		case VT_ARRAY:
+		case VT_STRUCT: {
+			VmArray* v{ (VmArray*)alloc.DataByRef(var->GetRef()) };
 
 			if (!(--v->ref)) {
-				// cleanup all nodes
-
-				VmRef node{ v->start };
-				while (node) {
-					VmArrayNode* v{ (VmArrayNode*)alloc.DataByRef(node) };
-					ReleaseVariable(&v->idx);
-					ReleaseVariable(&v->var);
-					VmRef next = v->next;
-					alloc.FreeRef(node);
-					node = next;
-				}
-				alloc.FreeRef(var->val.ref);
+				// the values are released by the release queue to avoid long pauses with the big arrays
+				releaseQueue.push_back(var->GetRef());
 			}
 			break;
 		}
 		case VT_VECTOR: {
-			VmVector* v{ (VmVector*)alloc.DataByRef(var->val.ref) };
+			VmVector* v{ (VmVector*)alloc.DataByRef(var->GetRef()) };
 
 			if (!(--v->ref)) {
-				alloc.FreeRef(var->val.ref);
+				alloc.FreeRef(var->GetRef());
 			}
 			break;
 		}
@@ -123,54 +270,56 @@ namespace acts::vm {
 
 	void ActsVm::ReleaseVariable(VmVar* var) {
 		DecRef(var);
-		var->val.i = 0;
-		var->type = VT_UNDEFINED;
+		var->SetUndefined();
 	}
 
 	bool ActsVm::GetFunctionInfo(byte* codePos, ScriptExport** exp, ActScript** script) {
-		for (ScriptInfo& nfo : scripts) {
-			if (!nfo.script->IsInScript(codePos)) {
-				if (script) *script = nfo.script;
-				uint32_t rloc = (uint32_t)(codePos - nfo.script->magic);
-
-				if (exp) {
-					*exp = nullptr;
-					ScriptExport* e{ nfo.script->Exports() };
-					ScriptExport* ee{ nfo.script->ExportsEnd() };
-
-					while (e != ee) {
-						if (
-							e->address > rloc // too far
-							&& (!*exp || (*exp)->address >= e->address) // before previous
-							) {
-							*exp = e;
-						}
-					}
-
-					return *exp;
-				}
+		if (!exportRangesSorted) {
+			std::sort(exportRanges.begin(), exportRanges.end(), [](const VmExportRange& a, const VmExportRange& b) { return a.start < b.start; });
+			exportRangesSorted = true;
+		}
 
-				return true;
-			}
+		// last range starting before codePos, the end is included for the location after the last opcode
+		auto it{ std::upper_bound(exportRanges.begin(), exportRanges.end(), codePos, [](byte* loc, const VmExportRange& range) { return loc < range.start; }) };
+		if (it == exportRanges.begin() || codePos > (--it)->end) {
+			return false;
 		}
 
-		return false;
+		if (exp) *exp = it->exp;
+		if (script) *script = it->script;
+		return true;
 	}
+	std::string ActsVm::GetFunctionName(byte* codePos) {
+		ScriptExport* exp{};
+		ActScript* script{};
+		if (!GetFunctionInfo(codePos, &exp, &script)) {
+			return std::format("{}", (void*)codePos);
+		}
+		return std::format("{}<{}>::{}", cfg.hashToString(exp->name_space), cfg.hashToString(script->name), cfg.hashToString(exp->name));
+	}
+
 	void ActsVm::CleanupThread(VmExecutionThread* thread) {
-		// todo
+		while (thread->top > thread->stack.get() + 1) {
+			ReleaseVariable(--thread->top);
+		}
+		ACTS_VM_PROFILE(this, LeaveThread(thread->threadId));
+		thread->ip = nullptr;
+		thread->state = VTS_FREE;
+		freeThreads.push_back(thread->threadId);
 	}
 
 	bool ActsVm::CastToBool(VmVar* var) {
-		if (var->type == VT_INTEGER) {
-			var->val.i = var->val.i != 0;
-			return var->val.i;
+		if (var->IsInteger()) {
+			bool b{ var->GetInteger() != 0 };
+			var->SetInteger(b);
+			return b;
 		}
-		if (var->type == VT_FLOAT) {
-			var->type = VT_INTEGER;
-			var->val.i = var->val.f != 0;
-			return var->val.i;
+		if (var->IsFloat()) {
+			bool b{ var->GetFloat() != 0 };
+			var->SetInteger(b);
+			return b;
 		}
-		Error(utils::va("Can't cast var to bool: type %s", VmVarTypeName(var->type)), false);
+		Error(utils::va("Can't cast var to bool: type %s", VmVarTypeName(var->GetType())), false);
 		ReleaseVariable(var);
 		return false;
 	}
@@ -180,7 +329,7 @@ namespace acts::vm {
 			ScriptExport* exp{};
 			ActScript* script{};
 			if (GetFunctionInfo(currentThread->codePos, &exp, &script)) {
-				msg = utils::va("\n[%s<%s>::%s]", this->cfg.hashToString(exp->name_space), cfg.hashToString(script->name), cfg.hashToString(exp->name));
+				msg = utils::va("%s\n[%s<%s>::%s]", msg, this->cfg.hashToString(exp->name_space), cfg.hashToString(script->name), cfg.hashToString(exp->name));
 			}
 		}
 		if (terminate) {
@@ -194,8 +343,11 @@ namespace acts::vm {
 	VmVar* ActsVm::PushStack(size_t count) {
 		AssertThreadStarted();
 		if (!count) return currentThread->top;
-		if (currentThread->top + count > &currentThread->stack[ARRAYSIZE(currentThread->stack)]) {
-			Error("Invalid push: too much data", true);
+		if (currentThread->top + count > currentThread->stackEnd) {
+			if (currentThread->top + count > currentThread->stack.get() + VM_MAX_STACK) {
+				Error("Invalid push: too much data", true);
+			}
+			currentThread->GrowStack(count);
 		}
 		VmVar* ptr = currentThread->top;
 		currentThread->top += count;
@@ -205,7 +357,7 @@ namespace acts::vm {
 	void ActsVm::PopStack(size_t count) {
 		AssertThreadStarted();
 		if (!count) return;
-		if (currentThread->top - count < &currentThread->stack[0]) {
+		if (currentThread->top - count < currentThread->stack.get()) {
 			Error("Invalid pop: not enough data", true);
 		}
 
@@ -214,46 +366,122 @@ namespace acts::vm {
 
 	void ActsVm::AddInt(int64_t val) {
 		VmVar* ptr = PushStack();
-		ptr->type = VT_INTEGER;
-		ptr->val.i = val;
+		ptr->SetInteger(val);
 	}
 
 	void ActsVm::AddFloat(float val) {
 		VmVar* ptr = PushStack();
-		ptr->type = VT_FLOAT;
-		ptr->val.f = val;
+		ptr->SetFloat(val);
 	}
 
 	void ActsVm::AddHash(uint64_t val) {
 		VmVar* ptr = PushStack();
-		ptr->type = VT_HASH;
-		ptr->val.hash = val;
+		ptr->SetHash(val);
+	}
+
+	VmRef ActsVm::CreateArray() {
+		VmRef ref{ AllocHeap(sizeof(VmArray)) };
+		// the blocks are reused
+		VmArrayData* data{ new VmArrayData{} };
+		data->liveIndex = liveArrays.size();
+		liveArrays.push_back(data);
+		new (alloc.DataByRef(ref)) VmArray{ 0, data };
+		return ref;
+	}
+
+	void ActsVm::FreeArrayData(VmArrayData* data) {
+		VmArrayData* last{ liveArrays.back() };
+		last->liveIndex = data->liveIndex;
+		liveArrays[data->liveIndex] = last;
+		liveArrays.pop_back();
+		delete data;
 	}
 
 	void ActsVm::AddArray() {
-		VmRef ref{ alloc.AllocRef(sizeof(VmArray)) };
 		VmVar* ptr = PushStack();
-		ptr->type = VT_ARRAY;
-		ptr->val.ref = ref;
+		ptr->SetRef(VT_ARRAY, CreateArray());
 		IncRef(ptr);
 	}
 
+	VmArrayData* ActsVm::GetArrayData(VmVar* array) {
+		VmVarType type{ array->GetType() };
+		if (type != VT_ARRAY && type != VT_STRUCT) {
+			Error(utils::va("Not an array: type %s", VmVarTypeName(type)), true);
+		}
+		return ((VmArray*)alloc.DataByRef(array->GetRef()))->data;
+	}
+
+	VmVar* ActsVm::ArrayGet(VmVar* array, VmVar* key) {
+		VmArrayData* data{ GetArrayData(array) };
+		if (!VmArrayData::IsValidKey(*key)) {
+			Error(utils::va("Invalid array key: type %s", VmVarTypeName(key->GetType())), false);
+			return nullptr;
+		}
+		return data->Find(*key);
+	}
+
+	void ActsVm::ArraySet(VmVar* array, VmVar* key, VmVar* value) {
+		VmArrayData* data{ GetArrayData(array) };
+		if (!VmArrayData::IsValidKey(*key)) {
+			Error(utils::va("Invalid array key: type %s", VmVarTypeName(key->GetType())), false);
+			ReleaseVariable(value);
+			return;
+		}
+
+		VmVar old{};
+		if (value->IsUndefined()) {
+			data->Remove(*key, &old);
+		}
+		else {
+			VmVar* slot{ data->FindOrInsert(*key) };
+			old = *slot;
+			*slot = *value;
+			value->SetUndefined();
+		}
+		// released after the set, the old value can own the array
+		ReleaseVariable(&old);
+	}
+
+	bool ActsVm::ArrayFirstKey(VmVar* array, VmArrayCursor* cursor, VmVar* key) {
+		return GetArrayData(array)->FirstKey(cursor, key);
+	}
+
+	bool ActsVm::ArrayNextKey(VmVar* array, VmArrayCursor* cursor, VmVar* key) {
+		return GetArrayData(array)->NextKey(cursor, key);
+	}
+
+	size_t ActsVm::ArraySize(VmVar* array) {
+		return GetArrayData(array)->Size();
+	}
+
 	void ActsVm::AddStruct() {
 		AddArray(); // wip?
 	}
 
 	void ActsVm::AddVector(float* vec) {
-		VmRef ref{ alloc.AllocRef(sizeof(VmVector)) };
+		VmRef ref{ AllocHeap(sizeof(VmVector)) };
 
-		VmVector* v{ (VmVector*)alloc.DataByRef(ref) };
+		VmVector* v{ new (alloc.DataByRef(ref)) VmVector{} };
 		std::memcpy(v->vec, vec, sizeof(v->vec));
 
 		VmVar* ptr = PushStack();
-		ptr->type = VT_VECTOR;
-		ptr->val.ref = ref;
+		ptr->SetRef(VT_VECTOR, ref);
 		IncRef(ptr);
 	}
 
+	void ActsVm::PrintAllocStats() const {
+		const core::memory_allocator::MemoryAllocatorSlabStats& stats{ alloc.GetStats() };
+		LOG_INFO("VM heap: {} live block(s), {}B live, {}B peak, {} page(s), {} alloc(s) ({} reused), {} free(s)",
+			stats.liveBlocks, stats.liveBytes, stats.peakBytes, stats.pages, stats.allocs, stats.reused, stats.frees
+		);
+		alloc.ForEachSizeClass([](size_t size, size_t count) {
+			LOG_INFO("- {}B: {} block(s)", size, count);
+		});
+		LOG_INFO("VM releases: {} pending array(s), {} released value(s), {} in the last frame",
+			releaseQueue.size(), releaseStats.released, releaseStats.lastFrame
+		);
+	}
+
 	void ActsVm::LoadScript(uint64_t name) {
 		linkGroup++;
 
@@ -267,15 +495,67 @@ namespace acts::vm {
 
 			ScriptExport* exports = nfo.script->Exports();
 
-			while (exports != nfo.script->ExportsEnd()) {
+			for (; exports != nfo.script->ExportsEnd(); exports++) {
 				if (exports->flags & ScriptExportFlags::SEF_AUTOEXEC) {
-					currentThread = AllocThread(nfo.script->magic + exports->address);
-					Execute();
+					RunThread(nfo.script->magic + exports->address);
 				}
 			}
 		}
 	}
+
+	void ActsVm::RunThread(byte* codePos) {
+		VmExecutionThread* prev{ currentThread };
+		utils::CloseEnd ce{ [this, prev] { currentThread = prev; } };
+		currentThread = AllocThread(codePos);
+		Execute();
+	}
+
+	bool ActsVm::IsPredecoded(byte* codePos) const {
+		return decodedExports.contains(codePos);
+	}
+
+	void ActsVm::LinkExports(ActScript* script) {
+		// an export is ending at the next export
+		std::vector<ScriptExport*> exports{};
+		exports.reserve(script->exports_count);
+		for (ScriptExport* exp{ script->Exports() }; exp != script->ExportsEnd(); exp++) {
+			exports.push_back(exp);
+		}
+		std::sort(exports.begin(), exports.end(), [](ScriptExport* a, ScriptExport* b) { return a->address < b->address; });
+
+		byte* csegEnd{ script->magic + script->cseg_offset + script->cseg_size };
+		for (size_t i = 0; i < exports.size(); i++) {
+			if (i + 1 < exports.size() && exports[i + 1]->address == exports[i]->address) {
+				continue; // same code, the last export is used
+			}
+			byte* start{ script->magic + exports[i]->address };
+			byte* end{ i + 1 < exports.size() ? script->magic + exports[i + 1]->address : csegEnd };
+			if (start >= end) {
+				continue;
+			}
+
+			exportRanges.push_back(VmExportRange{ start, end, exports[i], script });
+			exportRangesSorted = false;
+
+			if (!cfg.predecode) {
+				continue;
+			}
+
+			std::vector<VmInstruction> code{};
+			if (opcodes::PredecodeExport(this, start, end, code)) {
+				decodedExports[start] = std::move(code);
+			}
+			else {
+				LOG_TRACE("Can't predecode export 0x{:x} of {}, using raw bytecode", exports[i]->address, cfg.hashToString(script->name));
+			}
+		}
+	}
+
 	int ActsVm::LinkScript(uint64_t name) {
+		if (scriptsByName.contains(name)) {
+			return ActsVmLinkOutput::VMLO_NOTHING; // already linked
+		}
+
 		ActScript* script = cfg.getterFunction(name);
 
 		if (!script) {
@@ -288,12 +568,7 @@ namespace acts::vm {
 			return ActsVmLinkOutput::VMLO_CANT_FIND;
 		}
 
-		auto itf = std::find_if(scripts.begin(), scripts.end(), [name](ScriptInfo& info) { return info.script->name == name; });
-
-		if (itf != scripts.end()) {
-			return ActsVmLinkOutput::VMLO_NOTHING; // already linked
-		}
-
+		scriptsByName[name] = scripts.size();
 		ScriptInfo& nfo = scripts.emplace_back();
 		nfo.script = script;
 		nfo.group = linkGroup;
@@ -308,6 +583,8 @@ namespace acts::vm {
 
 		// TODO: link functions, strings, globals, etc.
 
+		LinkExports(script);
+
 		return 1 + script->includes_count;
 	}
 }
@@ -1,5 +1,6 @@
 #pragma once
-#include <core/memory_allocator_static.hpp>
+#include <core/memory_allocator_slab.hpp>
+#include <bit>
 namespace acts::vm {
 	constexpr uint64_t ACTSCRIPT_MAGIC = 0x4d565354434124F1;
 
@@ -52,6 +53,46 @@ namespace acts::vm {
 
 	typedef uint32_t VmRef;
 
+	class ActsVm;
+	struct VmExecutionThread;
+	struct VmInstruction;
+	// predecoded instruction handler, returns the next instruction or nullptr to stop the execution
+	typedef VmInstruction* (*VmInstructionHandler)(ActsVm* vm, VmExecutionThread* thread, VmInstruction* ins);
+
+	// instruction predecoded at link time, the operands are read and the jump targets resolved
+	struct VmInstruction {
+		VmInstructionHandler handler;
+		union {
+			int64_t i;
+			float f;
+			uint64_t hash;
+			VmInstruction* target;
+		} operand;
+		// raw bytecode location, used for the errors and to continue with the raw bytecode
+		byte* codePos;
+#ifdef ACTS_VM_PROFILER
+		// raw opcode, VM_PROFILER_NO_OPCODE if the instruction isn't counted
+		uint16_t opcode;
+#endif
+	};
+
+	// code of an export, used to find the function of a code location
+	struct VmExportRange {
+		byte* start;
+		byte* end;
+		ScriptExport* exp;
+		ActScript* script;
+	};
+
+	struct VmReleaseStats {
+		// released arrays waiting to be freed
+		size_t pending{};
+		// values freed by the release queue
+		size_t released{};
+		// values freed during the last frame
+		size_t lastFrame{};
+	};
+
 	struct ScriptInfo {
 		ActScript* script;
 		int group;
@@ -61,6 +102,18 @@ namespace acts::vm {
 		std::function<ActScript* (uint64_t name)> getterFunction;
 		std::function<const char* (uint64_t hash)> hashToString;
 		bool enabledDevBlocks{};
+		// predecode the exports at link time, otherwise the raw bytecode is interpreted
+		bool predecode{ true };
+		// values of the released arrays freed per frame, counted in values and not in time to keep the frames deterministic
+		size_t releaseFrameBudget{ 0x1000 };
+		// values freed by each heap allocation while releases are pending, so the heap doesn't grow because of them
+		size_t releaseAllocBudget{ 0x10 };
+#ifdef ACTS_VM_PROFILER
+		// count the executed instructions and sample the code locations
+		bool profile{};
+		// instructions between 2 samples
+		uint64_t profileSampleRate{ 0x100 };
+#endif
 	};
 
 	enum ActsVmLinkOutput : int {
@@ -84,6 +137,58 @@ namespace acts::vm {
 
 	const char* VmVarTypeName(VmVarType type);
 
+#ifdef ACTS_VM_PACKED_VAR
+	/*
+	 * Packed var, the type is stored in the low bits of the value:
+	 * - xx1: hash, the hashes are stored on 63 bits
+	 * - x10: integer, the integers are stored on 62 bits
+	 * - x00: other types, the type is stored in [2, 6[ and the value (float or ref) in the high 32 bits
+	 * A null var is undefined.
+	 */
+	class VmVar {
+		static constexpr uint64_t TAG_HASH = 1;
+		static constexpr uint64_t TAG_INTEGER = 2;
+		static constexpr uint64_t TAG_MASK = 3;
+		static constexpr uint64_t TYPE_SHIFT = 2;
+		static constexpr uint64_t TYPE_MASK = 0xF;
+		static constexpr uint64_t VALUE_SHIFT = 32;
+		static_assert(VT_STRUCT <= TYPE_MASK, "too many types for the packed var");
+
+		uint64_t data{};
+
+	public:
+		static constexpr int64_t INTEGER_MIN = INT64_MIN >> TYPE_SHIFT;
+		static constexpr int64_t INTEGER_MAX = INT64_MAX >> TYPE_SHIFT;
+
+		// test if an integer can be stored without being wrapped
+		static constexpr bool IsValidInteger(int64_t val) { return val >= INTEGER_MIN && val <= INTEGER_MAX; }
+
+		constexpr VmVarType GetType() const {
+			if (data & TAG_HASH) return VT_HASH;
+			if (data & TAG_INTEGER) return VT_INTEGER;
+			return (VmVarType)((data >> TYPE_SHIFT) & TYPE_MASK);
+		}
+		constexpr bool IsUndefined() const { return !data; }
+		constexpr bool IsInteger() const { return (data & TAG_MASK) == TAG_INTEGER; }
+		constexpr bool IsHash() const { return data & TAG_HASH; }
+		constexpr bool IsFloat() const { return (uint32_t)data == (VT_FLOAT << TYPE_SHIFT); }
+
+		constexpr int64_t GetInteger() const { return (int64_t)data >> TYPE_SHIFT; }
+		constexpr uint64_t GetHash() const { return data >> 1; }
+		constexpr float GetFloat() const { return std::bit_cast<float>((uint32_t)(data >> VALUE_SHIFT)); }
+		constexpr VmRef GetRef() const { return (VmRef)(data >> VALUE_SHIFT); }
+		// value with its type, two vars with the same type and value have the same raw value
+		constexpr uint64_t GetRaw() const { return data; }
+
+		constexpr void SetUndefined() { data = 0; }
+		// the integers outside of [INTEGER_MIN, INTEGER_MAX] are wrapped
+		constexpr void SetInteger(int64_t val) { data = ((uint64_t)val << TYPE_SHIFT) | TAG_INTEGER; }
+		constexpr void SetHash(uint64_t val) { data = (val << 1) | TAG_HASH; }
+		constexpr void SetFloat(float val) { data = ((uint64_t)std::bit_cast<uint32_t>(val) << VALUE_SHIFT) | ((uint64_t)VT_FLOAT << TYPE_SHIFT); }
+		constexpr void SetRef(VmVarType type, VmRef ref) { data = ((uint64_t)ref << VALUE_SHIFT) | ((uint64_t)type << TYPE_SHIFT); }
+	};
+	static_assert(sizeof(VmVar) == 8, "invalid packed var size");
+#else
 	union VmVarValue {
 		int64_t i;
 		float f;
@@ -92,35 +197,88 @@ namespace acts::vm {
 		bool b;
 	};
 
-	struct VmVar {
-		VmVarType type;
-		VmVarValue val;
+	class VmVar {
+		VmVarType type{ VT_UNDEFINED };
+		VmVarValue val{};
+
+	public:
+		static constexpr int64_t INTEGER_MIN = INT64_MIN;
+		static constexpr int64_t INTEGER_MAX = INT64_MAX;
+
+		// test if an integer can be stored without being wrapped
+		static constexpr bool IsValidInteger(int64_t) { return true; }
+
+		constexpr VmVarType GetType() const { return type; }
+		constexpr bool IsUndefined() const { return type == VT_UNDEFINED; }
+		constexpr bool IsInteger() const { return type == VT_INTEGER; }
+		constexpr bool IsHash() const { return type == VT_HASH; }
+		constexpr bool IsFloat() const { return type == VT_FLOAT; }
+
+		constexpr int64_t GetInteger() const { return val.i; }
+		constexpr uint64_t GetHash() const { return val.hash; }
+		constexpr float GetFloat() const { return val.f; }
+		constexpr VmRef GetRef() const { return val.ref; }
+		// value without the type, the unused bytes are cleared by the setters
+		constexpr uint64_t GetRaw() const { return val.hash; }
+
+		constexpr void SetUndefined() { type = VT_UNDEFINED; val.i = 0; }
+		constexpr void SetInteger(int64_t v) { type = VT_INTEGER; val.i = v; }
+		constexpr void SetHash(uint64_t v) { type = VT_HASH; val.hash = v; }
+		constexpr void SetFloat(float v) { type = VT_FLOAT; val.i = 0; val.f = v; }
+		constexpr void SetRef(VmVarType t, VmRef ref) { type = t; val.i = 0; val.ref = ref; }
 	};
+#endif
 
 	struct VmVector {
 		size_t ref;
 		float vec[3]{};
 	};
 
-	struct VmArrayNode {
-		VmVar idx{};
-		VmVar var{};
-		VmRef next{};
-	};
-
+}
+#include "acts_vm_array.hpp"
+namespace acts::vm {
 	struct VmArray {
 		size_t ref;
-		VmRef start{};
+		VmArrayData* data{};
+	};
+
+	constexpr size_t VM_MAX_THREADS = 0x100;
+	// max number of vars in a thread stack
+	constexpr size_t VM_MAX_STACK = 0x1000;
+	// size of a new stack, the stacks are grown when needed
+	constexpr size_t VM_MIN_STACK = 0x20;
+
+	enum VmThreadState : byte {
+		VTS_FREE = 0,
+		VTS_READY,
+		VTS_RUNNING,
+		VTS_WAIT_TIME,
+		VTS_WAIT_FRAME,
 	};
 
 	struct VmExecutionThread {
-		bool running{};
+		VmThreadState state{};
 		VmRef threadId{};
-		utils::Timestamp waitFrameTime{};
-		size_t waitTime{};
-		VmVar stack[0x1000];
+		// kept when the thread is freed
+		std::unique_ptr<VmVar[]> stack{};
+		VmVar* stackEnd{};
 		VmVar* top;
 		byte* codePos;
+		// next predecoded instruction, nullptr to interpret the raw bytecode from codePos
+		VmInstruction* ip{};
+
+		/*
+		 * Grow the stack
+		 * @param count number of vars to push
+		 */
+		void GrowStack(size_t count = 1);
+
+		VmVar* Push() {
+			if (top == stackEnd) {
+				GrowStack();
+			}
+			return top++;
+		}
 
 		template<typename T = byte>
 		T* AlignedData() {
@@ -136,19 +294,105 @@ namespace acts::vm {
 	};
 
 
+	struct VmTimedWait {
+		utils::Timestamp time;
+		// wait order for the same time
+		uint64_t id;
+		VmRef thread;
+	};
+
+	struct VmFrameWait {
+		uint64_t frame;
+		uint64_t id;
+		VmRef thread;
+	};
+
+}
+#include "acts_vm_profiler.hpp"
+namespace acts::vm {
 	class ActsVm {
-		VmExecutionThread threads[0x100]{};
+		VmExecutionThread threads[VM_MAX_THREADS]{};
 		VmExecutionThread* currentThread{};
-		core::memory_allocator::MemoryAllocatorStatic<0x20000, VmRef> alloc{};
+		// free thread slots, the last freed slot is reused first
+		std::vector<VmRef> freeThreads{};
+		std::deque<VmRef> readyThreads{};
+		// min heaps of the waiting threads
+		std::vector<VmTimedWait> timedWaits{};
+		std::vector<VmFrameWait> frameWaits{};
+		uint64_t frame{};
+		utils::Timestamp frameTime{};
+		uint64_t waitId{};
+		core::memory_allocator::MemoryAllocatorSlab<VmRef> alloc{};
+		// arrays without reference, the values are released incrementally
+		std::deque<VmRef> releaseQueue{};
+		// data of all the arrays, released with the vm
+		std::vector<VmArrayData*> liveArrays{};
+		VmReleaseStats releaseStats{};
 		ActsVmConfig cfg;
 		int linkGroup{};
 		size_t topScripts{};
 		std::vector<ScriptInfo> scripts{};
+		// index in scripts by script name
+		std::unordered_map<uint64_t, size_t> scriptsByName{};
+		// sorted by start on the next lookup after a link
+		std::vector<VmExportRange> exportRanges{};
+		bool exportRangesSorted{ true };
+		// predecoded code of the exports by raw address
+		std::unordered_map<byte*, std::vector<VmInstruction>> decodedExports{};
+#ifdef ACTS_VM_PROFILER
+		std::unique_ptr<VmProfiler> profiler{};
+#endif
 	public:
 		ActsVm(ActsVmConfig cfg);
+		~ActsVm();
 
 		VmExecutionThread* AllocThread(byte* codePos);
+		/*
+		 * Start a thread, it is run in the next frame
+		 * @param codePos thread code
+		 * @return thread
+		 */
+		VmExecutionThread* StartThread(byte* codePos);
+		/*
+		 * Wait a time, the wait time is relative to the current frame time
+		 * @param thread thread
+		 * @param time time in ms
+		 */
+		void Wait(VmExecutionThread* thread, utils::Timestamp time);
+		/*
+		 * Wait a number of frames
+		 * @param thread thread
+		 * @param frames frames, at least 1
+		 */
+		void WaitFrames(VmExecutionThread* thread, uint64_t frames);
+		/*
+		 * Run a frame, the waiting threads are woken up and the ready threads are executed
+		 * @param now frame time in ms
+		 */
+		void RunFrame(utils::Timestamp now);
+		size_t GetThreadsCount() const {
+			return VM_MAX_THREADS - freeThreads.size();
+		}
+		/*
+		 * Find the function of a code location
+		 * @param codePos code location
+		 * @param exp export, can be null
+		 * @param script script, can be null
+		 * @return false if the location isn't in a linked export
+		 */
 		bool GetFunctionInfo(byte* codePos, ScriptExport** exp, ActScript** script);
+		/*
+		 * Get the name of the function of a code location
+		 * @param codePos code location
+		 * @return namespace<script>::function or the location if it isn't in a linked export
+		 */
+		std::string GetFunctionName(byte* codePos);
+#ifdef ACTS_VM_PROFILER
+		// profiler, null if the profiling isn't enabled in the config
+		VmProfiler* GetProfiler() {
+			return profiler.get();
+		}
+#endif
 		void CleanupThread(VmExecutionThread* thread);
 		VmVar* PushStack(size_t count = 1);
 		void PopStack(size_t count = 1);
@@ -158,7 +402,50 @@ namespace acts::vm {
 		void AddArray();
 		void AddStruct();
 		void AddVector(float* vec);
+		/*
+		 * Create an empty array in the heap
+		 * @return array ref, the array isn't referenced
+		 */
+		VmRef CreateArray();
+		VmArrayData* GetArrayData(VmVar* array);
+		/*
+		 * Get an array element
+		 * @param array array
+		 * @param key key
+		 * @return value or nullptr if the key isn't in the array
+		 */
+		VmVar* ArrayGet(VmVar* array, VmVar* key);
+		/*
+		 * Set an array element, the value is moved into the array and an undefined value removes the key
+		 * @param array array
+		 * @param key key
+		 * @param value value
+		 */
+		void ArraySet(VmVar* array, VmVar* key, VmVar* value);
+		/*
+		 * Start a foreach on an array
+		 * @param array array
+		 * @param cursor foreach position
+		 * @param key set to the first key
+		 * @return false if the array is empty
+		 */
+		bool ArrayFirstKey(VmVar* array, VmArrayCursor* cursor, VmVar* key);
+		/*
+		 * Continue a foreach on an array
+		 * @param array array
+		 * @param cursor foreach position
+		 * @param key set to the next key
+		 * @return false if there is no next key
+		 */
+		bool ArrayNextKey(VmVar* array, VmArrayCursor* cursor, VmVar* key);
+		size_t ArraySize(VmVar* array);
 		void LoadScript(uint64_t name);
+		/*
+		 * Start a thread and execute it until it stops
+		 * @param codePos thread code
+		 */
+		void RunThread(byte* codePos);
+		bool IsPredecoded(byte* codePos) const;
 		void Execute();
 		void ReleaseVariable(VmVar* var);
 		void IncRef(VmVar* var);
@@ -168,8 +455,36 @@ namespace acts::vm {
 		constexpr const ActsVmConfig& Cfg() {
 			return cfg;
 		}
+		const core::memory_allocator::MemoryAllocatorSlabStats& GetAllocStats() const {
+			return alloc.GetStats();
+		}
+		/*
+		 * Free the values of the released arrays
+		 * @param budget max number of values to free
+		 * @return number of freed values
+		 */
+		size_t ReleasePending(size_t budget = SIZE_MAX);
+		VmReleaseStats GetReleaseStats() const {
+			VmReleaseStats stats{ releaseStats };
+			stats.pending = releaseQueue.size();
+			return stats;
+		}
+		void PrintAllocStats() const;
 	private:
 		void AssertThreadStarted();
+		void FreeArrayData(VmArrayData* data);
+		/*
+		 * Allocate a heap block, the pending releases are freed first
+		 * @param len block size
+		 * @return block ref
+		 */
+		VmRef AllocHeap(size_t len);
+		void ReadyThread(VmExecutionThread* thread);
 		int LinkScript(uint64_t name);
+		/*
+		 * Add the export ranges of a script and predecode its exports
+		 * @param script script
+		 */
+		void LinkExports(ActScript* script);
 	};
 }
\ No newline at end of file
@@ -0,0 +1,243 @@
+#include <includes_shared.hpp>
+#include "acts_vm.hpp"
+
+namespace acts::vm {
+	bool VmArrayData::IsValidKey(const VmVar& key) {
+		return key.IsInteger() || key.IsHash();
+	}
+
+	uint64_t VmArrayData::HashKey(const VmVar& key) {
+		// fmix64, the hashes are already mixed, but not the integers
+		uint64_t h{ key.GetRaw() ^ ((uint64_t)key.GetType() << 56) };
+		h ^= h >> 33;
+		h *= 0xff51afd7ed558ccd;
+		h ^= h >> 33;
+		h *= 0xc4ceb9fe1a85ec53;
+		h ^= h >> 33;
+		return h;
+	}
+
+	bool VmArrayData::SameKey(const VmVar& a, const VmVar& b) {
+		return a.GetType() == b.GetType() && a.GetRaw() == b.GetRaw();
+	}
+
+	bool VmArrayData::IsDenseKey(const VmVar& key, size_t denseSize) {
+		return key.IsInteger() && key.GetInteger() >= 0 && (uint64_t)key.GetInteger() < denseSize;
+	}
+
+	uint32_t* VmArrayData::FindTableSlot(const VmVar& key) {
+		if (!tableCount) {
+			return nullptr;
+		}
+		size_t mask{ table.size() - 1 };
+		size_t idx{ (size_t)HashKey(key) & mask };
+
+		while (true) {
+			uint32_t* slot{ &table[idx] };
+			if (*slot == INDEX_EMPTY) {
+				return nullptr;
+			}
+			if (*slot != INDEX_DELETED && SameKey(entries[*slot].idx, key)) {
+				return slot;
+			}
+			idx = (idx + 1) & mask;
+		}
+	}
+
+	uint32_t VmArrayData::FindEntry(const VmVar& key) {
+		// a key is either in the dense part or in the table
+		if (IsDenseKey(key, dense.size()) && dense[key.GetInteger()] != INDEX_EMPTY) {
+			return dense[key.GetInteger()];
+		}
+		uint32_t* slot{ FindTableSlot(key) };
+		return slot ? *slot : INDEX_EMPTY;
+	}
+
+	void VmArrayData::InsertTable(uint32_t entry, bool grow) {
+		if (grow && (tableUsed + 1) * 2 > table.size()) {
+			size_t size{ std::max(MIN_TABLE_SIZE, table.size()) };
+			// only grow if the slots aren't mostly deleted slots
+			if ((tableCount + 1) * 4 > size) {
+				size <<= 1;
+			}
+			// the entry is already in the entries, it is added by the rebuild
+			RebuildIndexes(size);
+			return;
+		}
+
+		size_t mask{ table.size() - 1 };
+		size_t idx{ (size_t)HashKey(entries[entry].idx) & mask };
+
+		while (table[idx] != INDEX_EMPTY && table[idx] != INDEX_DELETED) {
+			idx = (idx + 1) & mask;
+		}
+		if (table[idx] == INDEX_EMPTY) {
+			tableUsed++;
+		}
+		table[idx] = entry;
+		tableCount++;
+	}
+
+	void VmArrayData::InsertDense(uint32_t entry) {
+		const VmVar& key{ entries[entry].idx };
+		if ((size_t)key.GetInteger() < dense.size()) {
+			dense[key.GetInteger()] = entry;
+			return;
+		}
+
+		dense.push_back(entry);
+
+		// move the next integer keys from the table, so the dense part continues to grow
+		while (tableCount) {
+			VmVar next{};
+			next.SetInteger((int64_t)dense.size());
+			uint32_t* slot{ FindTableSlot(next) };
+			if (!slot) {
+				break;
+			}
+			dense.push_back(*slot);
+			*slot = INDEX_DELETED;
+			tableCount--;
+		}
+	}
+
+	void VmArrayData::RebuildIndexes(size_t tableSize) {
+		table.assign(tableSize, INDEX_EMPTY);
+		std::fill(dense.begin(), dense.end(), INDEX_EMPTY);
+		tableUsed = 0;
+		tableCount = 0;
+
+		for (size_t i = 0; i < entries.size(); i++) {
+			const VmVar& key{ entries[i].idx };
+			if (key.IsUndefined()) {
+				continue;
+			}
+			if (IsDenseKey(key, dense.size())) {
+				dense[key.GetInteger()] = (uint32_t)i;
+			}
+			else {
+				InsertTable((uint32_t)i, false);
+			}
+		}
+	}
+
+	void VmArrayData::Compact() {
+		std::erase_if(entries, [](const VmArrayEntry& e) { return e.idx.IsUndefined(); });
+		// the table keeps the same number of live keys
+		RebuildIndexes(table.size());
+	}
+
+	VmVar* VmArrayData::Find(const VmVar& key) {
+		uint32_t entry{ FindEntry(key) };
+		return entry == INDEX_EMPTY ? nullptr : &entries[entry].var;
+	}
+
+	VmVar* VmArrayData::FindOrInsert(const VmVar& key, bool* inserted) {
+		uint32_t entry{ FindEntry(key) };
+		if (inserted) {
+			*inserted = entry == INDEX_EMPTY;
+		}
+		if (entry != INDEX_EMPTY) {
+			return &entries[entry].var;
+		}
+
+		if (entries.size() >= INDEX_DELETED) {
+			throw std::runtime_error("Too many elements in array");
+		}
+
+		entry = (uint32_t)entries.size();
+		VmArrayEntry& e{ entries.emplace_back() };
+		e.idx = key;
+		e.seq = nextSeq++;
+		count++;
+
+		if (key.IsInteger() && key.GetInteger() >= 0 && (uint64_t)key.GetInteger() <= dense.size()) {
+			InsertDense(entry);
+		}
+		else {
+			InsertTable(entry, true);
+		}
+
+		return &entries[entry].var;
+	}
+
+	bool VmArrayData::Remove(const VmVar& key, VmVar* value) {
+		uint32_t entry;
+		if (IsDenseKey(key, dense.size()) && dense[key.GetInteger()] != INDEX_EMPTY) {
+			entry = dense[key.GetInteger()];
+			dense[key.GetInteger()] = INDEX_EMPTY;
+		}
+		else {
+			uint32_t* slot{ FindTableSlot(key) };
+			if (!slot) {
+				return false;
+			}
+			entry = *slot;
+			*slot = INDEX_DELETED;
+			tableCount--;
+		}
+
+		VmArrayEntry& e{ entries[entry] };
+		*value = e.var;
+		e.idx.SetUndefined();
+		e.var.SetUndefined();
+		count--;
+
+		if (entries.size() >= MIN_COMPACT_SIZE && count < entries.size() / 2) {
+			Compact();
+		}
+		else if (!count) {
+			entries.clear();
+		}
+
+		return true;
+	}
+
+	bool VmArrayData::PopValue(VmVar* value) {
+		while (!entries.empty()) {
+			VmArrayEntry& e{ entries.back() };
+			if (!e.idx.IsUndefined()) {
+				*value = e.var;
+				entries.pop_back();
+				count--;
+				return true;
+			}
+			entries.pop_back();
+		}
+		return false;
+	}
+
+	bool VmArrayData::FirstKey(VmArrayCursor* cursor, VmVar* key) const {
+		for (size_t i = 0; i < entries.size(); i++) {
+			const VmArrayEntry& e{ entries[i] };
+			if (!e.idx.IsUndefined()) {
+				*key = e.idx;
+				cursor->seq = e.seq;
+				cursor->entry = (uint32_t)i;
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool VmArrayData::NextKey(VmArrayCursor* cursor, VmVar* key) const {
+		size_t i;
+		if (cursor->entry < entries.size() && entries[cursor->entry].seq == cursor->seq) {
+			i = cursor->entry + 1;
+		}
+		else {
+			// the entries were compacted, search the next one by sequence
+			i = std::upper_bound(entries.begin(), entries.end(), cursor->seq, [](uint64_t seq, const VmArrayEntry& e) { return seq < e.seq; }) - entries.begin();
+		}
+		for (; i < entries.size(); i++) {
+			const VmArrayEntry& e{ entries[i] };
+			if (!e.idx.IsUndefined()) {
+				*key = e.idx;
+				cursor->seq = e.seq;
+				cursor->entry = (uint32_t)i;
+				return true;
+			}
+		}
+		return false;
+	}
+}
@@ -0,0 +1,130 @@
+#pragma once
+
+namespace acts::vm {
+	struct VmArrayEntry {
+		// VT_UNDEFINED if the entry was removed
+		VmVar idx;
+		VmVar var;
+		// insertion sequence, the entries are sorted by sequence
+		uint64_t seq;
+	};
+
+	/*
+	 * Position of a foreach in an array, the position is kept if the current key is removed or if the entries are
+	 * compacted
+	 */
+	struct VmArrayCursor {
+		// sequence of the current entry
+		uint64_t seq{};
+		// index of the current entry, only valid if the entry still has the same sequence
+		uint32_t entry{};
+	};
+
+	/*
+	 * Content of an array or a struct, the entries are stored in insertion order for the foreach, the small integer
+	 * keys are indexed by a dense vector and the other keys by an open addressing hash table.
+	 */
+	class VmArrayData {
+		static constexpr uint32_t INDEX_EMPTY = 0xFFFFFFFF;
+		static constexpr uint32_t INDEX_DELETED = 0xFFFFFFFE;
+		static constexpr size_t MIN_TABLE_SIZE = 8;
+		// compact the entries when more than half of them are removed
+		static constexpr size_t MIN_COMPACT_SIZE = 0x10;
+
+		std::vector<VmArrayEntry> entries{};
+		// entry of the integer keys [0, dense.size()[
+		std::vector<uint32_t> dense{};
+		// entry of the other keys, the size is a power of 2
+		std::vector<uint32_t> table{};
+		// used slots, with the deleted slots
+		size_t tableUsed{};
+		// live slots
+		size_t tableCount{};
+		size_t count{};
+		uint64_t nextSeq{};
+
+		static uint64_t HashKey(const VmVar& key);
+		static bool SameKey(const VmVar& a, const VmVar& b);
+		static bool IsDenseKey(const VmVar& key, size_t denseSize);
+
+		uint32_t FindEntry(const VmVar& key);
+		uint32_t* FindTableSlot(const VmVar& key);
+		void InsertTable(uint32_t entry, bool grow);
+		void InsertDense(uint32_t entry);
+		void RebuildIndexes(size_t tableSize);
+		void Compact();
+	public:
+		// index in the live arrays of the vm
+		size_t liveIndex{};
+
+		/*
+		 * Test if a var can be used as a key
+		 * @param key key
+		 * @return true if the key is valid
+		 */
+		static bool IsValidKey(const VmVar& key);
+
+		/*
+		 * Find the value of a key
+		 * @param key key
+		 * @return value or nullptr if the key isn't in the array
+		 */
+		VmVar* Find(const VmVar& key);
+
+		/*
+		 * Find the value of a key or insert it
+		 * @param key key
+		 * @param inserted set to true if the key was inserted
+		 * @return value, undefined if the key was inserted
+		 */
+		VmVar* FindOrInsert(const VmVar& key, bool* inserted = nullptr);
+
+		/*
+		 * Remove a key
+		 * @param key key
+		 * @param value set to the removed value, it should be released by the caller
+		 * @return true if the key was removed
+		 */
+		bool Remove(const VmVar& key, VmVar* value);
+
+		/*
+		 * Remove the last value, used to release an array incrementally, the keys can't be searched after this call
+		 * @param value set to the removed value, it should be released by the caller
+		 * @return false if the array is empty
+		 */
+		bool PopValue(VmVar* value);
+
+		/*
+		 * Get the first key in insertion order
+		 * @param cursor set to the position of the key
+		 * @param key set to the first key
+		 * @return false if the array is empty
+		 */
+		bool FirstKey(VmArrayCursor* cursor, VmVar* key) const;
+
+		/*
+		 * Get the next key in insertion order, the current key can be removed during the foreach
+		 * @param cursor position of the current key, set to the position of the next key
+		 * @param key set to the next key
+		 * @return false if there is no next key
+		 */
+		bool NextKey(VmArrayCursor* cursor, VmVar* key) const;
+
+		/*
+		 * Call a function for each entry in insertion order
+		 * @param func function called with the key and the value
+		 */
+		template<typename Func>
+		void ForEach(Func&& func) {
+			for (VmArrayEntry& e : entries) {
+				if (!e.idx.IsUndefined()) {
+					func(e.idx, e.var);
+				}
+			}
+		}
+
+		constexpr size_t Size() const {
+			return count;
+		}
+	};
+}
@@ -10,6 +10,138 @@ namespace acts::vm::opcodes {
 	typedef void(*OpcodeHandler)(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, bool* terminated);
 	OpcodeHandler handlers[HANDLERS_MAX_OP];
 
+	enum OperandType : byte {
+		OT_NONE = 0,
+		OT_INT,
+		OT_FLOAT,
+		OT_HASH,
+		OT_JUMP,
+		OT_EXPORT_PARAMS,
+		OT_INVALID,
+	};
+
+	struct OpCodeDecoder {
+		OperandType operand;
+		VmInstructionHandler handler;
+	};
+	OpCodeDecoder decoders[HANDLERS_MAX_OP];
+
+	// operations shared by the raw handlers and the predecoded handlers
+
+	inline void ClearParams(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread) {
+		// the params are pushed after the precall, the autoexec threads don't have one
+		bool released{};
+		while (thread->top > thread->stack.get() + 1 && thread->top[-1].GetType() != VT_PRECALL) {
+			vm->ReleaseVariable(--thread->top);
+			released = true;
+		}
+		if (released) {
+			vm->Error("Called function with too many parameters", false);
+		}
+	}
+
+	inline void PushInteger(acts::vm::VmExecutionThread* thread, int64_t val) {
+		thread->Push()->SetInteger(val);
+	}
+
+	inline void PushFloat(acts::vm::VmExecutionThread* thread, float f) {
+		thread->Push()->SetFloat(f);
+	}
+
+	inline void PushHash(acts::vm::VmExecutionThread* thread, uint64_t hash) {
+		thread->Push()->SetHash(hash);
+	}
+
+	inline void PushUndefined(acts::vm::VmExecutionThread* thread) {
+		thread->Push()->SetUndefined();
+	}
+
+	inline void IsDefined(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread) {
+		VmVar* top{ thread->top - 1 };
+		bool defined{ !top->IsUndefined() };
+		vm->ReleaseVariable(top);
+		top->SetInteger(defined);
+	}
+
+	inline bool IsNumber(const VmVar* var) {
+		return var->IsInteger() || var->IsFloat();
+	}
+
+	inline float ToFloat(const VmVar* var) {
+		return var->IsInteger() ? (float)var->GetInteger() : var->GetFloat();
+	}
+
+	/*
+	 * Apply a binary operator to the 2 top values, the result replaces the left value
+	 * @param vm vm
+	 * @param thread thread
+	 * @param name operator name for the errors
+	 * @param intOp operator used if both values are integers
+	 * @param floatOp operator used if one of the values is a float
+	 */
+	template<typename IntOp, typename FloatOp>
+	inline void NumberOperator(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, const char* name, IntOp intOp, FloatOp floatOp) {
+		VmVar* right{ --thread->top };
+		VmVar* left{ thread->top - 1 };
+		if (left->IsInteger() && right->IsInteger()) {
+			left->SetInteger(intOp(left->GetInteger(), right->GetInteger()));
+			return;
+		}
+		if (IsNumber(left) && IsNumber(right)) {
+			left->SetFloat(floatOp(ToFloat(left), ToFloat(right)));
+			return;
+		}
+		vm->Error(utils::va("Can't apply operator %s to %s and %s", name, VmVarTypeName(left->GetType()), VmVarTypeName(right->GetType())), false);
+		vm->ReleaseVariable(right);
+		vm->ReleaseVariable(left);
+	}
+
+	// the integer operations are wrapping
+	inline void OperatorPlus(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread) {
+		NumberOperator(vm, thread, "+", [](int64_t a, int64_t b) { return (int64_t)((uint64_t)a + (uint64_t)b); }, [](float a, float b) { return a + b; });
+	}
+
+	inline void OperatorMinus(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread) {
+		NumberOperator(vm, thread, "-", [](int64_t a, int64_t b) { return (int64_t)((uint64_t)a - (uint64_t)b); }, [](float a, float b) { return a - b; });
+	}
+
+	inline void OperatorMultiply(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread) {
+		NumberOperator(vm, thread, "*", [](int64_t a, int64_t b) { return (int64_t)((uint64_t)a * (uint64_t)b); }, [](float a, float b) { return a * b; });
+	}
+
+	// wait time in ms, in seconds in the scripts
+	inline utils::Timestamp PopWaitTime(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread) {
+		VmVar* top{ --thread->top };
+		if (top->IsInteger()) {
+			return (utils::Timestamp)top->GetInteger() * 1000;
+		}
+		if (top->IsFloat()) {
+			return (utils::Timestamp)(top->GetFloat() * 1000);
+		}
+		vm->Error(utils::va("Invalid wait time: type %s", VmVarTypeName(top->GetType())), false);
+		vm->ReleaseVariable(top);
+		return 0;
+	}
+
+	inline uint64_t PopWaitFrames(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread) {
+		VmVar* top{ --thread->top };
+		if (!top->IsInteger()) {
+			vm->Error(utils::va("Invalid wait frames: type %s", VmVarTypeName(top->GetType())), false);
+			vm->ReleaseVariable(top);
+			return 1;
+		}
+		return top->GetInteger() > 0 ? (uint64_t)top->GetInteger() : 1;
+	}
+
+	// pop the top value if cond is false
+	inline bool JumpExpr(acts::vm::VmExecutionThread* thread, bool cond) {
+		if (!cond) {
+			thread->top--;
+		}
+		return cond;
+	}
+
+	// raw bytecode handlers
 
 	void InvalidOpCodeHandler(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, bool* terminated) {
 		*terminated = true;
@@ -20,19 +152,30 @@ namespace acts::vm::opcodes {
 		// nop
 	}
 
+	void EndHandler(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, bool* terminated) {
+		// no call frames yet, the end is terminating the thread
+		*terminated = true;
+		vm->CleanupThread(thread);
+	}
+
+	void WaitHandler(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, bool* terminated) {
+		// the thread is continued by the scheduler
+		*terminated = true;
+		vm->Wait(thread, PopWaitTime(vm, thread));
+	}
+
+	void WaitFrameHandler(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, bool* terminated) {
+		*terminated = true;
+		vm->WaitFrames(thread, PopWaitFrames(vm, thread));
+	}
+
 	void ExportNoParamsHandler(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, bool*) {
-		if (thread->top->type != VT_PRECALL) {
-			do {
-				vm->ReleaseVariable(thread->top--);
-			} while (thread->top->type != VT_PRECALL);
-			vm->Error("Called function with too many parameters", false);
-		}
+		ClearParams(vm, thread);
 	}
 
 	void ExportParamsHandler(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, bool*) {
 		byte vars{ *(thread->codePos++) };
 
-		VmVar* top{ thread->top };
 		for (size_t i = 0; i < vars; i++) {
 			uint32_t* baseName{ thread->SetAlignedData<uint32_t>() };
 			uint32_t name = *baseName;
@@ -43,62 +186,49 @@ namespace acts::vm::opcodes {
 
 		}
 
-		if (top->type != VT_PRECALL) {
-			do {
-				vm->ReleaseVariable(thread->top--);
-			} while (thread->top->type != VT_PRECALL);
-			vm->Error("Called function with too many parameters", false);
-		}
+		ClearParams(vm, thread);
 	}
 
-	void GetIntHandler(acts::vm::ActsVm*, acts::vm::VmExecutionThread* thread, bool*) {
+	void GetIntHandler(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, bool*) {
 		int64_t* base{ thread->SetAlignedData<int64_t>() };
 		int64_t i{ *base };
 		thread->codePos = (byte*)(base + 1);
-		VmVar* top{ thread->top++ };
-		top->val.i = i;
-		top->type = VT_INTEGER;
+		if (!VmVar::IsValidInteger(i)) {
+			vm->Error(utils::va("Integer constant out of range: %lld", i), false);
+			PushUndefined(thread);
+			return;
+		}
+		PushInteger(thread, i);
 	}
 
 	void GetFloatHandler(acts::vm::ActsVm*, acts::vm::VmExecutionThread* thread, bool*) {
 		float* base{ thread->SetAlignedData<float>() };
 		float f{ *base };
 		thread->codePos = (byte*)(base + 1);
-		VmVar* top{ thread->top++ };
-		top->val.f = f;
-		top->type = VT_FLOAT;
+		PushFloat(thread, f);
 	}
 
 	void GetHashHandler(acts::vm::ActsVm*, acts::vm::VmExecutionThread* thread, bool*) {
 		uint64_t* base{ thread->SetAlignedData<uint64_t>() };
 		uint64_t h{ *base };
 		thread->codePos = (byte*)(base + 1);
-		VmVar* top{ thread->top++ };
-		top->val.hash = h;
-		top->type = VT_HASH;
+		PushHash(thread, h);
 	}
 
 	void GetUndefinedHandler(acts::vm::ActsVm*, acts::vm::VmExecutionThread* thread, bool*) {
-		VmVar* top{ thread->top++ };
-		top->val.i = 0;
-		top->type = VT_UNDEFINED;
+		PushUndefined(thread);
 	}
 
 	void IsDefinedHandler(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, bool*) {
-		VmVar* top{ thread->top };
-		vm->ReleaseVariable(thread->top);
-		top->val.b = thread->top->type != VT_UNDEFINED;
-		top->type = VT_INTEGER;
+		IsDefined(vm, thread);
 	}
 
 	void DecTopHandler(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, bool*) {
-		vm->ReleaseVariable(thread->top--);
+		vm->ReleaseVariable(--thread->top);
 	}
 
 	void PreCallHandler(acts::vm::ActsVm*, acts::vm::VmExecutionThread* thread, bool*) {
-		VmVar* top{ thread->top++ };
-		top->val.i = 0;
-		top->type = VT_PRECALL;
+		thread->Push()->SetRef(VT_PRECALL, 0);
 	}
 	void JumpHandler(acts::vm::ActsVm*, acts::vm::VmExecutionThread* thread, bool*) {
 		int16_t* base{ thread->SetAlignedData<int16_t>() };
@@ -120,18 +250,15 @@ namespace acts::vm::opcodes {
 		int16_t delta{ *base };
 		thread->codePos = (byte*)(base + 1);
 
-		if (thread->top->type != VT_UNDEFINED) {
+		if (JumpExpr(thread, !thread->top[-1].IsUndefined())) {
 			thread->codePos += delta;
 		}
-		else {
-			thread->top--;
-		}
 	}
 	void JumpIfTrueHandler(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, bool*) {
 		int16_t* base{ thread->SetAlignedData<int16_t>() };
 		int16_t delta{ *base };
 		thread->codePos = (byte*)(base + 1);
-		if (vm->CastToBool(thread->top--)) {
+		if (vm->CastToBool(--thread->top)) {
 			thread->codePos += delta;
 		}
 	}
@@ -139,7 +266,7 @@ namespace acts::vm::opcodes {
 		int16_t* base{ thread->SetAlignedData<int16_t>() };
 		int16_t delta{ *base };
 		thread->codePos = (byte*)(base + 1);
-		if (!vm->CastToBool(thread->top--)) {
+		if (!vm->CastToBool(--thread->top)) {
 			thread->codePos += delta;
 		}
 	}
@@ -147,53 +274,215 @@ namespace acts::vm::opcodes {
 		int16_t* base{ thread->SetAlignedData<int16_t>() };
 		int16_t delta{ *base };
 		thread->codePos = (byte*)(base + 1);
-		if (vm->CastToBool(thread->top)) {
+		if (JumpExpr(thread, vm->CastToBool(thread->top - 1))) {
 			thread->codePos += delta;
 		}
-		else {
-			thread->top--;
-		}
 	}
 	void JumpIfFalseExprHandler(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, bool*) {
 		int16_t* base{ thread->SetAlignedData<int16_t>() };
 		int16_t delta{ *base };
 		thread->codePos = (byte*)(base + 1);
-		if (!vm->CastToBool(thread->top)) {
+		if (JumpExpr(thread, !vm->CastToBool(thread->top - 1))) {
 			thread->codePos += delta;
 		}
-		else {
-			thread->top--;
+	}
+
+	void PlusHandler(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, bool*) {
+		OperatorPlus(vm, thread);
+	}
+	void MinusHandler(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, bool*) {
+		OperatorMinus(vm, thread);
+	}
+	void MultiplyHandler(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, bool*) {
+		OperatorMultiply(vm, thread);
+	}
+
+	// predecoded handlers, the raw location is only synced before the calls that can log an error
+
+	VmInstruction* InvalidOpCodeIns(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		thread->codePos = ins->codePos;
+		vm->Error("Invalid opcode", true);
+		return nullptr;
+	}
+
+	VmInstruction* NopIns(acts::vm::ActsVm*, acts::vm::VmExecutionThread*, VmInstruction* ins) {
+		return ins + 1;
+	}
+
+	VmInstruction* RawBytecodeIns(acts::vm::ActsVm*, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		// end of the predecoded code
+		thread->codePos = ins->codePos;
+		thread->ip = nullptr;
+		return nullptr;
+	}
+
+	VmInstruction* EndIns(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		thread->codePos = ins->codePos;
+		vm->CleanupThread(thread);
+		return nullptr;
+	}
+
+	VmInstruction* WaitIns(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		thread->codePos = ins->codePos;
+		vm->Wait(thread, PopWaitTime(vm, thread));
+		thread->ip = ins + 1;
+		return nullptr;
+	}
+
+	VmInstruction* WaitFrameIns(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		thread->codePos = ins->codePos;
+		vm->WaitFrames(thread, PopWaitFrames(vm, thread));
+		thread->ip = ins + 1;
+		return nullptr;
+	}
+
+	VmInstruction* ExportIns(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		thread->codePos = ins->codePos;
+		ClearParams(vm, thread);
+		return ins + 1;
+	}
+
+	VmInstruction* GetIntIns(acts::vm::ActsVm*, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		PushInteger(thread, ins->operand.i);
+		return ins + 1;
+	}
+
+	VmInstruction* GetFloatIns(acts::vm::ActsVm*, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		PushFloat(thread, ins->operand.f);
+		return ins + 1;
+	}
+
+	VmInstruction* GetHashIns(acts::vm::ActsVm*, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		PushHash(thread, ins->operand.hash);
+		return ins + 1;
+	}
+
+	VmInstruction* GetUndefinedIns(acts::vm::ActsVm*, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		PushUndefined(thread);
+		return ins + 1;
+	}
+
+	VmInstruction* IsDefinedIns(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		thread->codePos = ins->codePos;
+		IsDefined(vm, thread);
+		return ins + 1;
+	}
+
+	VmInstruction* DecTopIns(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		thread->codePos = ins->codePos;
+		vm->ReleaseVariable(--thread->top);
+		return ins + 1;
+	}
+
+	VmInstruction* PreCallIns(acts::vm::ActsVm*, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		thread->Push()->SetRef(VT_PRECALL, 0);
+		return ins + 1;
+	}
+
+	VmInstruction* JumpIns(acts::vm::ActsVm*, acts::vm::VmExecutionThread*, VmInstruction* ins) {
+		return ins->operand.target;
+	}
+
+	VmInstruction* DevBlockIns(acts::vm::ActsVm*, acts::vm::VmExecutionThread*, VmInstruction* ins) {
+		// replaced by a jump or removed at predecode time
+		return ins->operand.target;
+	}
+
+	VmInstruction* JumpIfDefinedIns(acts::vm::ActsVm*, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		return JumpExpr(thread, !thread->top[-1].IsUndefined()) ? ins->operand.target : ins + 1;
+	}
+
+	VmInstruction* JumpIfTrueIns(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		thread->codePos = ins->codePos;
+		return vm->CastToBool(--thread->top) ? ins->operand.target : ins + 1;
+	}
+
+	VmInstruction* JumpIfFalseIns(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		thread->codePos = ins->codePos;
+		return vm->CastToBool(--thread->top) ? ins + 1 : ins->operand.target;
+	}
+
+	VmInstruction* JumpIfTrueExprIns(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		thread->codePos = ins->codePos;
+		return JumpExpr(thread, vm->CastToBool(thread->top - 1)) ? ins->operand.target : ins + 1;
+	}
+
+	VmInstruction* JumpIfFalseExprIns(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		thread->codePos = ins->codePos;
+		return JumpExpr(thread, !vm->CastToBool(thread->top - 1)) ? ins->operand.target : ins + 1;
+	}
+
+	VmInstruction* PlusIns(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		thread->codePos = ins->codePos;
+		OperatorPlus(vm, thread);
+		return ins + 1;
+	}
+
+	VmInstruction* MinusIns(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		thread->codePos = ins->codePos;
+		OperatorMinus(vm, thread);
+		return ins + 1;
+	}
+
+	VmInstruction* MultiplyIns(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		thread->codePos = ins->codePos;
+		OperatorMultiply(vm, thread);
+		return ins + 1;
+	}
+
+	// superinstructions
+
+	// isdefined + jumpiffalse
+	VmInstruction* JumpIfNotDefinedIns(acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, VmInstruction* ins) {
+		VmVar* top{ --thread->top };
+		if (top->IsUndefined()) {
+			return ins->operand.target;
 		}
+		thread->codePos = ins->codePos;
+		vm->ReleaseVariable(top);
+		return ins + 1;
 	}
 
 	static int handlersSet{
 		([]() -> int {
+			auto reg = [](OpCodeId op, OpcodeHandler handler, OperandType operand, VmInstructionHandler ins) {
+				handlers[op] = handler;
+				decoders[op] = { operand, ins };
+			};
+
 			// Set default array
 			for (size_t i = 0; i < HANDLERS_MAX_OP; i++) {
 				handlers[i] = InvalidOpCodeHandler;
+				decoders[i] = { OT_INVALID, InvalidOpCodeIns };
 			}
 
-			handlers[OpCodeId::OPCODE_NOP] = NopHandler;
-			handlers[OpCodeId::OPCODE_EXPORT_NO_PARAMS] = ExportNoParamsHandler;
-			handlers[OpCodeId::OPCODE_EXPORT_PARAMS] = ExportParamsHandler;
-			//handlers[OpCodeId::OPCODE_END] = InvalidOpCodeHandler; // todo
-			handlers[OpCodeId::OPCODE_GET_INT] = GetIntHandler;
-			handlers[OpCodeId::OPCODE_GET_FLOAT] = GetFloatHandler;
-			handlers[OpCodeId::OPCODE_GET_HASH] = GetHashHandler;
-			handlers[OpCodeId::OPCODE_GET_UNDEFINED] = GetUndefinedHandler;
-
-			handlers[OpCodeId::OPCODE_IS_DEFINED] = IsDefinedHandler;
-			handlers[OpCodeId::OPCODE_DEC_TOP] = DecTopHandler;
-			handlers[OpCodeId::OPCODE_PRE_CALL] = PreCallHandler;
-
-			handlers[OpCodeId::OPCODE_JUMP] = JumpHandler;
-			handlers[OpCodeId::OPCODE_DEV_BLOCK] = DevBlockHandler;
-			handlers[OpCodeId::OPCODE_JUMP_IF_TRUE] = JumpIfTrueHandler;
-			handlers[OpCodeId::OPCODE_JUMP_IF_FALSE] = JumpIfFalseHandler;
-			handlers[OpCodeId::OPCODE_JUMP_IF_TRUE_EXPR] = JumpIfTrueExprHandler;
-			handlers[OpCodeId::OPCODE_JUMP_IF_FALSE_EXPR] = JumpIfFalseExprHandler;
-			handlers[OpCodeId::OPCODE_JUMP_IF_DEFINED] = JumpIfDefinedHandler;
-			
+			reg(OpCodeId::OPCODE_NOP, NopHandler, OT_NONE, NopIns);
+			reg(OpCodeId::OPCODE_EXPORT_NO_PARAMS, ExportNoParamsHandler, OT_NONE, ExportIns);
+			reg(OpCodeId::OPCODE_EXPORT_PARAMS, ExportParamsHandler, OT_EXPORT_PARAMS, ExportIns);
+			reg(OpCodeId::OPCODE_END, EndHandler, OT_NONE, EndIns);
+			reg(OpCodeId::OPCODE_WAIT, WaitHandler, OT_NONE, WaitIns);
+			reg(OpCodeId::OPCODE_WAIT_FRAME, WaitFrameHandler, OT_NONE, WaitFrameIns);
+			reg(OpCodeId::OPCODE_GET_INT, GetIntHandler, OT_INT, GetIntIns);
+			reg(OpCodeId::OPCODE_GET_FLOAT, GetFloatHandler, OT_FLOAT, GetFloatIns);
+			reg(OpCodeId::OPCODE_GET_HASH, GetHashHandler, OT_HASH, GetHashIns);
+			reg(OpCodeId::OPCODE_GET_UNDEFINED, GetUndefinedHandler, OT_NONE, GetUndefinedIns);
+
+			reg(OpCodeId::OPCODE_IS_DEFINED, IsDefinedHandler, OT_NONE, IsDefinedIns);
+			reg(OpCodeId::OPCODE_DEC_TOP, DecTopHandler, OT_NONE, DecTopIns);
+			reg(OpCodeId::OPCODE_PRE_CALL, PreCallHandler, OT_NONE, PreCallIns);
+
+			reg(OpCodeId::OPCODE_JUMP, JumpHandler, OT_JUMP, JumpIns);
+			reg(OpCodeId::OPCODE_DEV_BLOCK, DevBlockHandler, OT_JUMP, DevBlockIns);
+			reg(OpCodeId::OPCODE_JUMP_IF_TRUE, JumpIfTrueHandler, OT_JUMP, JumpIfTrueIns);
+			reg(OpCodeId::OPCODE_JUMP_IF_FALSE, JumpIfFalseHandler, OT_JUMP, JumpIfFalseIns);
+			reg(OpCodeId::OPCODE_JUMP_IF_TRUE_EXPR, JumpIfTrueExprHandler, OT_JUMP, JumpIfTrueExprIns);
+			reg(OpCodeId::OPCODE_JUMP_IF_FALSE_EXPR, JumpIfFalseExprHandler, OT_JUMP, JumpIfFalseExprIns);
+			reg(OpCodeId::OPCODE_JUMP_IF_DEFINED, JumpIfDefinedHandler, OT_JUMP, JumpIfDefinedIns);
+
+			reg(OpCodeId::OPCODE_OP_PLUS, PlusHandler, OT_NONE, PlusIns);
+			reg(OpCodeId::OPCODE_OP_MINUS, MinusHandler, OT_NONE, MinusIns);
+			reg(OpCodeId::OPCODE_OP_MULTIPLY, MultiplyHandler, OT_NONE, MultiplyIns);
+
 			return 0;
 		})()
 	};
@@ -205,4 +494,177 @@ namespace acts::vm::opcodes {
 		}
 		handlers[opcode](vm, thread, terminated);
 	}
-}
\ No newline at end of file
+
+	namespace {
+		struct RawInstruction {
+			byte* codePos;
+			const OpCodeDecoder* decoder;
+			int64_t operand;
+			float operandFloat;
+			// raw jump target
+			byte* target;
+		};
+
+		constexpr size_t NO_TARGET = (size_t)-1;
+
+		template<typename T>
+		bool ReadOperand(byte*& pos, byte* end, T& val) {
+			T* base{ (T*)utils::Aligned<T>(pos) };
+			if ((byte*)(base + 1) > end) {
+				return false;
+			}
+			val = *base;
+			pos = (byte*)(base + 1);
+			return true;
+		}
+	}
+
+	bool PredecodeExport(acts::vm::ActsVm* vm, byte* start, byte* end, std::vector<VmInstruction>& code) {
+		std::vector<RawInstruction> raw{};
+
+		// read the raw instructions until the end of the export or an unknown opcode
+		byte* pos{ start };
+		while (pos < end) {
+			RawInstruction& r{ raw.emplace_back() };
+			r.codePos = pos;
+			r.decoder = &decoders[*pos++];
+
+			switch (r.decoder->operand) {
+			case OT_INT:
+				// the constants out of range are reported by the raw handler
+				if (!ReadOperand<int64_t>(pos, end, r.operand) || !VmVar::IsValidInteger(r.operand)) return false;
+				break;
+			case OT_HASH:
+				if (!ReadOperand<int64_t>(pos, end, r.operand)) return false;
+				break;
+			case OT_FLOAT:
+				if (!ReadOperand<float>(pos, end, r.operandFloat)) return false;
+				break;
+			case OT_JUMP: {
+				int16_t delta;
+				if (!ReadOperand<int16_t>(pos, end, delta)) return false;
+				r.target = pos + delta;
+				break;
+			}
+			case OT_EXPORT_PARAMS: {
+				if (pos >= end) return false;
+				byte vars{ *pos++ };
+				for (size_t i = 0; i < vars; i++) {
+					uint32_t name;
+					if (!ReadOperand<uint32_t>(pos, end, name)) return false;
+				}
+				break;
+			}
+			}
+
+			if (r.decoder->operand == OT_INVALID) {
+				// the size is unknown, nothing after can be decoded
+				break;
+			}
+		}
+		byte* decodedEnd{ pos };
+
+		auto findIndex = [&raw, decodedEnd](byte* target) -> size_t {
+			if (target == decodedEnd) {
+				return raw.size();
+			}
+			auto it{ std::lower_bound(raw.begin(), raw.end(), target, [](const RawInstruction& r, byte* loc) { return r.codePos < loc; }) };
+			return it != raw.end() && it->codePos == target ? (size_t)(it - raw.begin()) : NO_TARGET;
+		};
+
+		std::vector<size_t> rawTargets(raw.size(), NO_TARGET);
+		std::vector<bool> isTarget(raw.size() + 1);
+		for (size_t i = 0; i < raw.size(); i++) {
+			if (raw[i].decoder->operand != OT_JUMP) continue;
+			size_t idx{ findIndex(raw[i].target) };
+			if (idx == NO_TARGET) {
+				// jump outside of the predecoded code or inside an instruction
+				return false;
+			}
+			rawTargets[i] = idx;
+			isTarget[idx] = true;
+		}
+
+		// emit the instructions, map[raw] is the first instruction emitted for a raw instruction or after it
+		std::vector<size_t> map(raw.size() + 1);
+		std::vector<size_t> targets{};
+		code.clear();
+		code.reserve(raw.size() + 1);
+
+		auto emit = [&code, &targets](VmInstructionHandler handler, byte* codePos, size_t target) -> VmInstruction& {
+			VmInstruction& ins{ code.emplace_back() };
+			ins.handler = handler;
+			ins.operand.i = 0;
+			ins.codePos = codePos;
+#ifdef ACTS_VM_PROFILER
+			ins.opcode = handler == RawBytecodeIns ? VM_PROFILER_NO_OPCODE : *codePos;
+#endif
+			targets.push_back(target);
+			return ins;
+		};
+
+		for (size_t i = 0; i < raw.size(); i++) {
+			map[i] = code.size();
+			RawInstruction& r{ raw[i] };
+			VmInstructionHandler handler{ r.decoder->handler };
+			// the next instruction can be merged if nothing is jumping to it
+			RawInstruction* next{ i + 1 < raw.size() && !isTarget[i + 1] ? &raw[i + 1] : nullptr };
+
+			if (handler == NopIns) {
+				continue;
+			}
+			if (handler == DevBlockIns) {
+				if (!vm->Cfg().enabledDevBlocks) {
+					emit(JumpIns, r.codePos, rawTargets[i]);
+				}
+				continue;
+			}
+			if (handler == GetIntIns && next && (next->decoder->handler == JumpIfTrueIns || next->decoder->handler == JumpIfFalseIns)) {
+				// constant condition, while (true) or if (0)
+				bool cond{ r.operand != 0 };
+				if (cond == (next->decoder->handler == JumpIfTrueIns)) {
+					emit(JumpIns, r.codePos, rawTargets[i + 1]);
+				}
+				map[++i] = code.size();
+				continue;
+			}
+			if (handler == IsDefinedIns && next && next->decoder->handler == JumpIfFalseIns) {
+				emit(JumpIfNotDefinedIns, r.codePos, rawTargets[i + 1]);
+				map[++i] = code.size();
+				continue;
+			}
+
+			VmInstruction& ins{ emit(handler, r.codePos, rawTargets[i]) };
+			switch (r.decoder->operand) {
+			case OT_INT:
+			case OT_HASH:
+				ins.operand.i = r.operand;
+				break;
+			case OT_FLOAT:
+				ins.operand.f = r.operandFloat;
+				break;
+			}
+		}
+		map[raw.size()] = code.size();
+		// continue with the raw bytecode after the predecoded code
+		emit(RawBytecodeIns, decodedEnd, NO_TARGET);
+
+		// resolve the jumps, the jumps to a jump are using the final target
+		for (size_t i = 0; i < code.size(); i++) {
+			if (targets[i] != NO_TARGET) {
+				code[i].operand.target = &code[map[targets[i]]];
+			}
+		}
+		for (size_t i = 0; i < code.size(); i++) {
+			if (targets[i] == NO_TARGET) continue;
+
+			VmInstruction* target{ code[i].operand.target };
+			for (size_t hops = 0; target->handler == JumpIns && hops < code.size(); hops++) {
+				target = target->operand.target;
+			}
+			code[i].operand.target = target;
+		}
+
+		return true;
+	}
+}
@@ -3,4 +3,15 @@
 namespace acts::vm::opcodes {
 	typedef uint8_t OpCode;
 	void HandleOpCode(OpCode opcode, acts::vm::ActsVm* vm, acts::vm::VmExecutionThread* thread, bool* terminated);
+
+	/*
+	 * Predecode the code of an export into an instruction stream, the nops and the dev blocks are removed, the jump
+	 * chains are followed and some common sequences are merged into one instruction.
+	 * @param vm vm
+	 * @param start export code
+	 * @param end end of the export code
+	 * @param code predecoded code
+	 * @return false if the code can't be predecoded, the raw bytecode should be used
+	 */
+	bool PredecodeExport(acts::vm::ActsVm* vm, byte* start, byte* end, std::vector<acts::vm::VmInstruction>& code);
 }
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include <includes_shared.hpp>
+#include "acts_vm.hpp"
+
+#ifdef ACTS_VM_PROFILER
+#include <actslib/profiler.hpp>
+
+namespace acts::vm {
+	namespace {
+		struct SampleNode {
+			uint64_t count{};
+			std::map<byte*, SampleNode> children{};
+		};
+
+		void WriteSampleNode(ActsVm* vm, actslib::profiler::ProfilerSection& section, const SampleNode& node) {
+			for (const auto& [function, child] : node.children) {
+				actslib::profiler::ProfilerSection& sub{ section.AddSection(vm->GetFunctionName(function), 0, (long long)child.count) };
+				WriteSampleNode(vm, sub, child);
+			}
+		}
+	}
+
+	VmProfiler::VmProfiler(uint64_t sampleRate) : sampleRate(sampleRate ? sampleRate : 1), nextSample(this->sampleRate) {
+	}
+
+	void VmProfiler::Sample(VmRef thread, byte* codePos) {
+		nextSample += sampleRate;
+		codeSamples[codePos]++;
+
+		std::vector<byte*> stack{};
+		stack.reserve(stacks[thread].frames.size());
+		for (const Frame& frame : stacks[thread].frames) {
+			stack.push_back(frame.function);
+		}
+		stackSamples[stack]++;
+	}
+
+	void VmProfiler::EnterFunction(VmRef thread, byte* function) {
+		ThreadStack& stack{ stacks[thread] };
+		stack.frames.push_back({ function, stack.instructions, 0 });
+		functions[function].calls++;
+	}
+
+	void VmProfiler::LeaveFunction(VmRef thread) {
+		ThreadStack& stack{ stacks[thread] };
+		if (stack.frames.empty()) {
+			return;
+		}
+		Frame frame{ stack.frames.back() };
+		stack.frames.pop_back();
+
+		uint64_t inclusive{ stack.instructions - frame.start };
+		VmProfilerFunction& func{ functions[frame.function] };
+		func.exclusive += inclusive - frame.children;
+		// a recursive call is already counted by its caller
+		if (std::none_of(stack.frames.begin(), stack.frames.end(), [&frame](const Frame& f) { return f.function == frame.function; })) {
+			func.inclusive += inclusive;
+		}
+		if (!stack.frames.empty()) {
+			stack.frames.back().children += inclusive;
+		}
+	}
+
+	void VmProfiler::LeaveThread(VmRef thread) {
+		while (!stacks[thread].frames.empty()) {
+			LeaveFunction(thread);
+		}
+		stacks[thread].instructions = 0;
+	}
+
+	void VmProfiler::Reset() {
+		instructions = 0;
+		nextSample = sampleRate;
+		std::memset(opcodes, 0, sizeof(opcodes));
+		functions.clear();
+		codeSamples.clear();
+		stackSamples.clear();
+		// the running functions are kept, but they are restarted
+		for (ThreadStack& stack : stacks) {
+			stack.instructions = 0;
+			for (Frame& frame : stack.frames) {
+				frame.start = 0;
+				frame.children = 0;
+			}
+		}
+	}
+
+	void VmProfiler::WriteFolded(ActsVm* vm, std::ostream& os) const {
+		for (const auto& [stack, count] : stackSamples) {
+			if (stack.empty()) {
+				os << "?";
+			}
+			for (size_t i = 0; i < stack.size(); i++) {
+				if (i) os << ";";
+				os << vm->GetFunctionName(stack[i]);
+			}
+			os << " " << count << "\n";
+		}
+	}
+
+	void VmProfiler::WriteProfile(ActsVm* vm, actslib::profiler::Profiler& prof) const {
+		prof.PushSection("opcodes");
+		for (size_t i = 0; i < VM_PROFILER_OPCODES; i++) {
+			if (opcodes[i]) {
+				prof.AddSection(std::format("0x{:x}", i), 0, (long long)opcodes[i]);
+			}
+		}
+		prof.PopSection();
+
+		// sorted by inclusive count
+		std::vector<std::pair<byte*, const VmProfilerFunction*>> funcs{};
+		funcs.reserve(functions.size());
+		for (const auto& [function, func] : functions) {
+			funcs.emplace_back(function, &func);
+		}
+		std::sort(funcs.begin(), funcs.end(), [](const auto& a, const auto& b) { return a.second->inclusive > b.second->inclusive; });
+
+		prof.PushSection("functions");
+		for (const auto& [function, func] : funcs) {
+			actslib::profiler::ProfilerSection& section{ prof.AddSection(vm->GetFunctionName(function), 0, (long long)func->inclusive) };
+			section.AddSection("self", 0, (long long)func->exclusive);
+		}
+		prof.PopSection();
+
+		SampleNode root{};
+		for (const auto& [stack, count] : stackSamples) {
+			SampleNode* node{ &root };
+			for (byte* function : stack) {
+				node = &node->children[function];
+				node->count += count;
+			}
+		}
+		prof.PushSection("samples");
+		WriteSampleNode(vm, prof.GetCurrent(), root);
+		prof.PopSection();
+	}
+}
+#endif
@@ -0,0 +1,139 @@
+#pragma once
+
+#ifdef ACTS_VM_PROFILER
+#include <map>
+
+namespace actslib::profiler {
+	class Profiler;
+}
+
+namespace acts::vm {
+	class ActsVm;
+
+	// max opcode count, the predecoded instructions without opcode are using VM_PROFILER_NO_OPCODE
+	constexpr uint16_t VM_PROFILER_OPCODES = 0x100;
+	constexpr uint16_t VM_PROFILER_NO_OPCODE = VM_PROFILER_OPCODES;
+
+	struct VmProfilerFunction {
+		// instructions executed by the function and the functions it called
+		uint64_t inclusive{};
+		// instructions executed by the function
+		uint64_t exclusive{};
+		uint64_t calls{};
+	};
+
+	/*
+	 * Profiler of the VM, the instructions are counted by opcode and by function with a shadow call stack per thread
+	 * and the executed location is sampled every sampleRate instructions. The counters are using the instructions and
+	 * not the time, so two runs of the same scripts are giving the same profile.
+	 * The merged predecoded instructions are counted as their first opcode and the removed nops aren't counted.
+	 */
+	class VmProfiler {
+		struct Frame {
+			byte* function;
+			// thread instructions when the function was entered
+			uint64_t start;
+			// inclusive instructions of the called functions
+			uint64_t children;
+		};
+
+		struct ThreadStack {
+			std::vector<Frame> frames{};
+			uint64_t instructions{};
+		};
+
+		uint64_t sampleRate;
+		uint64_t nextSample;
+		uint64_t instructions{};
+		uint64_t opcodes[VM_PROFILER_OPCODES]{};
+		ThreadStack stacks[VM_MAX_THREADS]{};
+		std::unordered_map<byte*, VmProfilerFunction> functions{};
+		// samples by code location
+		std::unordered_map<byte*, uint64_t> codeSamples{};
+		// samples by call stack, the root function is first
+		std::map<std::vector<byte*>, uint64_t> stackSamples{};
+
+		void Sample(VmRef thread, byte* codePos);
+	public:
+		/*
+		 * Create a profiler
+		 * @param sampleRate instructions between 2 samples
+		 */
+		VmProfiler(uint64_t sampleRate);
+
+		/*
+		 * Count an executed instruction
+		 * @param thread thread id
+		 * @param opcode opcode or VM_PROFILER_NO_OPCODE
+		 * @param codePos instruction location
+		 */
+		inline void OnInstruction(VmRef thread, uint16_t opcode, byte* codePos) {
+			if (opcode >= VM_PROFILER_OPCODES) {
+				return;
+			}
+			opcodes[opcode]++;
+			stacks[thread].instructions++;
+			if (++instructions >= nextSample) {
+				Sample(thread, codePos);
+			}
+		}
+
+		/*
+		 * Enter a function in the shadow call stack of a thread
+		 * @param thread thread id
+		 * @param function function start
+		 */
+		void EnterFunction(VmRef thread, byte* function);
+
+		/*
+		 * Leave the last entered function of a thread
+		 * @param thread thread id
+		 */
+		void LeaveFunction(VmRef thread);
+
+		/*
+		 * Leave all the functions of a thread, used when the thread ends
+		 * @param thread thread id
+		 */
+		void LeaveThread(VmRef thread);
+
+		void Reset();
+
+		constexpr uint64_t GetInstructions() const {
+			return instructions;
+		}
+
+		constexpr uint64_t GetOpCodeCount(byte opcode) const {
+			return opcodes[opcode];
+		}
+
+		const std::unordered_map<byte*, VmProfilerFunction>& GetFunctions() const {
+			return functions;
+		}
+
+		const std::unordered_map<byte*, uint64_t>& GetCodeSamples() const {
+			return codeSamples;
+		}
+
+		/*
+		 * Write the sampled call stacks in the folded format used by the flamegraph tools, one "f1;f2;f3 count" line
+		 * per call stack
+		 * @param vm vm to get the function names
+		 * @param os stream
+		 */
+		void WriteFolded(ActsVm* vm, std::ostream& os) const;
+
+		/*
+		 * Write the profile into an actslib profiler, the sections are using the instruction counts instead of the
+		 * milliseconds: opcodes, functions with their exclusive count and the sampled call tree
+		 * @param vm vm to get the function names
+		 * @param prof profiler
+		 */
+		void WriteProfile(ActsVm* vm, actslib::profiler::Profiler& prof) const;
+	};
+}
+
+#define ACTS_VM_PROFILE(vmInstance, call) if (acts::vm::VmProfiler* ___prof = (vmInstance)->GetProfiler()) ___prof->call
+#else
+#define ACTS_VM_PROFILE(vmInstance, call)
+#endif
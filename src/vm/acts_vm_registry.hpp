@@ -6,6 +6,8 @@ namespace acts::vm::opcodes {
 		OPCODE_EXPORT_NO_PARAMS = 0xd,
 		OPCODE_END = 0x10,
 		OPCODE_EXPORT_PARAMS = 0x11,
+		OPCODE_WAIT = 0x12,
+		OPCODE_WAIT_FRAME = 0x13,
 		OPCODE_GET_INT = 0x20,
 		OPCODE_GET_FLOAT = 0x21,
 		OPCODE_GET_HASH = 0x22,